@@ -0,0 +1,82 @@
+#pragma once
+
+// Replaces global operator new/delete with counting versions. Include in exactly one
+// translation unit of a benchmark executable.
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace bench
+{
+    inline std::atomic<long long> &alloc_count()
+    {
+        static std::atomic<long long> n{0};
+        return n;
+    }
+    inline std::atomic<long long> &alloc_bytes()
+    {
+        static std::atomic<long long> n{0};
+        return n;
+    }
+    // bytes currently allocated (requested sizes, not allocator overhead)
+    inline std::atomic<long long> &live_bytes()
+    {
+        static std::atomic<long long> n{0};
+        return n;
+    }
+    // each block is prefixed with its size so delete can subtract it
+    const std::size_t kAllocPrefix = alignof(std::max_align_t);
+}
+
+void *operator new(std::size_t size)
+{
+    bench::alloc_count().fetch_add(1, std::memory_order_relaxed);
+    bench::alloc_bytes().fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    bench::live_bytes().fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    if (char *p = static_cast<char *>(std::malloc(size + bench::kAllocPrefix)))
+    {
+        *reinterpret_cast<std::size_t *>(p) = size;
+        return p + bench::kAllocPrefix;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept
+{
+    if (!p) return;
+    char *block = static_cast<char *>(p) - bench::kAllocPrefix;
+    bench::live_bytes().fetch_sub(static_cast<long long>(*reinterpret_cast<std::size_t *>(block)), std::memory_order_relaxed);
+    std::free(block);
+}
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, std::size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, std::size_t) noexcept { operator delete(p); }
+// the aligned forms too: std::pmr::new_delete_resource() allocates through them. The prefix is
+// one alignment unit, so the block stays aligned.
+void *operator new(std::size_t size, std::align_val_t al)
+{
+    std::size_t a = static_cast<std::size_t>(al) < bench::kAllocPrefix ? bench::kAllocPrefix : static_cast<std::size_t>(al);
+    bench::alloc_count().fetch_add(1, std::memory_order_relaxed);
+    bench::alloc_bytes().fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    bench::live_bytes().fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    if (char *p = static_cast<char *>(std::aligned_alloc(a, (size + 2 * a - 1) / a * a)))
+    {
+        *reinterpret_cast<std::size_t *>(p + a - sizeof(std::size_t)) = size;
+        return p + a;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size, std::align_val_t al) { return operator new(size, al); }
+void operator delete(void *p, std::align_val_t al) noexcept
+{
+    if (!p) return;
+    std::size_t a = static_cast<std::size_t>(al) < bench::kAllocPrefix ? bench::kAllocPrefix : static_cast<std::size_t>(al);
+    char *block = static_cast<char *>(p) - a;
+    bench::live_bytes().fetch_sub(static_cast<long long>(*reinterpret_cast<std::size_t *>(block + a - sizeof(std::size_t))),
+                                  std::memory_order_relaxed);
+    std::free(block);
+}
+void operator delete[](void *p, std::align_val_t al) noexcept { operator delete(p, al); }
+void operator delete(void *p, std::size_t, std::align_val_t al) noexcept { operator delete(p, al); }
+void operator delete[](void *p, std::size_t, std::align_val_t al) noexcept { operator delete(p, al); }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace bench
+{
+    class Stopwatch
+    {
+    public:
+        Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+        void reset() { start_ = std::chrono::steady_clock::now(); }
+        double seconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Small deterministic generator so runs are comparable across machines
+    class Rng
+    {
+    public:
+        explicit Rng(std::uint64_t seed) : state_(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+        std::uint64_t next()
+        {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 7;
+            state_ ^= state_ << 17;
+            return state_;
+        }
+        std::uint64_t below(std::uint64_t n) { return next() % n; }
+
+    private:
+        std::uint64_t state_;
+    };
+
+    // Zipf(s) over ranks 0..n-1: rank 0 is the hottest. s = 0 is uniform.
+    class Zipf
+    {
+    public:
+        Zipf(std::uint64_t n, double s) : cdf_(n)
+        {
+            double sum = 0;
+            for (std::uint64_t k = 0; k < n; k++)
+                cdf_[k] = (sum += 1.0 / std::pow(static_cast<double>(k + 1), s));
+            for (double &c : cdf_)
+                c /= sum;
+        }
+        std::uint64_t sample(Rng &rng) const
+        {
+            double u = static_cast<double>(rng.next() >> 11) * (1.0 / 9007199254740992.0);
+            auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+            return it == cdf_.end() ? cdf_.size() - 1 : static_cast<std::uint64_t>(it - cdf_.begin());
+        }
+
+    private:
+        std::vector<double> cdf_;
+    };
+
+    // Keeps the optimizer from discarding a computed value: the compiler must assume the
+    // empty asm reads it
+    template <class T>
+    inline void keep(const T &value)
+    {
+#if defined(_MSC_VER)
+        static thread_local volatile T sink;
+        sink = value;
+        (void)sink;
+#else
+        asm volatile("" : : "g"(&value) : "memory");
+#endif
+    }
+}
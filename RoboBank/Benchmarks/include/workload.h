@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "bench_util.h"
+
+namespace bench
+{
+    struct WorkloadOptions
+    {
+        std::uint64_t seed = 42;
+        std::uint32_t accounts = 100000;
+        double zipf_s = 0.99; // account popularity: account 0 is the hottest, 0 is uniform
+        // relative weights of Deposit, Withdrawal, Fee, Interest among the single postings
+        double kind_mix[4] = {50, 35, 10, 5};
+        double transfer_ratio = 0.2; // share of the ops that are transfers
+        long long max_amount_cents = 100000;
+    };
+
+    // One generated operation: a posting of kind 0..3 to `account`, or a transfer (kind
+    // kTransfer) from `account` to `to`
+    struct WorkloadOp
+    {
+        static const int kTransfer = 5; // TxKind::TransferOut, from the source's side
+
+        long long amount_cents;
+        long long timestamp;
+        std::uint32_t account;
+        std::uint32_t to;
+        int kind;
+
+        bool transfer() const { return kind == kTransfer; }
+    };
+
+    inline std::string workload_account_id(std::uint32_t i) { return "AC-" + std::to_string(10000000u + i); }
+
+    // The same options always give the same ops, whatever the machine
+    inline std::vector<WorkloadOp> make_workload(const WorkloadOptions &o, std::size_t n)
+    {
+        Rng rng(o.seed);
+        Zipf zipf(o.accounts ? o.accounts : 1, o.zipf_s);
+        double mix = 0;
+        for (double w : o.kind_mix)
+            mix += w > 0 ? w : 0;
+        const double inv = 1.0 / 9007199254740992.0; // 2^-53
+        std::vector<WorkloadOp> ops(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            WorkloadOp &op = ops[i];
+            op.amount_cents = 1 + static_cast<long long>(rng.below(static_cast<std::uint64_t>(std::max(o.max_amount_cents, 1LL))));
+            op.timestamp = static_cast<long long>(i);
+            op.account = static_cast<std::uint32_t>(zipf.sample(rng));
+            op.to = op.account;
+            if (static_cast<double>(rng.next() >> 11) * inv < o.transfer_ratio && o.accounts > 1)
+            {
+                op.kind = WorkloadOp::kTransfer;
+                op.to = static_cast<std::uint32_t>(zipf.sample(rng));
+                if (op.to == op.account) op.to = (op.account + 1) % o.accounts;
+                continue;
+            }
+            double u = static_cast<double>(rng.next() >> 11) * inv * mix;
+            op.kind = 3;
+            for (int k = 0; k < 3; ++k)
+            {
+                double w = o.kind_mix[k] > 0 ? o.kind_mix[k] : 0;
+                if (u < w)
+                {
+                    op.kind = k;
+                    break;
+                }
+                u -= w;
+            }
+        }
+        return ops;
+    }
+}
@@ -0,0 +1,139 @@
+// Account storage at scale: Portfolio's columnar account table against the layout it replaced
+// (an id-keyed unordered_map of heap CheckingAccount/SavingsAccount objects, one virtual call
+// per transaction). Reports live heap bytes per account and apply throughput.
+// usage: AccountStorageBench [accounts] [tx] [audit_capacity]
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "portfolio.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+
+static std::string account_id(size_t i) { return "AC-" + std::to_string(10000000 + i); }
+
+static p4::AccountSettings settings_for(size_t i, int audit_capacity)
+{
+    // one account in four is savings
+    p4::AccountSettings s{static_cast<int>(i % 4 == 3 ? AccountType::Savings : AccountType::Checking), i % 4 == 3 ? 0.02 : 0.0,
+                          i % 4 == 3 ? 0 : 500, audit_capacity};
+    return s;
+}
+
+// the same stream for both layouts, generated batch by batch so it never sits in memory whole
+static void make_batch(bench::Rng &rng, size_t accounts, long long ts, std::vector<p4::TxRecord> &txs)
+{
+    for (auto &t : txs)
+    {
+        t.kind = static_cast<p4::TxKind>(rng.below(3));
+        t.amount_cents = static_cast<long long>(rng.below(10000));
+        t.timestamp = ts;
+        t.note = "batch";
+        t.account_id = account_id(rng.below(accounts));
+    }
+}
+
+struct Result
+{
+    double create_bytes; // per account, after creation
+    double apply_bytes;  // per account, after the stream (audit buffers included)
+    double tx_per_s;
+    long long exposure;
+};
+
+static Result run_map(size_t accounts, size_t total_tx, int audit_capacity)
+{
+    Result r;
+    long long base = bench::live_bytes().load();
+    {
+        p4::StringPool notes;
+        std::unordered_map<std::string, std::unique_ptr<IAccount>> map;
+        map.reserve(accounts);
+        for (size_t i = 0; i < accounts; i++)
+        {
+            p4::AccountSettings s = settings_for(i, audit_capacity);
+            std::string id = account_id(i);
+            p4::AccountHandle h = static_cast<p4::AccountHandle>(i);
+            if (s.type == AccountType::Checking)
+                map.emplace(id, std::make_unique<CheckingAccount>(id, s, 100000, &notes, h));
+            else
+                map.emplace(id, std::make_unique<SavingsAccount>(id, s, 100000, &notes, h));
+        }
+        r.create_bytes = double(bench::live_bytes().load() - base) / accounts;
+
+        bench::Rng rng(5);
+        std::vector<p4::TxRecord> txs(std::min<size_t>(total_tx, 1000000));
+        double s = 0;
+        for (size_t done = 0; done < total_tx; done += txs.size())
+        {
+            make_batch(rng, accounts, static_cast<long long>(done), txs);
+            bench::Stopwatch sw;
+            for (const auto &t : txs)
+            {
+                auto it = map.find(t.account_id);
+                if (it != map.end()) it->second->apply(t);
+            }
+            s += sw.seconds();
+        }
+        txs.clear();
+        txs.shrink_to_fit();
+        r.apply_bytes = double(bench::live_bytes().load() - base) / accounts;
+        r.tx_per_s = total_tx / s;
+        r.exposure = 0;
+        for (const auto &a : map)
+            r.exposure += a.second->balance_cents();
+    }
+    return r;
+}
+
+static Result run_table(size_t accounts, size_t total_tx, int audit_capacity)
+{
+    Result r;
+    long long base = bench::live_bytes().load();
+    {
+        Portfolio p;
+        p.reserve(accounts);
+        for (size_t i = 0; i < accounts; i++)
+            p.add_account(account_id(i), settings_for(i, audit_capacity), 100000);
+        r.create_bytes = double(bench::live_bytes().load() - base) / accounts;
+
+        bench::Rng rng(5);
+        std::vector<p4::TxRecord> txs(std::min<size_t>(total_tx, 1000000));
+        double s = 0;
+        for (size_t done = 0; done < total_tx; done += txs.size())
+        {
+            make_batch(rng, accounts, static_cast<long long>(done), txs);
+            bench::Stopwatch sw;
+            p.apply_all(txs);
+            s += sw.seconds();
+        }
+        txs.clear();
+        txs.shrink_to_fit();
+        // Portfolio::audit() (one record per transaction) has no counterpart in the map layout
+        long long portfolio_audit = static_cast<long long>(p.audit().capacity() * sizeof(p4::TxEntry));
+        r.apply_bytes = double(bench::live_bytes().load() - base - portfolio_audit) / accounts;
+        r.tx_per_s = total_tx / s;
+        r.exposure = p.total_exposure();
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t accounts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    const size_t total_tx = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    const int audit_capacity = argc > 3 ? std::atoi(argv[3]) : 16;
+
+    Result table = run_table(accounts, total_tx, audit_capacity);
+    std::printf("table: %.1f B/account created, %.1f B/account after %zu tx, apply_all %.0f tx/s\n",
+                table.create_bytes, table.apply_bytes, total_tx, table.tx_per_s);
+    Result map = run_map(accounts, total_tx, audit_capacity);
+    std::printf("map:   %.1f B/account created, %.1f B/account after %zu tx, apply %.0f tx/s\n",
+                map.create_bytes, map.apply_bytes, total_tx, map.tx_per_s);
+    bool ok = table.exposure == map.exposure;
+    std::printf("accounts=%zu audit_capacity=%d: %.2fx less memory, %.2fx tx/s %s\n", accounts, audit_capacity,
+                map.apply_bytes / table.apply_bytes, table.tx_per_s / map.tx_per_s, ok ? "match" : "MISMATCH");
+    return ok ? 0 : 1;
+}
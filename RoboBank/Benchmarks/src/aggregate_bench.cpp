@@ -0,0 +1,118 @@
+// GB/s of the bank_summary / exposure kernels: the old per-element switch loop vs the
+// branchless scalar body vs the runtime-dispatched (AVX2 where available) body.
+// usage: AggregateBench [tx_rows] [accounts] [reps]
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "LedgerEngine.h"
+#include "LedgerKernels.h"
+#include "bench_util.h"
+
+// bank_summary's loop before the kernels, kept as the baseline
+static LedgerSummary switch_loop(const int tx_type[], const long long tx_amount_cents[], size_t tx_count)
+{
+    LedgerSummary s;
+    for (size_t i = 0; i < tx_count; i++)
+    {
+        switch (tx_type[i])
+        {
+        case 0:
+        case 4:
+            s.total_deposits += tx_amount_cents[i];
+            break;
+        case 1:
+        case 5:
+            s.total_withdrawals += tx_amount_cents[i];
+            break;
+        case 2:
+            s.total_fees += tx_amount_cents[i];
+            break;
+        case 3:
+            s.total_interest += tx_amount_cents[i];
+            break;
+        }
+    }
+    return s;
+}
+
+static bool same(const KindTotals &a, const KindTotals &b)
+{
+    for (int k = 0; k < TX_KINDS; k++)
+        if (a.amount[k] != b.amount[k]) return false;
+    return a.unknown == b.unknown;
+}
+
+static bool same(const KindTotals &k, const LedgerSummary &s)
+{
+    return k.amount[0] + k.amount[4] == s.total_deposits && k.amount[1] + k.amount[5] == s.total_withdrawals &&
+           k.amount[2] == s.total_fees && k.amount[3] == s.total_interest;
+}
+
+template <class Fn>
+static double best_of(int reps, Fn &&fn)
+{
+    double best = 1e30;
+    for (int r = 0; r < reps; r++)
+    {
+        bench::Stopwatch sw;
+        fn();
+        double s = sw.seconds();
+        if (s < best) best = s;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 16000000;
+    const size_t accounts = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+    const int reps = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    bench::Rng rng(21);
+    std::vector<int> type(rows), amount32(rows);
+    std::vector<long long> amount64(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        type[i] = rng.below(1000) == 0 ? 9 : static_cast<int>(rng.below(6)); // a few unknown types
+        amount32[i] = static_cast<int>(rng.below(100000));
+        amount64[i] = amount32[i];
+    }
+    std::vector<long long> balance(accounts);
+    std::vector<int> acc_type(accounts);
+    for (size_t i = 0; i < accounts; i++)
+    {
+        balance[i] = static_cast<long long>(rng.below(10000000)) - 1000000;
+        acc_type[i] = static_cast<int>(rng.below(2));
+    }
+
+    const double kinds64_gb = rows * (sizeof(int) + sizeof(long long)) / 1e9;
+    const double kinds32_gb = rows * 2 * sizeof(int) / 1e9;
+    const double expo_gb = accounts * (sizeof(long long) + sizeof(int)) / 1e9;
+
+    LedgerSummary base;
+    double t = best_of(reps, [&] { base = switch_loop(type.data(), amount64.data(), rows); });
+    std::printf("sum_by_kind i64  switch  %6.2f GB/s\n", kinds64_gb / t);
+
+    bool ok = true;
+    for (int forced = 1; forced >= 0; forced--)
+    {
+        ledger_kernels_force_scalar(forced != 0);
+        const char *isa = ledger_kernel_isa();
+        KindTotals k64, k32;
+        ExposureTotals e;
+        long long total = 0;
+        double t64 = best_of(reps, [&] { k64 = sum_by_kind(type.data(), amount64.data(), rows); });
+        double t32 = best_of(reps, [&] { k32 = sum_by_kind(type.data(), amount32.data(), rows); });
+        double te = best_of(reps, [&] { e = exposure_by_type(balance.data(), acc_type.data(), accounts); });
+        double ts = best_of(reps, [&] { total = sum_balances(balance.data(), accounts); });
+        bool match = same(k64, base) && same(k64, k32) && e.total == total && e.by_type[0] + e.by_type[1] == total;
+        ok = ok && match;
+        std::printf("sum_by_kind i64  %-7s %6.2f GB/s\n", isa, kinds64_gb / t64);
+        std::printf("sum_by_kind i32  %-7s %6.2f GB/s\n", isa, kinds32_gb / t32);
+        std::printf("exposure_by_type %-7s %6.2f GB/s\n", isa, expo_gb / te);
+        std::printf("sum_balances     %-7s %6.2f GB/s %s\n", isa, accounts * sizeof(long long) / 1e9 / ts,
+                    match ? "match" : "MISMATCH");
+    }
+    bench::keep(base.total_deposits);
+    return ok ? 0 : 1;
+}
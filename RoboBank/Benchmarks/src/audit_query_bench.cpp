@@ -0,0 +1,102 @@
+// Audit queries: "account X between t1 and t2" and per-kind totals over a time window, answered
+// by an AuditStore attached to the portfolio against a scan of the full portfolio audit. Older
+// segments spill to a directory, so the store's memory stays at resident_segments segments.
+// usage: AuditQueryBench [tx] [accounts] [queries] [spill dir]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "audit_store.h"
+#include "bench_util.h"
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 20000;
+    const int queries = argc > 3 ? std::atoi(argv[3]) : 200;
+    const std::string dir = argc > 4 ? argv[4] : "audit_query_bench.spill";
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(1000000 + i));
+    p4::AuditStoreOptions opts;
+    opts.resident_segments = 16;
+    opts.spill_dir = dir;
+    p4::AuditStore store(opts);
+    Portfolio indexed, plain;
+    indexed.attach_audit_store(&store);
+
+    // batches of 1000 with rising timestamps, as a long-running process would see them
+    bench::Rng rng(3);
+    std::vector<p4::TxRecord> batch(1000);
+    long long ts = 0;
+    for (size_t done = 0; done < total_tx; done += batch.size())
+    {
+        for (auto &t : batch)
+            t = p4::TxRecord{static_cast<p4::TxKind>(rng.below(6)), static_cast<long long>(rng.below(10000)), ts++, "",
+                             ids[rng.below(accounts)]};
+        indexed.apply_all(batch);
+        plain.apply_all(batch);
+    }
+    const std::vector<p4::TxEntry> &all = plain.audit();
+
+    // account queries over 1% of the history
+    bool ok = true;
+    double t_store = 0, t_scan = 0;
+    size_t matches = 0;
+    std::vector<p4::TxEntry> got, want;
+    for (int q = 0; q < queries; q++)
+    {
+        p4::AccountHandle h = indexed.handle_of(ids[rng.below(accounts)]);
+        long long from = static_cast<long long>(rng.below(ts - ts / 100));
+        long long to = from + ts / 100;
+        got.clear();
+        want.clear();
+        bench::Stopwatch sw;
+        store.account_between(h, from, to, got);
+        t_store += sw.seconds();
+        sw.reset();
+        for (const p4::TxEntry &e : all)
+            if (e.account == h && e.timestamp >= from && e.timestamp <= to) want.push_back(e);
+        t_scan += sw.seconds();
+        matches += got.size();
+        ok = ok && got.size() == want.size();
+        for (size_t i = 0; ok && i < got.size(); i++)
+            ok = got[i].timestamp == want[i].timestamp && got[i].amount_cents == want[i].amount_cents;
+    }
+    std::printf("account_between: store %.1f us, scan %.1f us (%.0fx), %zu matches %s\n", t_store / queries * 1e6,
+                t_scan / queries * 1e6, t_scan / t_store, matches, ok ? "match" : "MISMATCH");
+
+    // per-kind totals over 10% windows
+    t_store = t_scan = 0;
+    for (int q = 0; q < queries; q++)
+    {
+        long long from = static_cast<long long>(rng.below(ts - ts / 10));
+        long long to = from + ts / 10;
+        bench::Stopwatch sw;
+        bool exact = false;
+        p4::KindSums s = store.kind_totals(from, to, &exact);
+        t_store += sw.seconds();
+        sw.reset();
+        p4::KindSums w;
+        for (const p4::TxEntry &e : all)
+            if (e.timestamp >= from && e.timestamp <= to)
+            {
+                w.amount[e.kind] += e.amount_cents;
+                ++w.count[e.kind];
+            }
+        t_scan += sw.seconds();
+        ok = ok && exact;
+        for (int k = 0; k < 6; k++)
+            ok = ok && s.amount[k] == w.amount[k] && s.count[k] == w.count[k];
+    }
+    const p4::AuditStoreStats &st = store.stats();
+    std::printf("kind_totals:     store %.1f us, scan %.1f us (%.0fx) %s\n", t_store / queries * 1e6, t_scan / queries * 1e6,
+                t_scan / t_store, ok ? "match" : "MISMATCH");
+    std::printf("store: %llu entries, %llu segments, %llu spilled; resident %zu entries, portfolio audit %zu entries\n",
+                static_cast<unsigned long long>(st.entries), static_cast<unsigned long long>(st.segments),
+                static_cast<unsigned long long>(st.spilled_segments),
+                static_cast<size_t>(st.segments - st.spilled_segments) * opts.segment_entries, indexed.audit().size());
+    return ok ? 0 : 1;
+}
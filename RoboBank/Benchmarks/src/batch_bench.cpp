@@ -0,0 +1,106 @@
+// Atomic batches: payroll runs (one employer debit, one credit per employee) through
+// Portfolio::commit, against the same legs through apply_all, on a small and a large book to
+// show the commit cost follows the batch and not the portfolio. Then batches the employer
+// cannot fund, which must roll back and leave every balance as it was.
+// usage: BatchBench [batches] [employees per batch] [large book accounts]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "bench_util.h"
+
+static std::vector<std::string> make_ids(size_t n)
+{
+    std::vector<std::string> ids;
+    ids.reserve(n);
+    for (size_t i = 0; i < n; i++)
+        ids.push_back("AC-" + std::to_string(10000000 + i));
+    return ids;
+}
+
+static void build(Portfolio &p, const std::vector<std::string> &ids, long long opening)
+{
+    p.reserve(ids.size());
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0};
+    for (const auto &id : ids)
+        p.add_account(id, s, opening);
+}
+
+// payroll from ids[0] to `employees` random accounts
+static std::vector<p4::Batch> make_runs(const std::vector<std::string> &ids, int batches, int employees, long long pay)
+{
+    bench::Rng rng(21);
+    std::vector<p4::Batch> runs(batches);
+    for (auto &b : runs)
+    {
+        b.reserve(employees + 1);
+        b.post(ids[0], p4::TxKind::TransferOut, pay * employees, 1, "payroll");
+        for (int e = 0; e < employees; e++)
+            b.post(ids[1 + rng.below(ids.size() - 1)], p4::TxKind::TransferIn, pay, 1, "payroll");
+    }
+    return runs;
+}
+
+static void run(size_t accounts, int batches, int employees)
+{
+    std::vector<std::string> ids = make_ids(accounts);
+    std::vector<p4::Batch> runs = make_runs(ids, batches, employees, 250000);
+    const double legs = double(batches) * (employees + 1);
+
+    Portfolio a, b;
+    build(a, ids, 0);
+    build(b, ids, 0);
+    // the employer can fund every run
+    p4::Batch fund;
+    fund.post(ids[0], p4::TxKind::Deposit, 250000LL * employees * batches, 0);
+    a.commit(fund);
+    b.commit(fund);
+
+    bench::Stopwatch sw;
+    size_t committed = 0;
+    for (const auto &r : runs)
+        committed += a.commit(r).committed;
+    double t_commit = sw.seconds();
+    sw.reset();
+    for (const auto &r : runs)
+        b.apply_all(r.legs(), false);
+    double t_apply = sw.seconds();
+    bool ok = committed == runs.size() && a.total_exposure() == b.total_exposure() && a.balance_of(ids[0]) == 0;
+    std::printf("accounts=%-8zu commit %.0f legs/s, apply_all %.0f legs/s (%+.1f%%) %s\n", accounts, legs / t_commit,
+                legs / t_apply, (t_commit / t_apply - 1) * 100, ok ? "match" : "MISMATCH");
+
+    // the employer is empty now; with its debit moved last, every run is refused at its final
+    // leg, after the whole batch was staged, and rolled back
+    for (auto &r : runs)
+    {
+        std::vector<p4::TxRecord> legs = r.legs();
+        r.clear();
+        for (size_t i = 1; i < legs.size(); i++)
+            r.post(legs[i].account_id, legs[i].kind, legs[i].amount_cents, legs[i].timestamp, legs[i].note);
+        r.post(legs[0].account_id, legs[0].kind, legs[0].amount_cents, legs[0].timestamp, legs[0].note);
+    }
+    long long before = a.total_exposure();
+    size_t audit_before = a.audit().size();
+    sw.reset();
+    size_t refused = 0;
+    for (const auto &r : runs)
+    {
+        p4::BatchResult res = a.commit(r);
+        refused += !res.committed && res.reason == p4::RejectReason::Overdraft && res.leg == r.size() - 1;
+    }
+    double t_rollback = sw.seconds();
+    ok = refused == runs.size() && a.total_exposure() == before && a.audit().size() == audit_before;
+    std::printf("accounts=%-8zu rollback %.0f legs/s %s\n", accounts, legs / t_rollback, ok ? "match" : "MISMATCH");
+}
+
+int main(int argc, char **argv)
+{
+    const int batches = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int employees = argc > 2 ? std::atoi(argv[2]) : 100;
+    const size_t large = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000000;
+
+    run(10000, batches, employees);
+    run(large, batches, employees);
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Mixed read/transfer workload against ConcurrentPortfolio with Zipf-skewed (hot) accounts.
+// Doubles as a stress run: money must be conserved and the lock-free totals must match the
+// per-account balances once all threads have joined.
+// usage: ConcurrentTransferBench [threads] [accounts] [ops_per_thread] [read_pct] [zipf_s]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include "concurrent_portfolio.h"
+#include "bench_util.h"
+
+int main(int argc, char **argv)
+{
+    const unsigned threads = argc > 1 ? static_cast<unsigned>(std::atoi(argv[1])) : 8;
+    const size_t accounts = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    const size_t ops = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 500000;
+    const int read_pct = argc > 4 ? std::atoi(argv[4]) : 50;
+    const double zipf_s = argc > 5 ? std::atof(argv[5]) : 1.1;
+    const long long opening = 1000000;
+
+    ConcurrentPortfolio p(accounts);
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0};
+    std::vector<p4::AccountHandle> handles;
+    for (size_t i = 0; i < accounts; i++)
+    {
+        std::string id = "AC-" + std::to_string(1000000 + i);
+        p.add_account(id, s, opening);
+        handles.push_back(p.handle_of(id));
+    }
+    const long long expected_total = opening * static_cast<long long>(accounts);
+    p4::NoteId note = p.intern_note("stress");
+    bench::Zipf zipf(accounts, zipf_s);
+
+    std::vector<long long> torn(threads, 0);
+    auto worker = [&](unsigned t) {
+        bench::Rng rng(1000 + t);
+        long long sink = 0;
+        for (size_t i = 0; i < ops; i++)
+        {
+            if (static_cast<int>(rng.below(100)) < read_pct)
+            {
+                sink += p.balance_of(handles[zipf.sample(rng)]);
+                // transfers never change the total, so any other value is a torn read
+                if (p.total_exposure() != expected_total) torn[t]++;
+            }
+            else
+            {
+                p4::AccountHandle a = handles[zipf.sample(rng)];
+                p4::AccountHandle b = handles[zipf.sample(rng)];
+                p.transfer(a, b, static_cast<long long>(rng.below(500)), static_cast<long long>(i), note);
+            }
+        }
+        bench::keep(sink);
+    };
+
+    bench::Stopwatch sw;
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++)
+        pool.emplace_back(worker, t);
+    for (auto &th : pool)
+        th.join();
+    double secs = sw.seconds();
+
+    long long sum_atomic = 0, sum_locked = 0, torn_reads = 0;
+    for (p4::AccountHandle h : handles)
+    {
+        sum_atomic += p.balance_of(h);
+        p.with_account(h, [&](const IAccount &acc) { sum_locked += acc.balance_cents(); });
+    }
+    for (long long n : torn)
+        torn_reads += n;
+    bool ok = sum_atomic == expected_total && sum_locked == expected_total && p.total_exposure() == expected_total && torn_reads == 0;
+
+    std::printf("threads=%u accounts=%zu read_pct=%d zipf_s=%.2f %.0f ops/s %s\n", threads, accounts, read_pct, zipf_s,
+                threads * ops / secs, ok ? "conserved" : "INVARIANT VIOLATED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+// Streams generated CSV and binary transaction files through Portfolio::ingest_file and
+// reports MB/s and tx/s; balances must match apply_all over the same transactions.
+// usage: IngestBench [tx] [accounts] [chunk_kib] [dir]
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "bench_util.h"
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 100000;
+    const size_t chunk_kib = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4096;
+    const std::string dir = argc > 4 ? argv[4] : ".";
+
+    std::vector<std::string> notes;
+    for (int i = 0; i < 32; i++)
+        notes.push_back("card purchase merchant #" + std::to_string(1000 + i));
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(1000000 + i));
+
+    // every 1000th line is invalid so the reject path is exercised too
+    const std::string csv_path = dir + "/ingest_bench.csv", bin_path = dir + "/ingest_bench.rbtx";
+    Portfolio expected;
+    {
+        bench::Rng rng(9);
+        std::ofstream csv(csv_path, std::ios::binary);
+        p4::BinaryTxWriter bin(bin_path);
+        csv << "account_id,kind,amount_cents,timestamp,note\n";
+        std::vector<p4::TxRecord> batch;
+        for (size_t i = 0; i < total_tx; i++)
+        {
+            p4::TxRecord t{static_cast<p4::TxKind>(rng.below(3)), static_cast<long long>(rng.below(10000)),
+                           static_cast<long long>(i), notes[rng.below(notes.size())], ids[rng.below(accounts)]};
+            if (i % 1000 == 999) t.amount_cents = -1;
+            csv << t.account_id << ',' << static_cast<int>(t.kind) << ',' << t.amount_cents << ',' << t.timestamp << ','
+                << t.note << '\n';
+            bin.write(t);
+            if (t.amount_cents >= 0) batch.push_back(t);
+            if (batch.size() == 100000)
+            {
+                expected.apply_all(batch);
+                batch.clear();
+            }
+        }
+        expected.apply_all(batch);
+    }
+
+    p4::IngestOptions opts;
+    opts.chunk_bytes = chunk_kib << 10;
+    opts.portfolio_audit = false;
+    bool all_ok = true;
+    for (int f = 0; f < 2; f++)
+    {
+        const std::string &path = f ? bin_path : csv_path;
+        Portfolio p;
+        bench::Stopwatch sw;
+        p4::IngestReport r = p.ingest_file(path, f ? p4::IngestFormat::Binary : p4::IngestFormat::Csv, opts);
+        double s = sw.seconds();
+
+        bool ok = r.opened && r.records == total_tx && r.negative_amount == total_tx / 1000 &&
+                  p.total_exposure() == expected.total_exposure();
+        for (int i = 0; ok && i < accounts; i += 97)
+            ok = p.balance_of(ids[i]) == expected.balance_of(ids[i]);
+        all_ok = all_ok && ok;
+        std::printf("%-6s %.1f MiB in %.3f s: %.1f MB/s, %.0f tx/s, applied=%llu rejected=%llu (chunk %zu KiB x %zu) %s\n",
+                    f ? "binary" : "csv", r.bytes / 1048576.0, s, r.bytes / s / 1e6, r.records / s,
+                    (unsigned long long)r.applied, (unsigned long long)r.rejected(), chunk_kib, opts.chunks_in_flight,
+                    ok ? "match" : "MISMATCH");
+    }
+    std::filesystem::remove(csv_path);
+    std::filesystem::remove(bin_path);
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+// Interest over a balance column: the integer day-count kernels (Calculator::accrue) against
+// the double formula they replaced, with a count of the rows where the two disagree.
+// usage: InterestBench [rows] [reps]
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "calculator.h"
+#include "bench_util.h"
+
+// Calculator::interest before the fixed point rewrite (returning just the interest)
+static void accrue_double(const long long balance[], double apr, int days, int basis, long long out[], size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = static_cast<long long>(balance[i] * apr * days / basis + 0.5);
+}
+
+template <class Fn>
+static double best_of(int reps, Fn fn)
+{
+    double best = 1e30;
+    for (int r = 0; r < reps; r++)
+    {
+        bench::Stopwatch sw;
+        fn();
+        best = std::min(best, sw.seconds());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    const int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    // balances in cents, a tenth of them overdrawn
+    bench::Rng rng(3);
+    std::vector<long long> balance(rows);
+    for (auto &b : balance)
+        b = static_cast<long long>(rng.below(100000000)) * (rng.below(10) ? 1 : -1);
+    std::vector<long long> exact(rows), approx(rows);
+
+    const double apr = 0.0425;
+    const long long rate = Calculator::rate_from_apr(apr);
+    const int days = 31;
+    double t_double = best_of(reps, [&] { accrue_double(balance.data(), apr, days, 365, approx.data(), rows); });
+    double t365 = best_of(reps, [&] { Calculator::accrue<Calculator::Act365>(balance.data(), rate, days, exact.data(), rows); });
+    size_t drift = 0;
+    long long drift_cents = 0;
+    for (size_t i = 0; i < rows; i++)
+    {
+        drift += exact[i] != approx[i];
+        drift_cents += approx[i] - exact[i];
+    }
+    double t360 = best_of(reps, [&] { Calculator::accrue<Calculator::Act360>(balance.data(), rate, days, exact.data(), rows); });
+    double t30 = best_of(reps, [&] { Calculator::accrue<Calculator::Thirty360>(balance.data(), rate, 30, exact.data(), rows); });
+    bench::keep(exact[rows / 2]);
+
+    std::printf("double +0.5  %6.1f Mrows/s\n", rows / t_double / 1e6);
+    std::printf("ACT/365      %6.1f Mrows/s\n", rows / t365 / 1e6);
+    std::printf("ACT/360      %6.1f Mrows/s\n", rows / t360 / 1e6);
+    std::printf("30/360       %6.1f Mrows/s\n", rows / t30 / 1e6);
+    std::printf("double vs exact ACT/365: %zu of %zu rows differ, net %lld cents\n", drift, rows, drift_cents);
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Journal write throughput for apply_all/transfer, then recovery time from the full journal
+// and from a snapshot plus a short tail. Recovered balances must match the live portfolio.
+// usage: JournalBench [tx] [accounts] [dir] [tail_tx]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "journal.h"
+#include "bench_util.h"
+
+static bool same_balances(const Portfolio &a, const Portfolio &b, const std::vector<std::string> &ids)
+{
+    if (a.count() != b.count() || a.total_exposure() != b.total_exposure()) return false;
+    for (const auto &id : ids)
+        if (a.balance_of(id) != b.balance_of(id)) return false;
+    return true;
+}
+
+static double recover_once(const std::string &dir, const Portfolio &live, const std::vector<std::string> &ids)
+{
+    Portfolio p;
+    bench::Stopwatch sw;
+    size_t frames;
+    {
+        p4::Journal j(dir);
+        frames = j.recover(p);
+    }
+    double s = sw.seconds();
+    bool ok = same_balances(p, live, ids);
+    std::printf("  recovered %zu frames in %.3f s %s\n", frames, s, ok ? "match" : "MISMATCH");
+    if (!ok) std::exit(1);
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    const long long total_tx = argc > 1 ? std::atoll(argv[1]) : 5000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 100000;
+    const std::string dir = argc > 3 ? argv[3] : "journal_bench.dir";
+    const long long tail_tx = argc > 4 ? std::atoll(argv[4]) : total_tx / 20;
+    const int batch = 10000;
+
+    std::filesystem::remove_all(dir);
+    std::vector<std::string> notes;
+    for (int i = 0; i < 32; i++)
+        notes.push_back("card purchase merchant #" + std::to_string(1000 + i));
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(1000000 + i));
+
+    bench::Rng rng(5);
+    auto fill = [&](std::vector<p4::TxRecord> &txs, long long ts) {
+        for (auto &t : txs)
+        {
+            t.kind = static_cast<p4::TxKind>(rng.below(3));
+            t.amount_cents = static_cast<long long>(rng.below(10000));
+            t.timestamp = ts;
+            t.note = notes[rng.below(notes.size())];
+            t.account_id = ids[rng.below(accounts)];
+        }
+    };
+
+    Portfolio live;
+    p4::JournalOptions opts;
+    opts.snapshot_every_bytes = 0; // snapshots are taken explicitly below
+    p4::Journal journal(dir, opts);
+    journal.recover(live);
+    live.attach_journal(&journal);
+
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0};
+    for (int i = 0; i < accounts; i++)
+        live.add_account(ids[i], s, 1000000);
+
+    // generation is kept out of the timed region
+    std::vector<p4::TxRecord> txs(batch);
+    double apply_s = 0;
+    for (long long done = 0; done < total_tx; done += batch)
+    {
+        fill(txs, done);
+        bench::Stopwatch sw;
+        live.apply_all(txs);
+        apply_s += sw.seconds();
+    }
+    const int transfers = 200000;
+    bench::Stopwatch sw;
+    for (int i = 0; i < transfers; i++)
+        live.transfer(p4::TransferRecord{ids[rng.below(accounts)], ids[rng.below(accounts)], 100, i, notes[i % notes.size()]});
+    double transfer_s = sw.seconds();
+    sw.reset();
+    journal.sync();
+    double sync_s = sw.seconds();
+
+    const p4::JournalStats &st = journal.stats();
+    std::printf("apply_all: tx=%lld %.0f tx/s (journaled, fsync per %zu KiB)\n", total_tx,
+                total_tx / (apply_s + sync_s), opts.group_commit_bytes >> 10);
+    std::printf("transfer:  n=%d %.0f transfers/s\n", transfers, transfers / transfer_s);
+    std::printf("journal:   %llu frames %llu entries %.1f MiB %llu fsyncs (%.1f bytes/entry)\n",
+                (unsigned long long)st.frames, (unsigned long long)st.entries, st.bytes / 1048576.0,
+                (unsigned long long)st.syncs, double(st.bytes) / st.entries);
+
+    // the journal alone: re-append the portfolio audit in batch-sized frames to a second dir
+    {
+        std::string raw_dir = dir + ".raw";
+        std::filesystem::remove_all(raw_dir);
+        Portfolio empty;
+        p4::Journal raw(raw_dir, opts);
+        raw.recover(empty);
+        const std::vector<p4::TxEntry> &audit = live.audit();
+        sw.reset();
+        for (size_t i = 0; i < audit.size(); i += batch)
+        {
+            raw.begin_frame(live);
+            raw.log_entries(live, audit.data() + i, std::min<size_t>(batch, audit.size() - i));
+            raw.end_frame();
+        }
+        raw.sync();
+        std::printf("append:    %.0f entries/s (journal only, %llu fsyncs)\n", audit.size() / sw.seconds(),
+                    (unsigned long long)raw.stats().syncs);
+        std::filesystem::remove_all(raw_dir);
+    }
+
+    std::printf("recovery from the full journal:\n");
+    double full_s = recover_once(dir, live, ids);
+
+    sw.reset();
+    journal.snapshot(live);
+    std::printf("snapshot:  %zu accounts in %.3f s\n", live.count(), sw.seconds());
+    for (long long done = 0; done < tail_tx; done += batch)
+    {
+        fill(txs, total_tx + done);
+        live.apply_all(txs);
+    }
+    journal.sync();
+    std::printf("recovery from snapshot + %lld tx tail:\n", tail_tx);
+    double tail_s = recover_once(dir, live, ids);
+    std::printf("tail recovery %.1fx faster\n", full_s / tail_s);
+
+    live.attach_journal(nullptr);
+    std::filesystem::remove_all(dir);
+    return 0;
+}
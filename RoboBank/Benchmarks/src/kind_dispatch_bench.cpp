@@ -0,0 +1,172 @@
+// TxKind dispatch (tx_kinds.h): posts a mixed-kind workload to a plain balance array with the
+// old per-entry switch, with the shared kind_delta table, and sorted into runs of one kind with
+// a kernel per kind (Calculator::with_kind); then the same batches through Portfolio::apply_all
+// one entry at a time and with set_apply_by_kind. Checks that every variant leaves the same
+// balances, and that both portfolios hold the same audits.
+// usage: KindDispatchBench [tx] [accounts] [reps]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "tx_kinds.h"
+#include "bench_util.h"
+#include "workload.h"
+
+struct Posting
+{
+    std::uint32_t account;
+    int kind;
+    long long amount_cents;
+};
+
+// the posting loop before the shared table, kept as the baseline
+static void switch_loop(long long *balance, const Posting *tx, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        switch (tx[i].kind)
+        {
+        case 0:
+        case 3:
+        case 4:
+            balance[tx[i].account] += tx[i].amount_cents;
+            break;
+        case 1:
+        case 2:
+        case 5:
+            balance[tx[i].account] -= tx[i].amount_cents;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void table_loop(long long *balance, const Posting *tx, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        balance[tx[i].account] += Calculator::kind_delta(tx[i].kind, tx[i].amount_cents);
+}
+
+// the order is rebuilt on every call, as AccountTable::apply_by_kind does per batch
+static void by_kind_loop(long long *balance, const Posting *tx, size_t n, std::vector<std::uint32_t> &order)
+{
+    const int kinds = Calculator::kTxKinds;
+    size_t start[kinds + 1] = {};
+    for (size_t i = 0; i < n; ++i)
+        if (Calculator::known_kind(tx[i].kind)) ++start[tx[i].kind + 1];
+    for (int k = 0; k < kinds; ++k)
+        start[k + 1] += start[k];
+    order.resize(start[kinds]);
+    size_t fill[kinds];
+    for (int k = 0; k < kinds; ++k)
+        fill[k] = start[k];
+    for (size_t i = 0; i < n; ++i)
+        if (Calculator::known_kind(tx[i].kind)) order[fill[tx[i].kind]++] = static_cast<std::uint32_t>(i);
+    for (int k = 0; k < kinds; ++k)
+        Calculator::with_kind(k, [&](auto traits) {
+            using Kind = decltype(traits);
+            for (size_t j = start[k]; j < start[k + 1]; ++j)
+            {
+                const Posting &t = tx[order[j]];
+                balance[t.account] = Kind::post(balance[t.account], t.amount_cents);
+            }
+        });
+}
+
+static void setup(Portfolio &p, std::uint32_t accounts)
+{
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0, 16};
+    for (std::uint32_t i = 0; i < accounts; ++i)
+        p.add_account(bench::workload_account_id(i), s, 0);
+}
+
+static bool same_books(const Portfolio &a, const Portfolio &b, std::uint32_t accounts)
+{
+    if (a.total_exposure() != b.total_exposure()) return false;
+    for (std::uint32_t i = 0; i < accounts; ++i)
+    {
+        std::string id = bench::workload_account_id(i);
+        if (a.balance_of(id) != b.balance_of(id)) return false;
+        AuditView<p4::TxEntry> x = a.get_account(id)->audit(), y = b.get_account(id)->audit();
+        if (x.size() != y.size()) return false;
+        for (size_t j = 0; j < x.size(); ++j)
+            if (x[j].kind != y[j].kind || x[j].amount_cents != y[j].amount_cents || x[j].timestamp != y[j].timestamp)
+                return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    bench::WorkloadOptions w;
+    w.accounts = argc > 2 ? static_cast<std::uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100000;
+    const int reps = argc > 3 ? std::atoi(argv[3]) : 5;
+    std::vector<bench::WorkloadOp> ops = bench::make_workload(w, total_tx);
+
+    // a transfer becomes its out and in legs, so all six kinds are in the mix
+    std::vector<Posting> tx;
+    tx.reserve(total_tx * 2);
+    for (const bench::WorkloadOp &op : ops)
+    {
+        tx.push_back(Posting{op.account, op.kind, op.amount_cents});
+        if (op.transfer()) tx.push_back(Posting{op.to, 4, op.amount_cents});
+    }
+    const size_t n = tx.size(), batch = 1000;
+    std::printf("%zu postings, %u accounts, batches of %zu, best of %d\n", n, w.accounts, batch, reps);
+
+    std::vector<long long> expect(w.accounts, 0);
+    switch_loop(expect.data(), tx.data(), n);
+    std::vector<std::uint32_t> order;
+    auto kernel = [&](const char *name, auto fn) {
+        double best = 1e30;
+        bool match = true;
+        for (int r = 0; r < reps; ++r)
+        {
+            std::vector<long long> balance(w.accounts, 0);
+            bench::Stopwatch sw;
+            for (size_t b = 0; b < n; b += batch)
+                fn(balance.data(), tx.data() + b, std::min(batch, n - b));
+            double s = sw.seconds();
+            if (s < best) best = s;
+            match = match && balance == expect;
+        }
+        std::printf("%-22s %7.1f M postings/s  %s\n", name, n / best / 1e6, match ? "match" : "MISMATCH");
+    };
+    kernel("switch per entry", switch_loop);
+    kernel("kind_delta table", table_loop);
+    kernel("runs by kind", [&](long long *balance, const Posting *t, size_t m) { by_kind_loop(balance, t, m, order); });
+
+    // the portfolio path: balances, running totals and audit rings
+    std::vector<std::vector<p4::TxRecord>> batches;
+    for (size_t b = 0; b < n; b += batch)
+    {
+        batches.emplace_back();
+        for (size_t i = b; i < std::min(n, b + batch); ++i)
+            batches.back().push_back(p4::TxRecord{static_cast<p4::TxKind>(tx[i].kind), tx[i].amount_cents,
+                                                  static_cast<long long>(i), "", bench::workload_account_id(tx[i].account)});
+    }
+    Portfolio one, runs;
+    setup(one, w.accounts);
+    setup(runs, w.accounts);
+    runs.set_apply_by_kind(true);
+    double secs[2] = {1e30, 1e30};
+    for (int r = 0; r < reps; ++r)
+    {
+        Portfolio *p[2] = {&one, &runs};
+        for (int v = 0; v < 2; ++v)
+        {
+            bench::Stopwatch sw;
+            for (const std::vector<p4::TxRecord> &b : batches)
+                p[v]->apply_all(b);
+            double s = sw.seconds();
+            if (s < secs[v]) secs[v] = s;
+        }
+    }
+    const bool match = same_books(one, runs, w.accounts) && one.verify_totals() && runs.verify_totals();
+    std::printf("%-22s %7.1f M postings/s\n", "apply_all", n / secs[0] / 1e6);
+    std::printf("%-22s %7.1f M postings/s  %s\n", "apply_all by kind", n / secs[1] / 1e6, match ? "match" : "MISMATCH");
+    return 0;
+}
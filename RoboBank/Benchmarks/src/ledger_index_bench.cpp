@@ -0,0 +1,76 @@
+// Linear strcmp lookup vs hash-indexed lookup for the P2 ledger arrays.
+#include <cstdio>
+#include <vector>
+#include "RoboBankLedger.h"
+#include "bench_util.h"
+
+struct Book
+{
+    explicit Book(int capacity)
+        : ids(static_cast<size_t>(capacity) * MAX_LEN), balance(capacity),
+          index(index_capacity_for(capacity)), capacity(capacity) {}
+
+    char (*id_rows())[MAX_LEN] { return reinterpret_cast<char (*)[MAX_LEN]>(ids.data()); }
+
+    std::vector<char> ids;
+    std::vector<int> balance;
+    std::vector<int> index;
+    int capacity;
+    int count = 0;
+};
+
+static void make_id(char out[MAX_LEN], int n)
+{
+    std::snprintf(out, MAX_LEN, "AC-%09d", n);
+}
+
+static void run(int accounts)
+{
+    Book book(accounts);
+    index_init(book.index.data(), static_cast<int>(book.index.size()));
+
+    char id[MAX_LEN];
+    bench::Stopwatch sw;
+    for (int i = 0; i < accounts; i++)
+    {
+        make_id(id, i);
+        get_or_create_account_indexed(book.id_rows(), book.balance.data(), book.index.data(), static_cast<int>(book.index.size()),
+                                      book.capacity, book.count, id);
+    }
+    double build_s = sw.seconds();
+
+    // A linear scan over 1M accounts costs milliseconds per lookup, so it gets a smaller sample
+    const int indexed_lookups = 1000000;
+    const int linear_lookups = accounts >= 1000000 ? 200 : (accounts >= 100000 ? 2000 : 20000);
+
+    std::vector<std::vector<char>> probes;
+    bench::Rng rng(42);
+    for (int i = 0; i < indexed_lookups; i++)
+    {
+        make_id(id, static_cast<int>(rng.below(accounts)));
+        probes.emplace_back(id, id + MAX_LEN);
+    }
+
+    long long sum = 0;
+    sw.reset();
+    for (int i = 0; i < linear_lookups; i++)
+        sum += find_account_index(book.id_rows(), book.count, probes[i].data());
+    double linear_ns = sw.seconds() * 1e9 / linear_lookups;
+
+    sw.reset();
+    for (int i = 0; i < indexed_lookups; i++)
+        sum += index_find(book.id_rows(), book.index.data(), static_cast<int>(book.index.size()), probes[i].data());
+    double indexed_ns = sw.seconds() * 1e9 / indexed_lookups;
+    bench::keep(sum);
+
+    std::printf("accounts=%-8d build_indexed=%.3fs linear=%.1f ns/lookup indexed=%.1f ns/lookup speedup=%.0fx\n",
+                accounts, build_s, linear_ns, indexed_ns, linear_ns / indexed_ns);
+}
+
+int main()
+{
+    run(10000);
+    run(100000);
+    run(1000000);
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Portfolio memory sources (p4::MemoryOptions): builds a book and replays a transaction stream
+// through apply_checked in small batches, once with everything on the heap (one block per
+// audit ring and growth step, heap scratch per batch) and once with the defaults (pooled audit
+// rings, per-batch arena). Reports operator new calls and resident memory for each phase.
+// Each mode runs in its own process so the RSS figures do not mix; note that alloc_counter.h
+// adds a 16-byte prefix to every block, on top of malloc's own header.
+// usage: MemoryBench [accounts] [tx] [batch] [heap|pooled]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "portfolio.h"
+#include "audit_store.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+
+static std::string account_id(size_t i) { return "AC-" + std::to_string(10000000 + i); }
+
+// resident set now, and its peak, in MB
+static double rss_mb()
+{
+    long pages = 0, resident = 0;
+    if (FILE *f = std::fopen("/proc/self/statm", "r"))
+    {
+        if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(f);
+    }
+    return double(resident) * sysconf(_SC_PAGESIZE) / (1 << 20);
+}
+
+static double peak_rss_mb()
+{
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return double(ru.ru_maxrss) / 1024; // KB on Linux
+}
+
+static int run(size_t accounts, size_t total_tx, size_t batch, bool pooled)
+{
+    p4::MemoryOptions mem;
+    if (!pooled)
+    {
+        mem.pooled_audit = false;
+        mem.batch_arena_bytes = 0;
+    }
+    const char *name = pooled ? "pooled" : "heap";
+    long long allocs = bench::alloc_count().load();
+    bench::Stopwatch sw;
+
+    Portfolio p(mem);
+    p4::AuditStoreOptions so;
+    so.resident_segments = 4; // keep the portfolio audit bounded; older segments compact
+    p4::AuditStore store(so);
+    p.attach_audit_store(&store);
+    p.reserve(accounts);
+    for (size_t i = 0; i < accounts; ++i)
+    {
+        p4::AccountSettings s{static_cast<int>(i % 4 == 3 ? AccountType::Savings : AccountType::Checking),
+                              i % 4 == 3 ? 0.02 : 0.0, i % 4 == 3 ? 0 : 500, p4::kDefaultAuditCapacity};
+        p.add_account(account_id(i), s, 100000);
+    }
+    std::printf("%-6s build  %8zu accounts %6.2fs  allocs %10lld  rss %7.1f MB\n", name, accounts, sw.seconds(),
+                bench::alloc_count().load() - allocs, rss_mb());
+
+    // the stream is generated outside the counted and timed windows
+    bench::Rng rng(7);
+    std::vector<p4::TxRecord> txs(batch);
+    long long apply_allocs = 0;
+    size_t rejected = 0;
+    double s = 0;
+    for (size_t done = 0; done < total_tx; done += batch)
+    {
+        for (auto &t : txs)
+        {
+            t.kind = static_cast<p4::TxKind>(rng.below(3));
+            t.amount_cents = static_cast<long long>(rng.below(10000));
+            t.timestamp = static_cast<long long>(done);
+            t.note = "replay";
+            t.account_id = account_id(rng.below(accounts));
+        }
+        allocs = bench::alloc_count().load();
+        sw.reset();
+        rejected += p.apply_checked(txs).size();
+        s += sw.seconds();
+        apply_allocs += bench::alloc_count().load() - allocs;
+    }
+    std::printf("%-6s replay %8zu tx       %6.2fs  allocs %10lld  rss %7.1f MB  peak %7.1f MB  (%.2fM tx/s, "
+                "%.2f allocs/batch, rejected %zu, exposure %lld)\n",
+                name, total_tx, s, apply_allocs, rss_mb(), peak_rss_mb(), total_tx / s / 1e6,
+                double(apply_allocs) / ((total_tx + batch - 1) / batch), rejected, p.total_exposure());
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t accounts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+    size_t tx = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    size_t batch = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1000;
+    if (batch == 0) batch = 1;
+    if (argc > 4) return run(accounts, tx, batch, std::strcmp(argv[4], "pooled") == 0);
+
+    // one process per mode
+    for (const char *mode : {"heap", "pooled"})
+    {
+        std::string cmd = std::string(argv[0]) + " " + std::to_string(accounts) + " " + std::to_string(tx) + " " +
+                          std::to_string(batch) + " " + mode;
+        if (std::system(cmd.c_str()) != 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Portfolio metrics (metrics.h): runs a workload with unknown ids and refused transfers, checks
+// the counters against what the workload did, prints the latency quantiles, and reads the
+// Prometheus text back from write_metrics_file and from a MetricsServer. For the overhead,
+// compare RoboBankBench --filter p4 between builds with PORTFOLIO_METRICS ON and OFF.
+// usage: MetricsBench [tx] [accounts] [metrics_file]
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "portfolio.h"
+#include "metrics.h"
+#include "bench_util.h"
+#include "workload.h"
+
+static std::string fetch(unsigned short port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    std::string resp;
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+    {
+        const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+        (void)::send(fd, req, sizeof(req) - 1, 0);
+        char buf[4096];
+        for (ssize_t n; (n = ::recv(fd, buf, sizeof(buf), 0)) > 0;)
+            resp.append(buf, static_cast<size_t>(n));
+    }
+    if (fd >= 0) ::close(fd);
+    return resp;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    bench::WorkloadOptions w;
+    w.accounts = argc > 2 ? static_cast<std::uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100000;
+    const std::string path = argc > 3 ? argv[3] : "metrics.prom";
+    if (!PORTFOLIO_METRICS) std::printf("built with PORTFOLIO_METRICS=0: every figure below is 0\n");
+
+    // half the accounts exist up front, so apply_all auto-creates the rest as they show up
+    Portfolio p;
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0, 16};
+    for (std::uint32_t i = 0; i < w.accounts / 2; ++i)
+        p.add_account(bench::workload_account_id(i), s, 10000);
+    p4::reset_metrics();
+
+    std::vector<bench::WorkloadOp> ops = bench::make_workload(w, total_tx);
+    std::vector<p4::TxRecord> batch;
+    size_t expect_transfers = 0, batches = 0;
+    bench::Stopwatch sw;
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        const bench::WorkloadOp &op = ops[i];
+        if (op.transfer())
+        {
+            // one transfer in ten names an account that never exists
+            std::string to = i % 10 == 0 ? "NO-SUCH-ACCOUNT" : bench::workload_account_id(op.to);
+            p.transfer(p4::TransferRecord{bench::workload_account_id(op.account), to, op.amount_cents, op.timestamp, ""});
+            ++expect_transfers;
+            continue;
+        }
+        batch.push_back(p4::TxRecord{static_cast<p4::TxKind>(op.kind), op.amount_cents, op.timestamp, "",
+                                     bench::workload_account_id(op.account)});
+        if (batch.size() == 1000 || i + 1 == ops.size())
+        {
+            p.apply_all(batch);
+            batch.clear();
+            ++batches;
+        }
+    }
+    double secs = sw.seconds();
+
+    p4::MetricsSnapshot m = p4::metrics_snapshot();
+    bool ok = !PORTFOLIO_METRICS ||
+              (m[p4::Counter::Transfers] == expect_transfers && m[p4::Counter::Batches] == batches &&
+               m[p4::Counter::AutoCreated] == p.count() - w.accounts / 2 &&
+               m[p4::Counter::TransferMissing] >= expect_transfers / 10 &&
+               m.of(p4::Timer::Batch).count == batches);
+    std::printf("%zu ops in %.2fs: applied=%llu batches=%llu auto_created=%llu transfers=%llu missing=%llu "
+                "refused=%llu lookups=%llu misses=%llu evictions=%llu %s\n",
+                total_tx, secs, (unsigned long long)m[p4::Counter::TxApplied], (unsigned long long)m[p4::Counter::Batches],
+                (unsigned long long)m[p4::Counter::AutoCreated], (unsigned long long)m[p4::Counter::Transfers],
+                (unsigned long long)m[p4::Counter::TransferMissing], (unsigned long long)m[p4::Counter::TransferRefused],
+                (unsigned long long)m[p4::Counter::Lookups], (unsigned long long)m[p4::Counter::LookupMisses],
+                (unsigned long long)m[p4::Counter::AuditEvictions], ok ? "match" : "MISMATCH");
+    const char *names[] = {"batch", "transfer", "lookup"};
+    for (int t = 0; t < static_cast<int>(p4::Timer::Count); ++t)
+    {
+        const p4::LatencyHistogram &h = m.latency[t];
+        std::printf("  %-8s samples=%-8llu p50<=%lluns p99<=%lluns mean=%.0fns\n", names[t], (unsigned long long)h.count,
+                    (unsigned long long)h.quantile_ns(0.5), (unsigned long long)h.quantile_ns(0.99),
+                    h.count ? double(h.sum_ns) / h.count : 0.0);
+    }
+
+    // the exports carry the same counters
+    const std::string line = "portfolio_transfers_total " + std::to_string(m[p4::Counter::Transfers]) + "\n";
+    bool file_ok = p4::write_metrics_file(path);
+    std::stringstream text;
+    text << std::ifstream(path).rdbuf();
+    p4::MetricsServer server;
+    bool served = server.start(0);
+    std::string resp = served ? fetch(server.port()) : std::string();
+    std::printf("file %s: %s, server :%u: %s\n", path.c_str(),
+                file_ok && text.str().find(line) != std::string::npos ? "match" : "MISMATCH", server.port(),
+                served && resp.rfind("HTTP/1.0 200", 0) == 0 && resp.find(line) != std::string::npos ? "match" : "MISMATCH");
+    return 0;
+}
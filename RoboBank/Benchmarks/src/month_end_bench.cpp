@@ -0,0 +1,77 @@
+// Month-end close: Portfolio::close_month against the per-account loop it replaces (one
+// IAccount call per account: post_simple_interest for savings, charge_fee for checking).
+// Each path closes four months and the fourth is timed: by then the facades exist and the
+// portfolio audit has capacity for it, so fresh-page faults are not what gets measured.
+// usage: MonthEndBench [accounts] [threads...]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "bench_util.h"
+
+static void build(Portfolio &p, size_t accounts)
+{
+    p.reserve(accounts);
+    for (size_t i = 0; i < accounts; i++)
+    {
+        // one account in four is savings; a few distinct rates and fees
+        bool savings = i % 4 == 3;
+        p4::AccountSettings s{static_cast<int>(savings ? AccountType::Savings : AccountType::Checking),
+                              savings ? 0.01 + 0.005 * (i % 5) : 0.0, savings ? 0 : 100 + 25 * static_cast<long long>(i % 3), 16};
+        p.add_account("AC-" + std::to_string(10000000 + i), s, 100000 + static_cast<long long>(i % 1000) * 997);
+    }
+}
+
+static void per_account_month(Portfolio &p, const std::vector<std::string> &ids, long long ts)
+{
+    for (const auto &id : ids)
+    {
+        std::unique_ptr<IAccount> a = p.get_account(id);
+        if (a->type() == AccountType::Savings)
+            a->post_simple_interest(30, 365, ts, "accrued interest");
+        else
+            a->charge_fee(a->settings().fee_flat_cents, ts, "monthly fee");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t accounts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    std::vector<unsigned> thread_counts;
+    for (int i = 2; i < argc; i++)
+        thread_counts.push_back(static_cast<unsigned>(std::atoi(argv[i])));
+    if (thread_counts.empty())
+        thread_counts = {1, 2, 4, 8};
+
+    Portfolio base;
+    build(base, accounts);
+    std::vector<std::string> ids = base.list_ids();
+    for (long long month = 1; month < 4; month++)
+        per_account_month(base, ids, month);
+    bench::Stopwatch sw;
+    per_account_month(base, ids, 4);
+    double base_s = sw.seconds();
+    std::printf("per-account  %8.1f ms  %.0f accounts/s\n", base_s * 1e3, accounts / base_s);
+
+    bool all_ok = true;
+    for (unsigned threads : thread_counts)
+    {
+        Portfolio p;
+        build(p, accounts);
+        p4::MonthEndOptions opts;
+        opts.threads = threads;
+        for (opts.timestamp = 1; opts.timestamp < 4; opts.timestamp++)
+            p.close_month(opts);
+        sw.reset();
+        p4::MonthEndReport r = p.close_month(opts);
+        double s = sw.seconds();
+        bool ok = p.total_exposure() == base.total_exposure();
+        for (size_t i = 0; ok && i < ids.size(); i += 1009)
+            ok = p.balance_of(ids[i]) == base.balance_of(ids[i]);
+        all_ok = all_ok && ok;
+        std::printf("close_month  %8.1f ms  %.0f accounts/s threads=%u speedup=%.1fx interest=%zu fees=%zu %s\n", s * 1e3,
+                    accounts / s, threads, base_s / s, r.interest_posted, r.fees_charged, ok ? "match" : "MISMATCH");
+    }
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+// Serial apply_all vs sharded apply_all_parallel over the same batch.
+// usage: ParallelApplyBench [tx] [accounts] [threads...]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "bench_util.h"
+
+static void build(Portfolio &p, const std::vector<std::string> &ids)
+{
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0};
+    for (const auto &id : ids)
+        p.add_account(id, s, 1000000);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 100000;
+    std::vector<unsigned> thread_counts;
+    for (int i = 3; i < argc; i++)
+        thread_counts.push_back(static_cast<unsigned>(std::atoi(argv[i])));
+    if (thread_counts.empty())
+        thread_counts = {1, 2, 4, 8, 16, 32};
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(1000000 + i));
+
+    bench::Rng rng(11);
+    std::vector<p4::TxRecord> txs(total_tx);
+    for (auto &t : txs)
+    {
+        t.kind = static_cast<p4::TxKind>(rng.below(3));
+        t.amount_cents = static_cast<long long>(rng.below(10000));
+        t.timestamp = 1;
+        t.note = "batch";
+        t.account_id = ids[rng.below(accounts)];
+    }
+
+    Portfolio serial;
+    build(serial, ids);
+    bench::Stopwatch sw;
+    serial.apply_all(txs);
+    double serial_s = sw.seconds();
+    std::printf("serial      %.0f tx/s\n", total_tx / serial_s);
+
+    for (unsigned threads : thread_counts)
+    {
+        Portfolio p;
+        build(p, ids);
+        sw.reset();
+        p.apply_all_parallel(txs, threads);
+        double s = sw.seconds();
+
+        bool same = p.total_exposure() == serial.total_exposure();
+        for (int i = 0; same && i < accounts; i += 97)
+            same = p.balance_of(ids[i]) == serial.balance_of(ids[i]);
+        std::printf("threads=%-3u %.0f tx/s speedup=%.2fx %s\n", threads, total_tx / s, serial_s / s,
+                    same ? "match" : "MISMATCH");
+    }
+    return 0;
+}
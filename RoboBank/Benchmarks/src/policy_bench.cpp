@@ -0,0 +1,96 @@
+// Policy-checked apply: Portfolio::apply_checked against apply_all on a batch where every
+// transaction passes (the happy path), then a batch with some bad transactions mixed in.
+// usage: PolicyBench [tx] [accounts] [reps]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "bench_util.h"
+
+static void build(Portfolio &p, const std::vector<std::string> &ids, long long opening)
+{
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        p4::AccountSettings s{static_cast<int>(i % 4 == 3 ? AccountType::Savings : AccountType::Checking), 0.0, 0};
+        p.add_account(ids[i], s, opening);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 100000;
+    const int reps = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(1000000 + i));
+    bench::Rng rng(13);
+    std::vector<p4::TxRecord> txs(total_tx);
+    for (auto &t : txs)
+        t = p4::TxRecord{static_cast<p4::TxKind>(rng.below(3)), static_cast<long long>(rng.below(10000)), 1, "batch",
+                         ids[rng.below(accounts)]};
+
+    // fresh portfolios per run, alternating the two paths so drift hits both
+    double t_all = 1e30, t_checked = 1e30;
+    bool ok = true;
+    for (int r = 0; r < reps; r++)
+    {
+        Portfolio a, b;
+        build(a, ids, 100000000);
+        build(b, ids, 100000000);
+        std::vector<p4::TxRejection> rej;
+        bench::Stopwatch sw;
+        if (r % 2)
+        {
+            rej = b.apply_checked(txs);
+            t_checked = std::min(t_checked, sw.seconds());
+            sw.reset();
+            a.apply_all(txs);
+            t_all = std::min(t_all, sw.seconds());
+        }
+        else
+        {
+            a.apply_all(txs);
+            t_all = std::min(t_all, sw.seconds());
+            sw.reset();
+            rej = b.apply_checked(txs);
+            t_checked = std::min(t_checked, sw.seconds());
+        }
+        ok = ok && rej.empty() && a.total_exposure() == b.total_exposure();
+    }
+    std::printf("happy path: apply_all %.0f tx/s, apply_checked %.0f tx/s (%+.1f%%) %s\n", total_tx / t_all,
+                total_tx / t_checked, (t_checked / t_all - 1) * 100, ok ? "match" : "MISMATCH");
+
+    // one in 25 is bad: unknown kind, negative amount, too large, interest posted to checking
+    // or a withdrawal past the overdraft limit
+    p4::TxPolicy policy;
+    policy.max_amount_cents = 1000000;
+    policy.allowed_kinds[AccountType::Checking] &= ~(1u << p4::TxKind::Interest);
+    policy.overdraft_limit_cents[AccountType::Checking] = 50000;
+    Portfolio p;
+    build(p, ids, 100000);
+    p.set_policy(policy);
+    for (size_t i = 0; i < txs.size(); i += 25)
+    {
+        switch (i / 25 % 5)
+        {
+        case 0: txs[i].kind = static_cast<p4::TxKind>(9); break;
+        case 1: txs[i].amount_cents = -txs[i].amount_cents - 1; break;
+        case 2: txs[i].amount_cents = 5000000; break;
+        case 3: txs[i].kind = p4::TxKind::Interest; break;
+        default: txs[i].kind = p4::TxKind::Withdrawal; txs[i].amount_cents = 1000000; break;
+        }
+    }
+    bench::Stopwatch sw;
+    std::vector<p4::TxRejection> rej = p.apply_checked(txs, false);
+    double s = sw.seconds();
+    size_t by_reason[7] = {0, 0, 0, 0, 0, 0, 0};
+    for (const p4::TxRejection &r : rej)
+        by_reason[static_cast<int>(r.reason)]++;
+    std::printf("mixed: %.0f tx/s, %zu rejected: unknown_kind=%zu negative=%zu too_large=%zu not_allowed=%zu overdraft=%zu\n",
+                total_tx / s, rej.size(), by_reason[1], by_reason[2], by_reason[3], by_reason[4], by_reason[5]);
+    ok = ok && by_reason[1] && by_reason[2] && by_reason[3] && by_reason[4] && by_reason[5];
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,68 @@
+// Replays a synthetic transaction stream through Portfolio::apply_all and transfer,
+// reporting throughput and heap allocations per transaction.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+
+int main(int argc, char **argv)
+{
+    const long long total_tx = argc > 1 ? std::atoll(argv[1]) : 10000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 100000;
+    const int batch = 100000;
+
+    // notes longer than the SSO buffer, drawn from a small set as real feeds are
+    std::vector<std::string> notes;
+    for (int i = 0; i < 32; i++)
+        notes.push_back("card purchase merchant #" + std::to_string(1000 + i));
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(1000000 + i));
+
+    Portfolio p;
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0};
+    for (int i = 0; i < accounts; i++)
+        p.add_account(ids[i], s, 1000000);
+
+    bench::Rng rng(7);
+    std::vector<p4::TxRecord> txs(batch);
+    double apply_s = 0;
+    long long apply_allocs = 0;
+    for (long long done = 0; done < total_tx; done += batch)
+    {
+        for (auto &t : txs)
+        {
+            t.kind = static_cast<p4::TxKind>(rng.below(3)); // deposit / withdrawal / fee
+            t.amount_cents = static_cast<long long>(rng.below(10000));
+            t.timestamp = done;
+            t.note = notes[rng.below(notes.size())];
+            t.account_id = ids[rng.below(accounts)];
+        }
+        long long a0 = bench::alloc_count().load();
+        bench::Stopwatch sw;
+        p.apply_all(txs);
+        apply_s += sw.seconds();
+        apply_allocs += bench::alloc_count().load() - a0;
+    }
+
+    const int transfers = 1000000;
+    std::vector<p4::TransferRecord> trs(transfers);
+    for (auto &tr : trs)
+        tr = p4::TransferRecord{ids[rng.below(accounts)], ids[rng.below(accounts)], 100, 1, notes[rng.below(notes.size())]};
+    long long a0 = bench::alloc_count().load();
+    bench::Stopwatch sw;
+    for (const auto &tr : trs)
+        p.transfer(tr);
+    double transfer_s = sw.seconds();
+    long long transfer_allocs = bench::alloc_count().load() - a0;
+
+    std::printf("apply_all: tx=%lld accounts=%d %.0f tx/s allocs=%lld (%.3f per tx)\n",
+                total_tx, accounts, total_tx / apply_s, apply_allocs, double(apply_allocs) / total_tx);
+    std::printf("transfer:  n=%d %.0f transfers/s allocs=%lld (%.3f per transfer)\n",
+                transfers, transfers / transfer_s, transfer_allocs, double(transfer_allocs) / transfers);
+    bench::keep(p.total_exposure());
+    return 0;
+}
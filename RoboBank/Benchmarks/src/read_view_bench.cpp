@@ -0,0 +1,175 @@
+// Read views (read_view.h): one writer applies a workload in batches while reader threads run
+// whole-book reports on point-in-time views (p4::ReadView). Compares the writer with views
+// off, with views on but no readers, and with readers, in transactions per second of wall
+// time and of writer CPU time (the fair figure when readers share the writer's cores). Every
+// report checks that its view adds up (sum of balances == running total, account count), and
+// the last view is compared with the live portfolio.
+// usage: ReadViewBench [tx] [accounts] [readers] [pause_ms between reports] [with_audit 0/1]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include "portfolio.h"
+#include "bench_util.h"
+#include "workload.h"
+
+static double thread_cpu_seconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Run
+{
+    double wall = 0;
+    double cpu = 0;
+    size_t reports = 0;
+    size_t views = 0;
+    size_t torn = 0; // reports whose view did not add up
+    size_t audit_entries = 0;
+    bool final_match = true;
+};
+
+static void setup(Portfolio &p, std::uint32_t accounts)
+{
+    // half the accounts exist up front, the rest are auto-created, so views also see rows added
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0, 16};
+    for (std::uint32_t i = 0; i < accounts / 2; ++i)
+        p.add_account(bench::workload_account_id(i), s, 10000);
+}
+
+static void apply_workload(Portfolio &p, const std::vector<bench::WorkloadOp> &ops)
+{
+    std::vector<p4::TxRecord> batch;
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+        const bench::WorkloadOp &op = ops[i];
+        if (op.transfer())
+            p.transfer(p4::TransferRecord{bench::workload_account_id(op.account), bench::workload_account_id(op.to),
+                                          op.amount_cents, op.timestamp, ""});
+        else
+            batch.push_back(p4::TxRecord{static_cast<p4::TxKind>(op.kind), op.amount_cents, op.timestamp, "",
+                                         bench::workload_account_id(op.account)});
+        if (batch.size() == 1000 || (i + 1 == ops.size() && !batch.empty()))
+        {
+            p.apply_all(batch);
+            batch.clear();
+        }
+    }
+}
+
+// a whole-book report: every balance, per type, and the id list
+static bool report(const p4::ReadView &v, size_t &audit_entries)
+{
+    long long sum[2] = {0, 0};
+    size_t accounts = 0;
+    for (p4::AccountHandle h = 0; h < v.rows(); ++h)
+    {
+        if (!v.contains(h)) continue;
+        sum[v.type_of(h) == AccountType::Savings] += v.balance_of(h);
+        ++accounts;
+        size_t n = 0;
+        if (v.has_audit() && v.audit(h, n)) audit_entries += n;
+    }
+    std::vector<std::string> ids = v.list_ids();
+    return sum[0] == v.total_of(AccountType::Checking) && sum[1] == v.total_of(AccountType::Savings) &&
+           accounts == v.count() && ids.size() == v.count();
+}
+
+static Run run(const std::vector<bench::WorkloadOp> &ops, std::uint32_t accounts, bool views, unsigned readers,
+               unsigned pause_ms, bool with_audit)
+{
+    Portfolio p;
+    setup(p, accounts);
+    p4::ReadViewOptions o;
+    o.with_audit = with_audit;
+    if (views) p.enable_read_views(o);
+
+    Run r;
+    std::atomic<bool> done{false};
+    std::atomic<size_t> reports{0}, torn{0}, audit_entries{0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < readers; ++t)
+        threads.emplace_back([&] {
+            std::uint64_t last = 0;
+            size_t entries = 0;
+            while (!done.load())
+            {
+                std::shared_ptr<const p4::ReadView> v = p.next_view(std::chrono::milliseconds(50));
+                if (!v || v->version() == last) continue;
+                last = v->version();
+                if (!report(*v, entries)) torn.fetch_add(1);
+                reports.fetch_add(1);
+                if (pause_ms) std::this_thread::sleep_for(std::chrono::milliseconds(pause_ms));
+            }
+            audit_entries.fetch_add(entries);
+        });
+
+    bench::Stopwatch sw;
+    double cpu = thread_cpu_seconds();
+    apply_workload(p, ops);
+    r.cpu = thread_cpu_seconds() - cpu;
+    r.wall = sw.seconds();
+    done.store(true);
+    for (std::thread &t : threads)
+        t.join();
+
+    r.reports = reports.load();
+    r.torn = torn.load();
+    r.audit_entries = audit_entries.load();
+    if (views)
+    {
+        std::shared_ptr<const p4::ReadView> v = p.publish_view();
+        r.views = v->version();
+        r.final_match = v->count() == p.count() && v->total_exposure() == p.total_exposure();
+        for (p4::AccountHandle h = 0; h < v->rows() && r.final_match; ++h)
+        {
+            if (!v->contains(h)) continue;
+            std::string id(v->id_of(h));
+            r.final_match = p.balance_of(id) == v->balance_of(h) && p.handle_of(id) == h;
+            if (with_audit && r.final_match)
+            {
+                std::unique_ptr<IAccount> acc = p.get_account(id);
+                AuditView<p4::TxEntry> live = acc->audit();
+                size_t n = 0;
+                const p4::TxEntry *copy = v->audit(h, n);
+                r.final_match = live.size() == n;
+                for (size_t i = 0; i < n && r.final_match; ++i)
+                    r.final_match = live[i].amount_cents == copy[i].amount_cents && live[i].timestamp == copy[i].timestamp;
+            }
+        }
+    }
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    bench::WorkloadOptions w;
+    w.accounts = argc > 2 ? static_cast<std::uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100000;
+    const unsigned readers = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 2;
+    const unsigned pause_ms = argc > 4 ? static_cast<unsigned>(std::strtoul(argv[4], nullptr, 10)) : 10;
+    const bool with_audit = argc > 5 && std::atoi(argv[5]) != 0;
+    std::vector<bench::WorkloadOp> ops = bench::make_workload(w, total_tx);
+    std::printf("%zu ops, %u accounts, %u readers pausing %ums, with_audit=%d, %u hardware threads\n", total_tx,
+                w.accounts, readers, pause_ms, with_audit, std::thread::hardware_concurrency());
+
+    Run base = run(ops, w.accounts, false, 0, 0, with_audit);
+    Run idle = run(ops, w.accounts, true, 0, 0, with_audit);
+    Run busy = run(ops, w.accounts, true, readers, pause_ms, with_audit);
+    auto line = [&](const char *name, const Run &r) {
+        std::printf("%-22s %9.0f tx/s wall %9.0f tx/s writer-cpu (%+5.1f%%)  views=%zu reports=%zu torn=%zu %s\n", name,
+                    total_tx / r.wall, total_tx / r.cpu, (base.cpu / r.cpu - 1) * 100, r.views, r.reports, r.torn,
+                    r.torn == 0 && r.final_match ? "match" : "MISMATCH");
+    };
+    line("views off", base);
+    line("views on, no readers", idle);
+    line("views on, readers", busy);
+    if (with_audit) std::printf("audit entries read by reports: %zu\n", busy.audit_entries);
+    return 0;
+}
@@ -0,0 +1,88 @@
+// Startup time: rebuilding a Portfolio with add_account + replay vs a columnar snapshot, either
+// mapped and served in place (MappedSnapshot) or loaded back into a Portfolio.
+// The file is in the page cache here, so mapped timings are the warm-start case.
+// usage: SnapshotStartupBench [accounts] [tx] [path]
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "snapshot.h"
+#include "bench_util.h"
+
+int main(int argc, char **argv)
+{
+    const int accounts = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const size_t total_tx = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+    const std::string path = argc > 3 ? argv[3] : "snapshot_bench.rbcs";
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(10000000 + i));
+    bench::Rng rng(3);
+    std::vector<p4::TxRecord> txs(total_tx);
+    for (auto &t : txs)
+    {
+        t.kind = static_cast<p4::TxKind>(rng.below(3));
+        t.amount_cents = static_cast<long long>(rng.below(10000));
+        t.timestamp = 1;
+        t.note = "batch";
+        t.account_id = ids[rng.below(accounts)];
+    }
+
+    // small rings keep a million accounts within memory; the point is the account table
+    p4::AccountSettings chk{static_cast<int>(AccountType::Checking), 0.0, 150, 8};
+    p4::AccountSettings sav{static_cast<int>(AccountType::Savings), 0.05, 0, 8};
+    bench::Stopwatch sw;
+    Portfolio live;
+    for (int i = 0; i < accounts; i++)
+        live.add_account(ids[i], i % 4 ? chk : sav, 1000000);
+    live.apply_all(txs);
+    double rebuild_s = sw.seconds();
+    std::printf("rebuild (add_account + replay %zu tx): %.1f ms\n", total_tx, rebuild_s * 1e3);
+
+    for (int with_audit = 0; with_audit < 2; with_audit++)
+    {
+        sw.reset();
+        if (!live.save_snapshot(path, with_audit != 0))
+        {
+            std::printf("save_snapshot failed\n");
+            return 1;
+        }
+        std::printf("%s\n  save: %.1f ms, %.1f MiB\n", with_audit ? "with audit:" : "balances only:", sw.seconds() * 1e3,
+                    std::filesystem::file_size(path) / 1048576.0);
+
+        // time to first answer: open, one lookup, one report
+        sw.reset();
+        p4::MappedSnapshot snap;
+        bool ok = snap.open(path);
+        long long first = snap.balance_of(ids[accounts / 2]);
+        auto totals = snap.totals_by_type();
+        double first_ms = sw.seconds() * 1e3;
+        ok = ok && first == live.balance_of(ids[accounts / 2]) && totals == live.totals_by_type() &&
+             snap.total_exposure() == live.total_exposure();
+        sw.reset();
+        for (int i = 0; ok && i < accounts; i++)
+            ok = snap.balance_of(ids[i]) == live.balance_of(ids[i]);
+        std::printf("  mapped: first answer %.3f ms, all %d lookups %.1f ms %s\n", first_ms, accounts,
+                    sw.seconds() * 1e3, ok ? "match" : "MISMATCH");
+
+        sw.reset();
+        Portfolio loaded;
+        ok = loaded.load_snapshot(path) && ok;
+        double load_ms = sw.seconds() * 1e3;
+        ok = ok && loaded.count() == live.count() && loaded.totals_by_type() == live.totals_by_type();
+        if (with_audit)
+        {
+            std::unique_ptr<IAccount> a = live.get_account(ids[0]), b = loaded.get_account(ids[0]);
+            ok = ok && a->audit().size() == b->audit().size() &&
+                 (a->audit().empty() || live.note_of(a->audit().back().note) == loaded.note_of(b->audit().back().note));
+        }
+        std::printf("  load_snapshot into Portfolio: %.1f ms (%.1fx faster than rebuild) %s\n", load_ms,
+                    rebuild_s * 1e3 / load_ms, ok ? "match" : "MISMATCH");
+        if (!ok) return 1;
+    }
+    std::filesystem::remove(path);
+    return 0;
+}
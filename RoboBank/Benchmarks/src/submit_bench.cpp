@@ -0,0 +1,230 @@
+// Async submit (submitter.h): P producer threads feed the same workload to a TxSubmitter and,
+// for comparison, to apply_checked one transaction at a time under a mutex. Prints the latency
+// of the submit call itself and of submit -> completion callback, checks the balances against
+// a serial apply, and checks back-pressure (try_submit on a full queue) and futures.
+// usage: SubmitBench [tx] [producers] [accounts]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "portfolio.h"
+#include "submitter.h"
+#include "bench_util.h"
+#include "workload.h"
+
+static long long now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct Latency
+{
+    long long p50, p99, p999;
+};
+
+static Latency quantiles(std::vector<long long> &ns)
+{
+    std::sort(ns.begin(), ns.end());
+    size_t n = ns.size();
+    if (!n) return {0, 0, 0};
+    return {ns[n / 2], ns[std::min(n - 1, n * 99 / 100)], ns[std::min(n - 1, n * 999 / 1000)]};
+}
+
+// every account exists and any overdraft is allowed, so nothing is refused and the final
+// balances do not depend on the order the producers interleave in
+static void setup(Portfolio &p, std::uint32_t accounts)
+{
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0, 16};
+    for (std::uint32_t i = 0; i < accounts; ++i)
+        p.add_account(bench::workload_account_id(i), s, 10000);
+    p4::TxPolicy policy;
+    policy.overdraft_limit_cents[0] = policy.overdraft_limit_cents[1] = 1LL << 60;
+    p.set_policy(policy);
+}
+
+static p4::TxRecord tx_of(const bench::WorkloadOp &op, const std::vector<std::string> &ids)
+{
+    return p4::TxRecord{static_cast<p4::TxKind>(op.kind), op.amount_cents, op.timestamp, "", ids[op.account]};
+}
+
+static p4::TransferRecord transfer_of(const bench::WorkloadOp &op, const std::vector<std::string> &ids)
+{
+    return p4::TransferRecord{ids[op.account], ids[op.to], op.amount_cents, op.timestamp, ""};
+}
+
+static bool same_balances(const Portfolio &a, const Portfolio &b, const std::vector<std::string> &ids)
+{
+    if (a.total_exposure() != b.total_exposure()) return false;
+    for (const std::string &id : ids)
+        if (a.balance_of(id) != b.balance_of(id)) return false;
+    return true;
+}
+
+// producer t takes ops t, t + P, t + 2P, ...
+template <class Fn>
+static double run_producers(unsigned producers, size_t n, Fn fn)
+{
+    std::vector<std::thread> threads;
+    bench::Stopwatch sw;
+    for (unsigned t = 0; t < producers; ++t)
+        threads.emplace_back([&, t] {
+            for (size_t i = t; i < n; i += producers)
+                fn(i);
+        });
+    for (std::thread &th : threads)
+        th.join();
+    return sw.seconds();
+}
+
+int main(int argc, char **argv)
+{
+    const size_t total_tx = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const unsigned producers = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 4;
+    bench::WorkloadOptions w;
+    w.accounts = argc > 3 ? static_cast<std::uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 100000;
+    std::vector<bench::WorkloadOp> ops = bench::make_workload(w, total_tx);
+    std::vector<std::string> ids(w.accounts);
+    for (std::uint32_t i = 0; i < w.accounts; ++i)
+        ids[i] = bench::workload_account_id(i);
+    std::printf("%zu ops, %u producers, %u accounts, %u hardware threads\n", total_tx, producers, w.accounts,
+                std::thread::hardware_concurrency());
+
+    Portfolio serial;
+    setup(serial, w.accounts);
+    for (const bench::WorkloadOp &op : ops)
+        if (op.transfer())
+            serial.transfer(transfer_of(op, ids));
+        else
+            serial.apply_checked({tx_of(op, ids)});
+
+    // baseline: each producer applies its own transaction under one lock
+    {
+        Portfolio p;
+        setup(p, w.accounts);
+        std::mutex mu;
+        std::vector<long long> call(total_tx);
+        double secs = run_producers(producers, total_tx, [&](size_t i) {
+            const bench::WorkloadOp &op = ops[i];
+            long long t0 = now_ns();
+            {
+                std::lock_guard<std::mutex> lock(mu);
+                if (op.transfer())
+                    p.transfer(transfer_of(op, ids));
+                else
+                    p.apply_checked({tx_of(op, ids)});
+            }
+            call[i] = now_ns() - t0;
+        });
+        Latency c = quantiles(call);
+        std::printf("mutex+apply_checked  %8.0f tx/s  call p50=%lldns p99=%lldns p99.9=%lldns  %s\n", total_tx / secs,
+                    c.p50, c.p99, c.p999, same_balances(p, serial, ids) ? "match" : "MISMATCH");
+    }
+
+    // TxSubmitter with callbacks: e2e[i] holds the submit time until the callback replaces it
+    // with the time to completion
+    {
+        Portfolio p;
+        setup(p, w.accounts);
+        std::vector<long long> call(total_tx), e2e(total_tx);
+        std::atomic<size_t> rejected{0};
+        p4::TxSubmitter sub(p);
+        bench::Stopwatch sw;
+        run_producers(producers, total_tx, [&](size_t i) {
+            const bench::WorkloadOp &op = ops[i];
+            long long *slot = &e2e[i];
+            p4::SubmitCallback done = [slot, &rejected](p4::RejectReason r) {
+                *slot = now_ns() - *slot;
+                if (r != p4::RejectReason::None) rejected.fetch_add(1, std::memory_order_relaxed);
+            };
+            long long t0 = now_ns();
+            *slot = t0;
+            if (op.transfer())
+                sub.submit(transfer_of(op, ids), std::move(done));
+            else
+                sub.submit(tx_of(op, ids), std::move(done));
+            call[i] = now_ns() - t0;
+        });
+        sub.stop();
+        double secs = sw.seconds();
+        p4::SubmitStats st = sub.stats();
+        Latency c = quantiles(call), e = quantiles(e2e);
+        bool ok = st.completed == total_tx && rejected.load() == 0 && same_balances(p, serial, ids);
+        std::printf("TxSubmitter          %8.0f tx/s  call p50=%lldns p99=%lldns p99.9=%lldns  %s\n", total_tx / secs,
+                    c.p50, c.p99, c.p999, ok ? "match" : "MISMATCH");
+        std::printf("  submit->done p50=%lldns p99=%lldns p99.9=%lldns  batches=%llu (%.0f tx each) full_waits=%llu\n",
+                    e.p50, e.p99, e.p999, (unsigned long long)st.batches,
+                    st.batches ? double(total_tx) / st.batches : 0.0, (unsigned long long)st.full_waits);
+    }
+
+    // unloaded: one producer waits on each future before the next submit
+    {
+        Portfolio p;
+        setup(p, w.accounts);
+        p4::TxSubmitter sub(p);
+        size_t n = std::min<size_t>(total_tx, 20000);
+        std::vector<long long> rt;
+        rt.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (ops[i].transfer()) continue;
+            long long t0 = now_ns();
+            sub.submit(tx_of(ops[i], ids)).get();
+            rt.push_back(now_ns() - t0);
+        }
+        Latency r = quantiles(rt);
+        std::printf("one at a time: submit->get p50=%lldns p99=%lldns p99.9=%lldns\n", r.p50, r.p99, r.p999);
+    }
+
+    // back-pressure: a callback holds the apply thread until the 8-slot queue is full
+    {
+        Portfolio p;
+        setup(p, w.accounts);
+        p4::SubmitOptions o;
+        o.queue_capacity = 8;
+        std::atomic<bool> held{false}, release{false};
+        size_t queued = 0;
+        {
+            p4::TxSubmitter sub(p, o);
+            sub.submit(tx_of(ops[0], ids), [&](p4::RejectReason) {
+                held.store(true);
+                while (!release.load())
+                    std::this_thread::yield();
+            });
+            while (!held.load())
+                std::this_thread::yield();
+            for (size_t i = 1; i < ops.size() && queued < 100; ++i)
+            {
+                if (ops[i].transfer()) continue;
+                if (!sub.try_submit(tx_of(ops[i], ids), nullptr)) break;
+                ++queued;
+            }
+            release.store(true);
+        }
+        std::printf("try_submit on a full %zu-slot queue: refused after %zu  %s\n", o.queue_capacity, queued,
+                    queued == o.queue_capacity ? "match" : "MISMATCH");
+    }
+
+    // futures: an overdraft refused by the default policy comes back as its reason
+    {
+        Portfolio p;
+        p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0, 16};
+        p.add_account("A", s, 1000);
+        p.add_account("B", s, 0);
+        p4::TxSubmitter sub(p);
+        std::future<p4::RejectReason> ok = sub.submit(p4::TransferRecord{"A", "B", 600, 1, ""});
+        std::future<p4::RejectReason> over = sub.submit(p4::TransferRecord{"A", "B", 600, 2, ""});
+        std::future<p4::RejectReason> dep = sub.submit(p4::TxRecord{p4::TxKind::Deposit, 50, 3, "", "B"});
+        bool match = ok.get() == p4::RejectReason::None && over.get() == p4::RejectReason::Overdraft &&
+                     dep.get() == p4::RejectReason::None;
+        sub.stop();
+        std::printf("futures: A=%lld B=%lld  %s\n", p.balance_of("A"), p.balance_of("B"),
+                    match && p.balance_of("A") == 400 && p.balance_of("B") == 650 ? "match" : "MISMATCH");
+    }
+    return 0;
+}
@@ -0,0 +1,457 @@
+// Regression suite over all four modules, driven by one seeded synthetic workload (see
+// workload.h): Calculator, the P2 fixed-array API and LedgerEngine, P3 Account, and P4
+// Portfolio. Each case runs its operations in calls (one call = ops_per_call operations) and
+// reports throughput, p50/p99 call latency, heap allocations per operation and a checksum of
+// the result, one JSON object per line (or CSV with --csv). The first line holds the options;
+// with the same options the checksums are the same on every machine.
+//
+// With --compare FILE (a previous run's output) a case whose ops_per_s fell by more than
+// --tolerance, or whose checksum changed under the same options, is reported on stderr and the
+// exit code is 2.
+//
+// usage: RoboBankBench [--ops N] [--accounts N] [--zipf S] [--mix D,W,F,I] [--transfers R]
+//                      [--seed N] [--batch N] [--filter PREFIX] [--csv]
+//                      [--compare FILE] [--tolerance T]
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "calculator.h"
+#include "RoboBankLedger.h"
+#include "LedgerEngine.h"
+#include "Account.h"
+#include "portfolio.h"
+#include "alloc_counter.h"
+#include "bench_util.h"
+#include "workload.h"
+
+namespace
+{
+    struct Result
+    {
+        std::string name;
+        size_t ops = 0;
+        size_t ops_per_call = 0;
+        double seconds = 0;
+        double p50_ns = 0, p99_ns = 0; // per call
+        double allocs_per_op = 0;
+        long long check = 0;
+
+        double ops_per_s() const { return seconds > 0 ? ops / seconds : 0; }
+    };
+
+    struct Config
+    {
+        bench::WorkloadOptions w;
+        size_t ops = 1000000;
+        size_t batch = 1000; // rows per call of the batch APIs
+        std::string filter;
+        bool csv = false;
+        std::string compare;
+        double tolerance = 0.10;
+    };
+
+    // Times `calls` calls of fn(call), each covering about ops_per_call operations; `ops` is the
+    // total. Only the calls are timed and counted.
+    template <class Fn>
+    Result time_calls(const char *name, size_t calls, size_t ops_per_call, size_t ops, Fn &&fn)
+    {
+        Result r;
+        r.name = name;
+        r.ops = ops;
+        r.ops_per_call = ops_per_call;
+        std::vector<double> ns(calls);
+        long long allocs = bench::alloc_count().load();
+        bench::Stopwatch total;
+        for (size_t c = 0; c < calls; ++c)
+        {
+            bench::Stopwatch sw;
+            fn(c);
+            ns[c] = sw.seconds() * 1e9;
+        }
+        r.seconds = total.seconds();
+        r.allocs_per_op = ops ? double(bench::alloc_count().load() - allocs) / ops : 0;
+        if (calls)
+        {
+            std::sort(ns.begin(), ns.end());
+            r.p50_ns = ns[calls / 2];
+            r.p99_ns = ns[std::min(calls - 1, calls * 99 / 100)];
+        }
+        return r;
+    }
+
+    // the workload as single postings: a transfer becomes its out and in legs
+    struct Row
+    {
+        std::uint32_t account;
+        int kind;
+        long long amount_cents;
+        long long timestamp;
+    };
+
+    std::vector<Row> rows_of(const std::vector<bench::WorkloadOp> &ops)
+    {
+        std::vector<Row> rows;
+        rows.reserve(ops.size() * 2);
+        for (const auto &op : ops)
+        {
+            if (op.transfer())
+            {
+                rows.push_back(Row{op.account, TxKind::TransferOut, op.amount_cents, op.timestamp});
+                rows.push_back(Row{op.to, TxKind::TransferIn, op.amount_cents, op.timestamp});
+            }
+            else
+                rows.push_back(Row{op.account, op.kind, op.amount_cents, op.timestamp});
+        }
+        return rows;
+    }
+
+    AccountType type_of(std::uint32_t i) { return i % 4 == 3 ? AccountType::Savings : AccountType::Checking; }
+
+    const size_t kCalcGroup = 1024; // Calculator calls are a few ns: time them in groups
+    const size_t kAccountGroup = 16;
+
+    void calculator_cases(const Config &cfg, const std::vector<bench::WorkloadOp> &ops, std::vector<Result> &out)
+    {
+        const size_t n = ops.size(), calls = (n + kCalcGroup - 1) / kCalcGroup;
+        std::vector<long long> balance(cfg.w.accounts, 100000);
+        Result r = time_calls("calc.post", calls, kCalcGroup, n, [&](size_t c) {
+            for (size_t i = c * kCalcGroup; i < std::min(n, (c + 1) * kCalcGroup); ++i)
+            {
+                const bench::WorkloadOp &op = ops[i];
+                long long &b = balance[op.account];
+                switch (op.kind)
+                {
+                case TxKind::Deposit:
+                case TxKind::Interest:
+                    b = Calculator::deposit(b, op.amount_cents);
+                    break;
+                case TxKind::Withdrawal:
+                    b = Calculator::withdrawal(b, op.amount_cents);
+                    break;
+                case TxKind::Fee:
+                    b = Calculator::fee(b, op.amount_cents);
+                    break;
+                default:
+                    b = Calculator::withdrawal(b, op.amount_cents);
+                    balance[op.to] = Calculator::deposit(balance[op.to], op.amount_cents);
+                }
+            }
+        });
+        for (long long b : balance)
+            r.check += b;
+        out.push_back(r);
+
+        long long sum = 0;
+        r = time_calls("calc.interest", calls, kCalcGroup, n, [&](size_t c) {
+            for (size_t i = c * kCalcGroup; i < std::min(n, (c + 1) * kCalcGroup); ++i)
+                sum += Calculator::interest(balance[ops[i].account], 0.02, 30, 365);
+        });
+        r.check = sum;
+        out.push_back(r);
+    }
+
+    void ledger_cases(const Config &cfg, const std::vector<Row> &rows, std::vector<Result> &out)
+    {
+        const size_t n = rows.size();
+        std::vector<std::string> ids(cfg.w.accounts);
+        for (std::uint32_t i = 0; i < cfg.w.accounts; ++i)
+            ids[i] = bench::workload_account_id(i);
+
+        // fixed-array API: its caps make every call a fresh ledger of MAX_TX rows over at most
+        // MAX_ACCOUNTS accounts (account numbers are folded into that range)
+        {
+            const size_t calls = (n + MAX_TX - 1) / MAX_TX;
+            std::vector<char> tx_id(n * MAX_LEN, 0);
+            std::vector<int> tx_type(n), tx_amount(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                std::strncpy(&tx_id[i * MAX_LEN], ids[rows[i].account % MAX_ACCOUNTS].c_str(), MAX_LEN - 1);
+                tx_type[i] = rows[i].kind;
+                tx_amount[i] = static_cast<int>(rows[i].amount_cents);
+            }
+            auto id_rows = reinterpret_cast<const char(*)[MAX_LEN]>(tx_id.data());
+            char ac_id[MAX_ACCOUNTS][MAX_LEN];
+            int ac_balance[MAX_ACCOUNTS];
+            int ac_count = 0;
+            long long check = 0;
+            Result r = time_calls("p2.apply_all", calls, MAX_TX, n, [&](size_t c) {
+                size_t b = c * MAX_TX, m = std::min<size_t>(MAX_TX, n - b);
+                ac_count = 0;
+                apply_all(id_rows + b, &tx_type[b], &tx_amount[b], static_cast<int>(m), ac_id, ac_balance, MAX_ACCOUNTS, ac_count);
+                for (int k = 0; k < ac_count; ++k)
+                    check += ac_balance[k];
+            });
+            r.check = check;
+            out.push_back(r);
+
+            check = 0;
+            r = time_calls("p2.bank_summary", calls, MAX_TX, n, [&](size_t c) {
+                size_t b = c * MAX_TX, m = std::min<size_t>(MAX_TX, n - b);
+                int dep, wd, fee, in, net;
+                bank_summary(&tx_type[b], &tx_amount[b], static_cast<int>(m), ac_balance, ac_count, &dep, &wd, &fee, &in, &net);
+                check += dep - wd - fee + in;
+            });
+            r.check = check;
+            out.push_back(r);
+        }
+
+        // LedgerEngine: the uncapped ledger, in calls of `batch` rows
+        {
+            const size_t batch = cfg.batch, calls = (n + batch - 1) / batch;
+            std::vector<char> tx_id(n * MAX_LEN, 0);
+            std::vector<int> tx_type(n);
+            std::vector<long long> tx_amount(n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                std::strncpy(&tx_id[i * MAX_LEN], ids[rows[i].account].c_str(), MAX_LEN - 1);
+                tx_type[i] = rows[i].kind;
+                tx_amount[i] = rows[i].amount_cents;
+            }
+            auto id_rows = reinterpret_cast<const char(*)[MAX_LEN]>(tx_id.data());
+            LedgerEngine engine;
+            engine.reserve(cfg.w.accounts);
+            Result r = time_calls("p2.engine_apply_all", calls, batch, n, [&](size_t c) {
+                size_t b = c * batch;
+                engine.apply_all(id_rows + b, &tx_type[b], &tx_amount[b], std::min(batch, n - b));
+            });
+            for (size_t k = 0; k < engine.count(); ++k)
+                r.check += engine.balance_at(k);
+            out.push_back(r);
+
+            long long check = 0;
+            r = time_calls("p2.engine_bank_summary", calls, batch, n, [&](size_t c) {
+                size_t b = c * batch;
+                LedgerSummary s = engine.bank_summary(&tx_type[b], &tx_amount[b], std::min(batch, n - b));
+                check += s.total_deposits - s.total_withdrawals - s.total_fees + s.total_interest;
+            });
+            r.check = check;
+            out.push_back(r);
+        }
+    }
+
+    void account_cases(const Config &cfg, const std::vector<Row> &rows, std::vector<Result> &out)
+    {
+        // Account keeps the id pointer, so the strings outlive the accounts
+        std::vector<std::string> ids(cfg.w.accounts);
+        std::vector<Account> accounts;
+        accounts.reserve(cfg.w.accounts);
+        for (std::uint32_t i = 0; i < cfg.w.accounts; ++i)
+        {
+            ids[i] = bench::workload_account_id(i);
+            AccountSettings s{type_of(i), type_of(i) == AccountType::Savings ? 0.02 : 0.0, 500};
+            accounts.emplace_back(ids[i].c_str(), s, 100000);
+        }
+        std::vector<TxRecord> txs(rows.size());
+        for (size_t i = 0; i < rows.size(); ++i)
+            txs[i] = TxRecord{static_cast<TxKind>(rows[i].kind), rows[i].amount_cents, rows[i].timestamp, "suite"};
+        const size_t n = txs.size(), calls = (n + kAccountGroup - 1) / kAccountGroup;
+        Result r = time_calls("p3.account_apply", calls, kAccountGroup, n, [&](size_t c) {
+            for (size_t i = c * kAccountGroup; i < std::min(n, (c + 1) * kAccountGroup); ++i)
+                accounts[rows[i].account].apply(txs[i]);
+        });
+        for (const Account &a : accounts)
+            r.check += a.balance_cents();
+        out.push_back(r);
+    }
+
+    void add_accounts(Portfolio &p, std::uint32_t accounts)
+    {
+        p.reserve(accounts);
+        for (std::uint32_t i = 0; i < accounts; ++i)
+        {
+            p4::AccountSettings s{static_cast<int>(type_of(i)), type_of(i) == AccountType::Savings ? 0.02 : 0.0, 500};
+            p.add_account(bench::workload_account_id(i), s, 1000000);
+        }
+    }
+
+    void portfolio_cases(const Config &cfg, const std::vector<bench::WorkloadOp> &ops, const std::vector<Row> &rows,
+                         std::vector<Result> &out)
+    {
+        const size_t n = rows.size(), batch = cfg.batch, calls = (n + batch - 1) / batch;
+        Portfolio p;
+        add_accounts(p, cfg.w.accounts);
+        std::vector<std::vector<p4::TxRecord>> batches(calls);
+        for (size_t c = 0; c < calls; ++c)
+        {
+            for (size_t i = c * batch; i < std::min(n, (c + 1) * batch); ++i)
+                batches[c].push_back(p4::TxRecord{static_cast<p4::TxKind>(rows[i].kind), rows[i].amount_cents,
+                                                  rows[i].timestamp, "suite", bench::workload_account_id(rows[i].account)});
+        }
+        Result r = time_calls("p4.apply_all", calls, batch, n, [&](size_t c) { p.apply_all(batches[c]); });
+        r.check = p.total_exposure();
+        out.push_back(r);
+        batches.clear();
+
+        // totals_by_type on the book apply_all left
+        const size_t reads = std::min<size_t>(ops.size(), 100000);
+        long long check = 0;
+        r = time_calls("p4.totals_by_type", reads, 1, reads, [&](size_t) {
+            for (const auto &t : p.totals_by_type())
+                check += t.second;
+        });
+        r.check = check;
+        out.push_back(r);
+
+        // transfer() on the transfers of the workload, into a fresh book
+        Portfolio q;
+        add_accounts(q, cfg.w.accounts);
+        std::vector<p4::TransferRecord> trs;
+        for (const auto &op : ops)
+            if (op.transfer())
+                trs.push_back(p4::TransferRecord{bench::workload_account_id(op.account), bench::workload_account_id(op.to),
+                                                 op.amount_cents, op.timestamp, "suite"});
+        size_t refused = 0;
+        r = time_calls("p4.transfer", trs.size(), 1, trs.size(), [&](size_t c) { refused += !q.transfer(trs[c]); });
+        r.check = q.total_exposure() + static_cast<long long>(refused);
+        out.push_back(r);
+    }
+
+    std::string options_line(const Config &cfg)
+    {
+        const bench::WorkloadOptions &w = cfg.w;
+        char buf[512];
+        std::snprintf(buf, sizeof(buf),
+                      "{\"suite\":\"robobank\",\"ops\":%zu,\"accounts\":%u,\"zipf\":%g,\"mix\":[%g,%g,%g,%g],"
+                      "\"transfers\":%g,\"seed\":%llu,\"batch\":%zu}",
+                      cfg.ops, w.accounts, w.zipf_s, w.kind_mix[0], w.kind_mix[1], w.kind_mix[2], w.kind_mix[3],
+                      w.transfer_ratio, static_cast<unsigned long long>(w.seed), cfg.batch);
+        return buf;
+    }
+
+    void print(const Result &r, bool csv)
+    {
+        if (csv)
+            std::printf("%s,%zu,%zu,%.6f,%.0f,%.1f,%.1f,%.4f,%lld\n", r.name.c_str(), r.ops, r.ops_per_call, r.seconds,
+                        r.ops_per_s(), r.p50_ns, r.p99_ns, r.allocs_per_op, r.check);
+        else
+            std::printf("{\"name\":\"%s\",\"ops\":%zu,\"ops_per_call\":%zu,\"seconds\":%.6f,\"ops_per_s\":%.0f,"
+                        "\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"allocs_per_op\":%.4f,\"check\":%lld}\n",
+                        r.name.c_str(), r.ops, r.ops_per_call, r.seconds, r.ops_per_s(), r.p50_ns, r.p99_ns,
+                        r.allocs_per_op, r.check);
+    }
+
+    // the numeric field `key` of one output line, or false when it has none
+    bool field(const std::string &line, const char *key, double &value)
+    {
+        std::string k = std::string("\"") + key + "\":";
+        size_t at = line.find(k);
+        if (at == std::string::npos) return false;
+        value = std::strtod(line.c_str() + at + k.size(), nullptr);
+        return true;
+    }
+
+    // returns the number of regressions against a previous JSON run
+    int compare(const Config &cfg, const std::vector<Result> &results)
+    {
+        std::ifstream in(cfg.compare);
+        if (!in)
+        {
+            std::fprintf(stderr, "cannot read %s\n", cfg.compare.c_str());
+            return 1;
+        }
+        std::string line, options;
+        std::map<std::string, std::string> base;
+        while (std::getline(in, line))
+        {
+            if (line.find("\"suite\":") != std::string::npos)
+                options = line;
+            size_t at = line.find("\"name\":\"");
+            if (at == std::string::npos) continue;
+            at += 8;
+            base[line.substr(at, line.find('"', at) - at)] = line;
+        }
+        const bool same_options = options == options_line(cfg);
+        int bad = 0;
+        for (const Result &r : results)
+        {
+            auto it = base.find(r.name);
+            if (it == base.end()) continue;
+            double before, check;
+            if (field(it->second, "ops_per_s", before) && r.ops_per_s() < before * (1 - cfg.tolerance))
+            {
+                std::fprintf(stderr, "regression: %s %.0f ops/s, was %.0f (%.1f%%)\n", r.name.c_str(), r.ops_per_s(),
+                             before, 100 * (r.ops_per_s() / before - 1));
+                ++bad;
+            }
+            if (same_options && field(it->second, "check", check) && static_cast<long long>(check) != r.check)
+            {
+                std::fprintf(stderr, "checksum changed: %s %lld, was %.0f\n", r.name.c_str(), r.check, check);
+                ++bad;
+            }
+        }
+        return bad;
+    }
+
+    bool parse(int argc, char **argv, Config &cfg)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string a = argv[i];
+            const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (a == "--csv")
+            {
+                cfg.csv = true;
+                continue;
+            }
+            if (!v) return false;
+            ++i;
+            if (a == "--ops") cfg.ops = std::strtoull(v, nullptr, 10);
+            else if (a == "--accounts") cfg.w.accounts = static_cast<std::uint32_t>(std::strtoul(v, nullptr, 10));
+            else if (a == "--zipf") cfg.w.zipf_s = std::strtod(v, nullptr);
+            else if (a == "--transfers") cfg.w.transfer_ratio = std::strtod(v, nullptr);
+            else if (a == "--seed") cfg.w.seed = std::strtoull(v, nullptr, 10);
+            else if (a == "--batch") cfg.batch = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+            else if (a == "--filter") cfg.filter = v;
+            else if (a == "--compare") cfg.compare = v;
+            else if (a == "--tolerance") cfg.tolerance = std::strtod(v, nullptr);
+            else if (a == "--mix")
+            {
+                if (std::sscanf(v, "%lf,%lf,%lf,%lf", &cfg.w.kind_mix[0], &cfg.w.kind_mix[1], &cfg.w.kind_mix[2],
+                                &cfg.w.kind_mix[3]) != 4)
+                    return false;
+            }
+            else
+                return false;
+        }
+        return cfg.w.accounts > 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Config cfg;
+    if (!parse(argc, argv, cfg))
+    {
+        std::fprintf(stderr, "usage: %s [--ops N] [--accounts N] [--zipf S] [--mix D,W,F,I] [--transfers R] [--seed N] "
+                             "[--batch N] [--filter PREFIX] [--csv] [--compare FILE] [--tolerance T]\n",
+                     argv[0]);
+        return 1;
+    }
+    const std::vector<bench::WorkloadOp> ops = bench::make_workload(cfg.w, cfg.ops);
+    const std::vector<Row> rows = rows_of(ops);
+
+    std::vector<Result> results;
+    // a module runs when the filter is a prefix of its name or names one of its cases
+    auto want = [&](const std::string &module) {
+        size_t k = std::min(module.size(), cfg.filter.size());
+        return module.compare(0, k, cfg.filter, 0, k) == 0;
+    };
+    if (want("calc")) calculator_cases(cfg, ops, results);
+    if (want("p2")) ledger_cases(cfg, rows, results);
+    if (want("p3")) account_cases(cfg, rows, results);
+    if (want("p4")) portfolio_cases(cfg, ops, rows, results);
+
+    if (cfg.csv)
+        std::printf("name,ops,ops_per_call,seconds,ops_per_s,p50_ns,p99_ns,allocs_per_op,check\n");
+    else
+        std::printf("%s\n", options_line(cfg).c_str());
+    for (const Result &r : results)
+        if (cfg.filter.empty() || r.name.compare(0, cfg.filter.size(), cfg.filter) == 0) print(r, cfg.csv);
+    std::fflush(stdout);
+    return cfg.compare.empty() || compare(cfg, results) == 0 ? 0 : 2;
+}
@@ -0,0 +1,85 @@
+// Reporting reads: total_exposure / totals_by_type polled from the running totals, against the
+// full rescan that check mode does. First drives every posting path (serial, parallel, batches,
+// transfers, month end, the IAccount facade) and verifies the running totals against a rescan.
+// usage: TotalsBench [accounts] [polls]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "concurrent_portfolio.h"
+#include "bench_util.h"
+
+int main(int argc, char **argv)
+{
+    const size_t accounts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const int polls = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::vector<std::string> ids;
+    ids.reserve(accounts);
+    for (size_t i = 0; i < accounts; i++)
+        ids.push_back("AC-" + std::to_string(10000000 + i));
+    Portfolio p;
+    p.reserve(accounts);
+    for (size_t i = 0; i < accounts; i++)
+    {
+        p4::AccountSettings s{static_cast<int>(i % 3 == 2 ? AccountType::Savings : AccountType::Checking), 0.04, 500};
+        p.add_account(ids[i], s, 100000);
+    }
+
+    bench::Rng rng(5);
+    std::vector<p4::TxRecord> txs(1000000);
+    for (auto &t : txs)
+        t = p4::TxRecord{static_cast<p4::TxKind>(rng.below(4)), static_cast<long long>(rng.below(5000)), 1, "", ids[rng.below(accounts)]};
+    p.apply_all(txs);
+    p.apply_all_parallel(txs, 4);
+    std::vector<p4::TxRejection> rej = p.apply_checked(txs);
+    p4::TransferBatch tb;
+    for (int i = 0; i < 100000; i++)
+    {
+        p4::TransferRecord tr{ids[rng.below(accounts)], ids[rng.below(accounts)], static_cast<long long>(rng.below(5000)), 2, "tb"};
+        p.transfer(tr);
+        tb.add(tr);
+    }
+    p.transfer_batch(tb);
+    p4::Batch payroll;
+    payroll.post(ids[0], p4::TxKind::TransferOut, 100 * 999, 3);
+    for (int e = 1; e < 1000; e++)
+        payroll.post(ids[e], p4::TxKind::TransferIn, 100, 3);
+    p.commit(payroll);
+    p4::MonthEndOptions me;
+    me.threads = 4;
+    p.close_month(me);
+    p.get_account(ids[7])->deposit(12345, 4, "facade");
+    p.get_account(ids[8])->post_simple_interest(30, 365, 4, "facade");
+    bool ok = p.verify_totals();
+    std::printf("running totals after every path: %s\n", ok ? "match" : "MISMATCH");
+
+    ConcurrentPortfolio cp(1000);
+    for (int i = 0; i < 1000; i++)
+        cp.add_account(ids[i], p4::AccountSettings{i % 2, 0.0, 0}, 1000);
+    for (int i = 0; i < 100000; i++)
+        cp.transfer(1 + rng.below(1000), 1 + rng.below(1000), static_cast<long long>(rng.below(100)), i);
+    long long by_type[2] = {0, 0};
+    for (p4::AccountHandle h = 1; h <= 1000; h++)
+        cp.with_account(h, [&](const IAccount &a) { by_type[a.type() == AccountType::Savings] += a.balance_cents(); });
+    bool cok = by_type[0] == cp.total_of(AccountType::Checking) && by_type[1] == cp.total_of(AccountType::Savings);
+    std::printf("concurrent running totals: %s\n", cok ? "match" : "MISMATCH");
+
+    long long sink = 0;
+    bench::Stopwatch sw;
+    for (int i = 0; i < polls; i++)
+        sink += p.total_exposure() + p.totals_by_type()[AccountType::Savings];
+    double t_running = sw.seconds();
+    p.set_check_totals(true);
+    sw.reset();
+    for (int i = 0; i < polls; i++)
+        sink -= p.total_exposure() + p.totals_by_type()[AccountType::Savings];
+    double t_scan = sw.seconds();
+    bench::keep(sink);
+    std::printf("poll (total_exposure + totals_by_type) over %zu accounts: running %.2f us, rescan %.0f us (%.0fx), "
+                "mismatches=%zu %s\n",
+                accounts, t_running / polls * 1e6, t_scan / polls * 1e6, t_scan / t_running, p.totals_mismatches(),
+                sink == 0 ? "match" : "MISMATCH");
+    return ok && cok && sink == 0 && p.totals_mismatches() == 0 ? 0 : 1;
+}
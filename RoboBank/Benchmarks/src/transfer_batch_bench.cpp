@@ -0,0 +1,84 @@
+// Settlement-run transfers: Portfolio::transfer per TransferRecord against transfer_batch on
+// the same transfers (Zipf-skewed accounts, some refused for overdraft), checking every balance,
+// the audit and the refusals match. Then the netted batch on funded accounts.
+// usage: TransferBatchBench [transfers] [accounts] [zipf s]
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "portfolio.h"
+#include "bench_util.h"
+
+static void build(Portfolio &p, const std::vector<std::string> &ids, long long opening)
+{
+    p.reserve(ids.size());
+    p4::AccountSettings s{static_cast<int>(AccountType::Checking), 0.0, 0};
+    for (const auto &id : ids)
+        p.add_account(id, s, opening);
+}
+
+static bool same_books(const Portfolio &a, const Portfolio &b, const std::vector<std::string> &ids)
+{
+    for (const auto &id : ids)
+        if (a.balance_of(id) != b.balance_of(id)) return false;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+    const int accounts = argc > 2 ? std::atoi(argv[2]) : 1000;
+    const double s = argc > 3 ? std::atof(argv[3]) : 1.1;
+
+    std::vector<std::string> ids;
+    for (int i = 0; i < accounts; i++)
+        ids.push_back("SETTLE-" + std::to_string(100000 + i));
+    const char *notes[] = {"settlement", "fx", "sweep", "fee share"};
+    bench::Rng rng(17);
+    bench::Zipf zipf(accounts, s);
+    std::vector<p4::TransferRecord> trs(n);
+    for (size_t i = 0; i < n; i++)
+        trs[i] = p4::TransferRecord{ids[zipf.sample(rng)], ids[zipf.sample(rng)],
+                                    static_cast<long long>(1 + rng.below(20000)), static_cast<long long>(i), notes[i % 4]};
+
+    // low opening balances: some transfers are refused, and the two paths must agree on which
+    Portfolio a, b;
+    build(a, ids, 50000);
+    build(b, ids, 50000);
+    bench::Stopwatch sw;
+    size_t refused = 0;
+    for (const auto &tr : trs)
+        refused += !a.transfer(tr);
+    double t_call = sw.seconds();
+
+    sw.reset();
+    p4::TransferBatch batch;
+    batch.reserve(n);
+    for (const auto &tr : trs)
+        batch.add(tr);
+    double t_build = sw.seconds();
+    sw.reset();
+    p4::TransferBatchReport rep = b.transfer_batch(batch);
+    double t_batch = sw.seconds();
+    bool ok = rep.rejected.size() == refused && rep.applied == n - refused && a.audit().size() == b.audit().size() &&
+              same_books(a, b, ids);
+    std::printf("transfer       %.0f transfers/s\n", n / t_call);
+    std::printf("transfer_batch %.0f transfers/s (%.0f with building the batch) %.1fx, refused=%zu %s\n", n / t_batch,
+                n / (t_batch + t_build), t_call / t_batch, refused, ok ? "match" : "MISMATCH");
+
+    // funded accounts: nothing is refused, so netting must land on the same balances
+    Portfolio c, d;
+    build(c, ids, 1LL << 40);
+    build(d, ids, 1LL << 40);
+    for (const auto &tr : trs)
+        c.transfer(tr);
+    p4::TransferBatchOptions net;
+    net.net_pairs = true;
+    sw.reset();
+    rep = d.transfer_batch(batch, net);
+    double t_net = sw.seconds();
+    ok = rep.rejected.empty() && rep.applied == n && same_books(c, d, ids);
+    std::printf("net_pairs      %.0f transfers/s %.1fx, %zu postings for %zu transfers %s\n", n / t_net, t_call / t_net,
+                rep.postings, n, ok ? "match" : "MISMATCH");
+    return ok ? 0 : 1;
+}
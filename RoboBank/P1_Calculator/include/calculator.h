@@ -1,24 +1,142 @@
 #ifndef CALCULATOR_H
 #define CALCULATOR_H
 
+#include <cmath>
+#include <cstddef>
+
 namespace Calculator
 {
-    inline long long deposit(long long balance, long long amount)
+    constexpr long long deposit(long long balance, long long amount)
     {
         return balance + amount;
     }
-    inline long long withdrawal(long long balance, long long amount)
+    constexpr long long withdrawal(long long balance, long long amount)
     {
         return balance - amount;
     }
-    inline long long fee(long long balance, long long fee)
+    constexpr long long fee(long long balance, long long fee)
     {
         return balance - fee;
     }
+
+    // Interest rates are fixed point in millionths of a year: 1 basis point = 100, 5% = 50000.
+    const long long kRateScale = 1000000;
+
+    inline long long rate_from_apr(double apr)
+    {
+        return std::llround(apr * kRateScale);
+    }
+
+    // balance * rate * days / (kRateScale * basis), rounded half away from zero, in integers
+    // only: exact whenever the result fits in 64 bits and |rate * days| <= 2^63 / (kRateScale * basis)
+    // (about 25,000 years at 100% APR).
+    constexpr long long simple_interest(long long balance, long long rate, long long days, long long basis)
+    {
+        // with balance = q * den + r (|r| < den), only r * k needs rounding and it cannot overflow
+        const long long den = kRateScale * basis;
+        const long long k = rate * days;
+        const long long q = balance / den, r = balance % den;
+        const long long t = r * k;
+        return q * k + (t + (t < 0 ? -den / 2 : den / 2)) / den;
+    }
+
+    struct Date
+    {
+        int year;
+        int month; // 1..12
+        int day;   // 1..31
+    };
+
+    // days since 1970-01-01 in the proleptic Gregorian calendar
+    constexpr long long days_from_civil(Date d)
+    {
+        const long long y = d.year - (d.month <= 2);
+        const long long era = (y >= 0 ? y : y - 399) / 400;
+        const long long yoe = y - era * 400;
+        const long long doy = (153 * (d.month + (d.month > 2 ? -3 : 9)) + 2) / 5 + d.day - 1;
+        const long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    // Day-count conventions: the days in [from, to) and the days in a year they are divided by
+    struct Act365
+    {
+        static constexpr long long basis = 365;
+        static constexpr long long days(Date from, Date to) { return days_from_civil(to) - days_from_civil(from); }
+    };
+
+    struct Act360
+    {
+        static constexpr long long basis = 360;
+        static constexpr long long days(Date from, Date to) { return days_from_civil(to) - days_from_civil(from); }
+    };
+
+    // 30/360 bond basis: every month has 30 days
+    struct Thirty360
+    {
+        static constexpr long long basis = 360;
+        static constexpr long long days(Date from, Date to)
+        {
+            const long long d1 = from.day == 31 ? 30 : from.day;
+            const long long d2 = (to.day == 31 && d1 == 30) ? 30 : to.day;
+            return 360LL * (to.year - from.year) + 30LL * (to.month - from.month) + (d2 - d1);
+        }
+    };
+
+    // Interest for `days` under a convention; the basis is a compile-time constant, so the
+    // division becomes a multiply
+    template <class DayCount>
+    constexpr long long interest(long long balance, long long rate, long long days)
+    {
+        return simple_interest(balance, rate, days, DayCount::basis);
+    }
+
+    template <class DayCount>
+    constexpr long long interest(long long balance, long long rate, Date from, Date to)
+    {
+        return simple_interest(balance, rate, DayCount::days(from, to), DayCount::basis);
+    }
+
+    // interest<DayCount>(balance, rate, days) for many balances at one rate. Balances small
+    // enough for balance * rate * days to fit in 64 bits take one division by the constant
+    // basis instead of two; the result is the same either way.
+    template <class DayCount>
+    class Accrual
+    {
+    public:
+        static constexpr long long den = kRateScale * DayCount::basis;
+
+        constexpr Accrual(long long rate = 0, long long days = 0)
+            : rate_(rate), days_(days), k_(rate * days),
+              limit_(k_ ? (0x7FFFFFFFFFFFFFFFLL - den) / (k_ < 0 ? -k_ : k_) : 0x7FFFFFFFFFFFFFFFLL)
+        {
+        }
+        constexpr long long operator()(long long balance) const
+        {
+            if (balance > limit_ || balance < -limit_)
+                return simple_interest(balance, rate_, days_, DayCount::basis);
+            const long long t = balance * k_;
+            return (t + (t < 0 ? -den / 2 : den / 2)) / den;
+        }
+
+    private:
+        long long rate_, days_, k_, limit_;
+    };
+
+    // out[i] = interest<DayCount>(balance[i], rate, days)
+    template <class DayCount>
+    void accrue(const long long balance[], long long rate, long long days, long long out[], std::size_t n)
+    {
+        const Accrual<DayCount> accrual(rate, days);
+        for (std::size_t i = 0; i < n; i++)
+            out[i] = accrual(balance[i]);
+    }
+
+    // Simple interest on balance at apr (a fraction, 0.05 = 5%) for days / basis of a year.
+    // Same as simple_interest with the apr rounded to kRateScale.
     inline long long interest(long long balance, double apr, int days, int basis)
     {
-        // Simple interest: balance * apr * days / basis
-        return balance + static_cast<long long>(balance * apr * days / basis + 0.5);
+        return simple_interest(balance, rate_from_apr(apr), days, basis);
     }
 }
 
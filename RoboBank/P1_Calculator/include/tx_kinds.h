@@ -0,0 +1,73 @@
+#ifndef TX_KINDS_H
+#define TX_KINDS_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "calculator.h"
+
+namespace Calculator
+{
+    // What each transaction kind does to a balance, in one place for the ledger (tx_type ints),
+    // Account (::TxKind) and the portfolio (p4::TxKind), which all number the kinds
+    // 0 Deposit, 1 Withdrawal, 2 Fee, 3 Interest, 4 TransferIn, 5 TransferOut. An Interest
+    // record carries the amount already accrued, so it credits like a deposit; the transfer
+    // legs post like a deposit and a withdrawal. Other values are not postings.
+    const int kTxKinds = 6;
+
+    template <int Kind>
+    struct TxKindTraits
+    {
+        static_assert(Kind >= 0 && Kind < kTxKinds, "unknown transaction kind");
+        static constexpr int kind = Kind;
+        static constexpr bool credit = Kind == 0 || Kind == 3 || Kind == 4;
+        static constexpr long long sign = credit ? 1 : -1;
+
+        static constexpr long long post(long long balance, long long amount)
+        {
+            return credit ? deposit(balance, amount) : (Kind == 2 ? fee(balance, amount) : withdrawal(balance, amount));
+        }
+    };
+
+    // TxKindTraits<k>::sign by runtime kind
+    constexpr long long kKindSign[kTxKinds] = {TxKindTraits<0>::sign, TxKindTraits<1>::sign, TxKindTraits<2>::sign,
+                                               TxKindTraits<3>::sign, TxKindTraits<4>::sign, TxKindTraits<5>::sign};
+
+    constexpr bool known_kind(int kind) { return static_cast<unsigned>(kind) < static_cast<unsigned>(kTxKinds); }
+
+    // The balance change of a posting, 0 for an unknown kind: a table load and a multiply, so a
+    // mixed-kind loop has no branch on the kind to mispredict
+    constexpr long long kind_delta(int kind, long long amount)
+    {
+        return known_kind(kind) ? kKindSign[kind] * amount : 0;
+    }
+
+    namespace detail
+    {
+        template <class Fn, class Seq>
+        struct KindTable;
+
+        template <class Fn, std::size_t... K>
+        struct KindTable<Fn, std::index_sequence<K...>>
+        {
+            template <std::size_t I>
+            static void one(Fn &fn) { fn(TxKindTraits<static_cast<int>(I)>()); }
+
+            static constexpr void (*table[sizeof...(K)])(Fn &) = {&one<K>...};
+        };
+    }
+
+    // Calls fn(TxKindTraits<K>()) for the runtime kind through a table of instantiations made at
+    // compile time, so fn's body is compiled once per kind with the kind a constant (a batch
+    // kernel per kind, say). False, without calling fn, for an unknown kind.
+    template <class Fn>
+    bool with_kind(int kind, Fn &&fn)
+    {
+        using F = std::remove_reference_t<Fn>;
+        if (!known_kind(kind)) return false;
+        detail::KindTable<F, std::make_index_sequence<kTxKinds>>::table[kind](fn);
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef LEDGER_ENGINE_H
+#define LEDGER_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "RoboBankLedger.h"
+
+// Growable ledger: same apply_all/balance_of/bank_summary semantics as the fixed-array API,
+// but without MAX_ACCOUNTS/MAX_TX caps and with 64-bit balances. Accounts are stored as
+// struct-of-arrays columns (id, hash, balance) plus an open-addressing index, all allocated
+// from the memory resource passed at construction.
+
+enum class LedgerStatus
+{
+    Applied = 0,
+    UnknownType = 1, // tx_type outside 0..5, nothing applied and no account created
+    MissingId = 2,   // empty account id
+    Overflow = 3     // result would not fit in 64 bits, balance left unchanged
+};
+
+struct LedgerReject
+{
+    std::size_t tx_index;
+    LedgerStatus status;
+};
+
+struct LedgerReport
+{
+    std::size_t applied = 0;
+    std::size_t created = 0;
+    std::size_t unknown_type = 0;
+    std::size_t missing_id = 0;
+    std::size_t overflowed = 0;
+
+    std::size_t rejected() const { return unknown_type + missing_id + overflowed; }
+};
+
+struct LedgerSummary
+{
+    long long total_deposits = 0;
+    long long total_withdrawals = 0;
+    long long total_fees = 0;
+    long long total_interest = 0;
+    long long net_exposure = 0;
+};
+
+class LedgerEngine
+{
+public:
+    explicit LedgerEngine(std::pmr::memory_resource *mr = std::pmr::get_default_resource());
+    ~LedgerEngine();
+    LedgerEngine(const LedgerEngine &) = delete;
+    LedgerEngine &operator=(const LedgerEngine &) = delete;
+
+    void reserve(std::size_t accounts);
+    std::size_t count() const;
+    long long find(const char account_id[]) const; // -1 if missing
+    const char *id_at(std::size_t i) const; // MAX_LEN bytes: a full-width id has no terminator
+    long long balance_at(std::size_t i) const;
+    const long long *balances() const;
+
+    LedgerStatus apply_one(const char account_id[], int tx_type, long long amount_cents, LedgerReport *report = nullptr);
+    // rejects (optional) receives the index and reason of every transaction that was not applied
+    LedgerReport apply_all(const char tx_account_id[][MAX_LEN], const int tx_type[], const long long tx_amount_cents[],
+                           std::size_t tx_count, std::vector<LedgerReject> *rejects = nullptr);
+    LedgerReport apply_all(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[],
+                           std::size_t tx_count, std::vector<LedgerReject> *rejects = nullptr);
+    long long balance_of(const char account_id[]) const;
+    LedgerSummary bank_summary(const int tx_type[], const long long tx_amount_cents[], std::size_t tx_count) const;
+
+private:
+    std::size_t probe(const char account_id[], std::uint32_t hash) const;
+    long long get_or_create(const char account_id[], LedgerReport *report);
+    void grow_columns(std::size_t new_capacity);
+    void grow_index(std::size_t new_capacity);
+
+    std::pmr::memory_resource *mr_;
+    char *ids_;              // capacity_ * MAX_LEN
+    std::uint32_t *hashes_;  // capacity_
+    long long *balances_;    // capacity_
+    std::uint32_t *index_;   // index_capacity_ slots of account positions
+    std::size_t count_;
+    std::size_t capacity_;
+    std::size_t index_capacity_;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef LEDGER_KERNELS_H
+#define LEDGER_KERNELS_H
+
+#include <cstddef>
+
+// One-pass aggregation kernels over columnar arrays, with 64-bit accumulators. Each call
+// dispatches once per process to an AVX2 body when the CPU has it, otherwise to a branchless
+// scalar loop (which the compiler vectorizes with the baseline SSE2). Results are identical
+// either way, since integer sums do not depend on summation order.
+
+const int TX_KINDS = 6; // tx_type 0..5; other values are counted in KindTotals::unknown
+
+struct KindTotals
+{
+    long long amount[TX_KINDS] = {0, 0, 0, 0, 0, 0}; // sum of amounts per tx_type
+    long long unknown = 0;                            // transactions with tx_type outside 0..5
+};
+
+struct ExposureTotals
+{
+    long long total = 0;
+    long long by_type[2] = {0, 0}; // account type 0 (Checking) and 1 (Savings)
+};
+
+KindTotals sum_by_kind(const int tx_type[], const int tx_amount_cents[], std::size_t tx_count);
+KindTotals sum_by_kind(const int tx_type[], const long long tx_amount_cents[], std::size_t tx_count);
+long long sum_balances(const int balance[], std::size_t count);
+long long sum_balances(const long long balance[], std::size_t count);
+// account_type[i] outside 0..1 adds to total only
+ExposureTotals exposure_by_type(const long long balance[], const int account_type[], std::size_t count);
+
+// "avx2" or "scalar": the body the kernels above dispatch to
+const char *ledger_kernel_isa();
+// Pins the scalar bodies (or restores dispatch) to compare them; not thread-safe
+void ledger_kernels_force_scalar(bool on);
+
+#endif
@@ -1,10 +1,14 @@
 #ifndef ROBO_BANK_LEDGER_H
 #define ROBO_BANK_LEDGER_H
 
+// Limits of the fixed-array API below; LedgerEngine (LedgerEngine.h) grows without caps
 const int MAX_ACCOUNTS = 20;
 const int MAX_TX = 50;
 const int MAX_LEN = 20;
+const int INDEX_EMPTY = -1;
 
+// Ids are compared and stored over at most MAX_LEN bytes, so an id may use all MAX_LEN bytes;
+// its row then has no terminator (read rows with strnlen(row, MAX_LEN)). Longer ids are cut.
 int find_account_index(const char ac_account_id[][MAX_LEN], int ac_count, const char account_id[]);
 int get_or_create_account(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_capacity, int &ac_count, const char account_id[]);
 void apply_one(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_capacity, int &ac_count, const char account_id[], int tx_type, int amount_cents);
@@ -17,4 +21,22 @@ void bank_summary(const int tx_type[], const int tx_amount_cents[], int tx_count
                   int *out_total_fees, int *out_total_interest,
                   int *out_net_exposure);
 
+// Hash-indexed mode: ac_index[] is an open-addressing table (linear probing) of account
+// positions, kept next to the id/balance arrays so the plain functions above work on the same
+// rows. index_capacity must be a power of two larger than ac_capacity (see
+// index_capacity_for). Ids are hashed over at most MAX_LEN bytes, as above.
+int index_capacity_for(int ac_capacity);
+void index_init(int ac_index[], int index_capacity);
+void index_rebuild(const char ac_account_id[][MAX_LEN], int ac_count, int ac_index[], int index_capacity);
+int index_find(const char ac_account_id[][MAX_LEN], const int ac_index[], int index_capacity, const char account_id[]);
+int get_or_create_account_indexed(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_index[], int index_capacity,
+                                  int ac_capacity, int &ac_count, const char account_id[]);
+void apply_one_indexed(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_index[], int index_capacity,
+                       int ac_capacity, int &ac_count, const char account_id[], int tx_type, int amount_cents);
+void apply_all_indexed(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[], int tx_count,
+                       char ac_account_id[][MAX_LEN], int ac_balance[], int ac_index[], int index_capacity,
+                       int ac_capacity, int &ac_count);
+int balance_of_indexed(const char ac_account_id[][MAX_LEN], const int ac_balance[], const int ac_index[], int index_capacity,
+                       const char account_id[]);
+
 #endif
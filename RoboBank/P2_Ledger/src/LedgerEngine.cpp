@@ -0,0 +1,262 @@
+#include <climits>
+#include <cstring>
+#include "LedgerEngine.h"
+#include "LedgerKernels.h"
+#include "tx_kinds.h"
+
+namespace
+{
+    const std::uint32_t kEmptySlot = 0xFFFFFFFFu;
+
+    std::uint32_t hash_id(const char account_id[])
+    {
+        std::uint32_t h = 2166136261u;
+        for (int i = 0; i < MAX_LEN && account_id[i] != '\0'; i++)
+        {
+            h ^= static_cast<unsigned char>(account_id[i]);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    bool add_overflows(long long a, long long b)
+    {
+        return (b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b);
+    }
+
+    template <class T>
+    T *allocate_column(std::pmr::memory_resource *mr, std::size_t n)
+    {
+        return n ? static_cast<T *>(mr->allocate(n * sizeof(T), alignof(T))) : nullptr;
+    }
+
+    template <class T>
+    void release_column(std::pmr::memory_resource *mr, T *p, std::size_t n)
+    {
+        if (p)
+            mr->deallocate(p, n * sizeof(T), alignof(T));
+    }
+}
+
+LedgerEngine::LedgerEngine(std::pmr::memory_resource *mr)
+    : mr_(mr), ids_(nullptr), hashes_(nullptr), balances_(nullptr), index_(nullptr),
+      count_(0), capacity_(0), index_capacity_(0)
+{
+}
+
+LedgerEngine::~LedgerEngine()
+{
+    release_column(mr_, ids_, capacity_ * MAX_LEN);
+    release_column(mr_, hashes_, capacity_);
+    release_column(mr_, balances_, capacity_);
+    release_column(mr_, index_, index_capacity_);
+}
+
+void LedgerEngine::reserve(std::size_t accounts)
+{
+    if (accounts > capacity_)
+        grow_columns(accounts);
+    std::size_t want = 16;
+    while (want < 2 * accounts)
+        want *= 2;
+    if (want > index_capacity_)
+        grow_index(want);
+}
+
+std::size_t LedgerEngine::count() const { return count_; }
+const char *LedgerEngine::id_at(std::size_t i) const { return ids_ + i * MAX_LEN; }
+long long LedgerEngine::balance_at(std::size_t i) const { return balances_[i]; }
+const long long *LedgerEngine::balances() const { return balances_; }
+
+// Both grow functions allocate everything before they release or replace anything, so a
+// failed allocation leaves the engine as it was
+void LedgerEngine::grow_columns(std::size_t new_capacity)
+{
+    char *ids = allocate_column<char>(mr_, new_capacity * MAX_LEN);
+    std::uint32_t *hashes = nullptr;
+    long long *balances = nullptr;
+    try
+    {
+        hashes = allocate_column<std::uint32_t>(mr_, new_capacity);
+        balances = allocate_column<long long>(mr_, new_capacity);
+    }
+    catch (...)
+    {
+        release_column(mr_, hashes, new_capacity);
+        release_column(mr_, ids, new_capacity * MAX_LEN);
+        throw;
+    }
+    if (count_)
+    {
+        std::memcpy(ids, ids_, count_ * MAX_LEN);
+        std::memcpy(hashes, hashes_, count_ * sizeof(std::uint32_t));
+        std::memcpy(balances, balances_, count_ * sizeof(long long));
+    }
+    release_column(mr_, ids_, capacity_ * MAX_LEN);
+    release_column(mr_, hashes_, capacity_);
+    release_column(mr_, balances_, capacity_);
+    ids_ = ids;
+    hashes_ = hashes;
+    balances_ = balances;
+    capacity_ = new_capacity;
+}
+
+void LedgerEngine::grow_index(std::size_t new_capacity)
+{
+    std::uint32_t *index = allocate_column<std::uint32_t>(mr_, new_capacity);
+    for (std::size_t s = 0; s < new_capacity; s++)
+        index[s] = kEmptySlot;
+
+    // stored hashes make the rehash a pure slot walk
+    std::size_t mask = new_capacity - 1;
+    for (std::size_t i = 0; i < count_; i++)
+    {
+        std::size_t slot = hashes_[i] & mask;
+        while (index[slot] != kEmptySlot)
+            slot = (slot + 1) & mask;
+        index[slot] = static_cast<std::uint32_t>(i);
+    }
+    release_column(mr_, index_, index_capacity_);
+    index_ = index;
+    index_capacity_ = new_capacity;
+}
+
+// Returns the slot holding account_id, or the empty slot where it would be inserted
+std::size_t LedgerEngine::probe(const char account_id[], std::uint32_t hash) const
+{
+    std::size_t mask = index_capacity_ - 1;
+    std::size_t slot = hash & mask;
+    for (;;)
+    {
+        std::uint32_t pos = index_[slot];
+        if (pos == kEmptySlot)
+            return slot;
+        if (hashes_[pos] == hash && std::strncmp(id_at(pos), account_id, MAX_LEN) == 0)
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+}
+
+long long LedgerEngine::find(const char account_id[]) const
+{
+    if (count_ == 0)
+        return -1;
+    std::uint32_t pos = index_[probe(account_id, hash_id(account_id))];
+    return pos == kEmptySlot ? -1 : static_cast<long long>(pos);
+}
+
+long long LedgerEngine::get_or_create(const char account_id[], LedgerReport *report)
+{
+    std::uint32_t hash = hash_id(account_id);
+    std::size_t slot = 0;
+    if (index_capacity_)
+    {
+        slot = probe(account_id, hash);
+        if (index_[slot] != kEmptySlot)
+            return index_[slot];
+    }
+
+    // a new account: amortized growth, double the columns, keep the index at most half full
+    if (count_ == capacity_)
+        grow_columns(capacity_ ? capacity_ * 2 : 64);
+    if (2 * (count_ + 1) > index_capacity_)
+    {
+        grow_index(index_capacity_ ? index_capacity_ * 2 : 128);
+        slot = probe(account_id, hash);
+    }
+
+    char *dst = ids_ + count_ * MAX_LEN;
+    // all MAX_LEN bytes, as hash_id and probe read them: a full-width id is kept whole
+    std::strncpy(dst, account_id, MAX_LEN);
+    hashes_[count_] = hash;
+    balances_[count_] = 0;
+    index_[slot] = static_cast<std::uint32_t>(count_);
+    if (report)
+        report->created++;
+    return static_cast<long long>(count_++);
+}
+
+LedgerStatus LedgerEngine::apply_one(const char account_id[], int tx_type, long long amount_cents, LedgerReport *report)
+{
+    if (!Calculator::known_kind(tx_type))
+    {
+        if (report)
+            report->unknown_type++;
+        return LedgerStatus::UnknownType;
+    }
+    // a debit of LLONG_MIN has no negation
+    if (Calculator::kKindSign[tx_type] < 0 && amount_cents == LLONG_MIN)
+    {
+        if (report)
+            report->overflowed++;
+        return LedgerStatus::Overflow;
+    }
+    const long long delta = Calculator::kind_delta(tx_type, amount_cents);
+
+    if (account_id[0] == '\0')
+    {
+        if (report)
+            report->missing_id++;
+        return LedgerStatus::MissingId;
+    }
+
+    long long idx = get_or_create(account_id, report);
+    if (add_overflows(balances_[idx], delta))
+    {
+        if (report)
+            report->overflowed++;
+        return LedgerStatus::Overflow;
+    }
+    balances_[idx] += delta;
+    if (report)
+        report->applied++;
+    return LedgerStatus::Applied;
+}
+
+namespace
+{
+    // both apply_all overloads: Amount is long long or the fixed-array API's int
+    template <class Amount>
+    LedgerReport apply_rows(LedgerEngine &engine, const char tx_account_id[][MAX_LEN], const int tx_type[],
+                            const Amount tx_amount_cents[], std::size_t tx_count, std::vector<LedgerReject> *rejects)
+    {
+        LedgerReport report;
+        for (std::size_t i = 0; i < tx_count; i++)
+        {
+            LedgerStatus st = engine.apply_one(tx_account_id[i], tx_type[i], tx_amount_cents[i], &report);
+            if (st != LedgerStatus::Applied && rejects)
+                rejects->push_back(LedgerReject{i, st});
+        }
+        return report;
+    }
+}
+
+LedgerReport LedgerEngine::apply_all(const char tx_account_id[][MAX_LEN], const int tx_type[], const long long tx_amount_cents[],
+                                     std::size_t tx_count, std::vector<LedgerReject> *rejects)
+{
+    return apply_rows(*this, tx_account_id, tx_type, tx_amount_cents, tx_count, rejects);
+}
+
+LedgerReport LedgerEngine::apply_all(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[],
+                                     std::size_t tx_count, std::vector<LedgerReject> *rejects)
+{
+    return apply_rows(*this, tx_account_id, tx_type, tx_amount_cents, tx_count, rejects);
+}
+
+long long LedgerEngine::balance_of(const char account_id[]) const
+{
+    long long idx = find(account_id);
+    return (idx != -1) ? balances_[idx] : 0;
+}
+
+LedgerSummary LedgerEngine::bank_summary(const int tx_type[], const long long tx_amount_cents[], std::size_t tx_count) const
+{
+    KindTotals k = sum_by_kind(tx_type, tx_amount_cents, tx_count);
+    LedgerSummary s;
+    s.total_deposits = k.amount[0] + k.amount[4];
+    s.total_withdrawals = k.amount[1] + k.amount[5];
+    s.total_fees = k.amount[2];
+    s.total_interest = k.amount[3];
+    s.net_exposure = sum_balances(balances_, count_);
+    return s;
+}
@@ -0,0 +1,255 @@
+#include "LedgerKernels.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LEDGER_HAVE_AVX2 1
+#define LEDGER_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+#define LEDGER_HAVE_AVX2 1
+#define LEDGER_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#define LEDGER_HAVE_AVX2 0
+#endif
+
+namespace
+{
+    // ---- scalar bodies: branchless so the compiler can vectorize them ----
+
+    template <class Amount>
+    KindTotals kinds_scalar(const int type[], const Amount amount[], std::size_t n)
+    {
+        // slot TX_KINDS collects the unknown types, so the loop has no branch
+        long long acc[TX_KINDS + 1] = {0, 0, 0, 0, 0, 0, 0};
+        std::size_t unknown = 0;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            unsigned t = static_cast<unsigned>(type[i]);
+            bool bad = t >= static_cast<unsigned>(TX_KINDS);
+            acc[bad ? TX_KINDS : t] += amount[i];
+            unknown += bad;
+        }
+        KindTotals out;
+        for (int k = 0; k < TX_KINDS; k++)
+            out.amount[k] = acc[k];
+        out.unknown = static_cast<long long>(unknown);
+        return out;
+    }
+
+    template <class Value>
+    long long sum_scalar(const Value v[], std::size_t n)
+    {
+        long long s = 0;
+        for (std::size_t i = 0; i < n; i++)
+            s += v[i];
+        return s;
+    }
+
+    ExposureTotals exposure_scalar(const long long balance[], const int type[], std::size_t n)
+    {
+        ExposureTotals out;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            out.total += balance[i];
+            out.by_type[0] += type[i] == 0 ? balance[i] : 0;
+            out.by_type[1] += type[i] == 1 ? balance[i] : 0;
+        }
+        return out;
+    }
+
+    KindTotals kinds_i32_scalar(const int t[], const int a[], std::size_t n) { return kinds_scalar(t, a, n); }
+    KindTotals kinds_i64_scalar(const int t[], const long long a[], std::size_t n) { return kinds_scalar(t, a, n); }
+    long long sum_i32_scalar(const int v[], std::size_t n) { return sum_scalar(v, n); }
+    long long sum_i64_scalar(const long long v[], std::size_t n) { return sum_scalar(v, n); }
+
+#if LEDGER_HAVE_AVX2
+    // ---- AVX2 bodies ----
+
+    LEDGER_AVX2 long long hsum(__m256i v)
+    {
+        __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        return _mm_cvtsi128_si64(s) + _mm_extract_epi64(s, 1);
+    }
+
+    LEDGER_AVX2 long long sum_i32_avx2_lanes(__m256i v)
+    {
+        return hsum(_mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)),
+                                     _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1))));
+    }
+
+    // 8 rows per step: types and amounts are widened to int64 once, then each kind is a
+    // compare + mask + add on both halves
+    LEDGER_AVX2 KindTotals kinds_i32_avx2(const int type[], const int amount[], std::size_t n)
+    {
+        __m256i lo[TX_KINDS], hi[TX_KINDS];
+        for (int k = 0; k < TX_KINDS; k++)
+            lo[k] = hi[k] = _mm256_setzero_si256();
+        __m256i known = _mm256_setzero_si256(); // per lane: -1 for each row with a valid type
+        const __m256i last = _mm256_set1_epi32(TX_KINDS - 1);
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(type + i));
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(amount + i));
+            __m256i t_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(t));
+            __m256i t_hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(t, 1));
+            __m256i a_lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(a));
+            __m256i a_hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(a, 1));
+            for (int k = 0; k < TX_KINDS; k++)
+            {
+                __m256i kk = _mm256_set1_epi64x(k);
+                lo[k] = _mm256_add_epi64(lo[k], _mm256_and_si256(_mm256_cmpeq_epi64(t_lo, kk), a_lo));
+                hi[k] = _mm256_add_epi64(hi[k], _mm256_and_si256(_mm256_cmpeq_epi64(t_hi, kk), a_hi));
+            }
+            // unsigned t <= 5 <=> min(t, 5) == t
+            known = _mm256_add_epi32(known, _mm256_cmpeq_epi32(_mm256_min_epu32(t, last), t));
+        }
+        KindTotals out = kinds_scalar(type + i, amount + i, n - i);
+        for (int k = 0; k < TX_KINDS; k++)
+            out.amount[k] += hsum(_mm256_add_epi64(lo[k], hi[k]));
+        out.unknown += static_cast<long long>(i) + sum_i32_avx2_lanes(known);
+        return out;
+    }
+
+    // 4 rows per step: types are widened to int64 so one compare masks four 64-bit amounts
+    LEDGER_AVX2 KindTotals kinds_i64_avx2(const int type[], const long long amount[], std::size_t n)
+    {
+        __m256i acc[TX_KINDS];
+        for (int k = 0; k < TX_KINDS; k++)
+            acc[k] = _mm256_setzero_si256();
+        __m128i known = _mm_setzero_si128();
+        const __m128i last = _mm_set1_epi32(TX_KINDS - 1);
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128i t32 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(type + i));
+            __m256i t = _mm256_cvtepi32_epi64(t32);
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(amount + i));
+            for (int k = 0; k < TX_KINDS; k++)
+                acc[k] = _mm256_add_epi64(acc[k], _mm256_and_si256(_mm256_cmpeq_epi64(t, _mm256_set1_epi64x(k)), a));
+            known = _mm_add_epi32(known, _mm_cmpeq_epi32(_mm_min_epu32(t32, last), t32));
+        }
+        KindTotals out = kinds_scalar(type + i, amount + i, n - i);
+        for (int k = 0; k < TX_KINDS; k++)
+            out.amount[k] += hsum(acc[k]);
+        out.unknown += static_cast<long long>(i) + hsum(_mm256_cvtepi32_epi64(known));
+        return out;
+    }
+
+    LEDGER_AVX2 long long sum_i32_avx2(const int v[], std::size_t n)
+    {
+        __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i));
+            a0 = _mm256_add_epi64(a0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+            a1 = _mm256_add_epi64(a1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+        }
+        return hsum(_mm256_add_epi64(a0, a1)) + sum_scalar(v + i, n - i);
+    }
+
+    LEDGER_AVX2 long long sum_i64_avx2(const long long v[], std::size_t n)
+    {
+        // independent accumulators hide the add latency
+        __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+        __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            a0 = _mm256_add_epi64(a0, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i)));
+            a1 = _mm256_add_epi64(a1, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i + 4)));
+            a2 = _mm256_add_epi64(a2, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i + 8)));
+            a3 = _mm256_add_epi64(a3, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(v + i + 12)));
+        }
+        return hsum(_mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3))) + sum_scalar(v + i, n - i);
+    }
+
+    LEDGER_AVX2 ExposureTotals exposure_avx2(const long long balance[], const int type[], std::size_t n)
+    {
+        __m256i total = _mm256_setzero_si256(), t0 = _mm256_setzero_si256(), t1 = _mm256_setzero_si256();
+        const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi64x(1);
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(balance + i));
+            __m256i t = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i *>(type + i)));
+            total = _mm256_add_epi64(total, b);
+            t0 = _mm256_add_epi64(t0, _mm256_and_si256(_mm256_cmpeq_epi64(t, zero), b));
+            t1 = _mm256_add_epi64(t1, _mm256_and_si256(_mm256_cmpeq_epi64(t, one), b));
+        }
+        ExposureTotals out = exposure_scalar(balance + i, type + i, n - i);
+        out.total += hsum(total);
+        out.by_type[0] += hsum(t0);
+        out.by_type[1] += hsum(t1);
+        return out;
+    }
+
+    bool cpu_has_avx2()
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7) return false;
+        __cpuid(r, 1);
+        if (!(r[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) return false; // OS saves YMM state
+        __cpuidex(r, 7, 0);
+        return (r[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    struct Kernels
+    {
+        const char *isa;
+        KindTotals (*kinds_i32)(const int[], const int[], std::size_t);
+        KindTotals (*kinds_i64)(const int[], const long long[], std::size_t);
+        long long (*sum_i32)(const int[], std::size_t);
+        long long (*sum_i64)(const long long[], std::size_t);
+        ExposureTotals (*exposure)(const long long[], const int[], std::size_t);
+    };
+
+    const Kernels kScalar = {"scalar", kinds_i32_scalar, kinds_i64_scalar, sum_i32_scalar, sum_i64_scalar, exposure_scalar};
+#if LEDGER_HAVE_AVX2
+    const Kernels kAvx2 = {"avx2", kinds_i32_avx2, kinds_i64_avx2, sum_i32_avx2, sum_i64_avx2, exposure_avx2};
+#endif
+
+    const Kernels &best()
+    {
+#if LEDGER_HAVE_AVX2
+        static const Kernels &k = cpu_has_avx2() ? kAvx2 : kScalar;
+        return k;
+#else
+        return kScalar;
+#endif
+    }
+
+    const Kernels *forced = nullptr;
+
+    const Kernels &active() { return forced ? *forced : best(); }
+}
+
+KindTotals sum_by_kind(const int tx_type[], const int tx_amount_cents[], std::size_t tx_count)
+{
+    return active().kinds_i32(tx_type, tx_amount_cents, tx_count);
+}
+
+KindTotals sum_by_kind(const int tx_type[], const long long tx_amount_cents[], std::size_t tx_count)
+{
+    return active().kinds_i64(tx_type, tx_amount_cents, tx_count);
+}
+
+long long sum_balances(const int balance[], std::size_t count) { return active().sum_i32(balance, count); }
+long long sum_balances(const long long balance[], std::size_t count) { return active().sum_i64(balance, count); }
+
+ExposureTotals exposure_by_type(const long long balance[], const int account_type[], std::size_t count)
+{
+    return active().exposure(balance, account_type, count);
+}
+
+const char *ledger_kernel_isa() { return active().isa; }
+
+void ledger_kernels_force_scalar(bool on) { forced = on ? &kScalar : nullptr; }
@@ -1,12 +1,20 @@
 #include <cstring>
 #include "RoboBankLedger.h"
-#include "LedgerCalculator.h"
+#include "LedgerKernels.h"
+#include "tx_kinds.h"
 
+static void apply_to_balance(int &balance, int tx_type, int amount_cents)
+{
+    // the shared kind table: unknown types leave the balance as it is
+    balance = static_cast<int>(balance + Calculator::kind_delta(tx_type, amount_cents));
+}
+
+// Rows are compared and copied over at most MAX_LEN bytes: a full-width id has no terminator
 int find_account_index(const char ac_account_id[][MAX_LEN], int ac_count, const char account_id[])
 {
     for (int i = 0; i < ac_count; i++)
     {
-        if (strcmp(ac_account_id[i], account_id) == 0)
+        if (strncmp(ac_account_id[i], account_id, MAX_LEN) == 0)
         {
             return i;
         }
@@ -22,7 +30,7 @@ int get_or_create_account(char ac_account_id[][MAX_LEN], int ac_balance[], int a
 
     if (ac_count < ac_capacity)
     {
-        strcpy(ac_account_id[ac_count], account_id);
+        strncpy(ac_account_id[ac_count], account_id, MAX_LEN);
         ac_balance[ac_count] = 0;
         return ac_count++;
     }
@@ -36,21 +44,7 @@ void apply_one(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_capacity,
     if (idx == -1)
         return; // no space
 
-    switch (tx_type)
-    {
-    case 0: // Deposit
-    case 3: // Interest
-    case 4: // TransferIn
-        ac_balance[idx] = apply_deposit(ac_balance[idx], amount_cents);
-        break;
-    case 1: // Withdrawal
-    case 5: // TransferOut
-        ac_balance[idx] = apply_withdrawal(ac_balance[idx], amount_cents);
-        break;
-    case 2: // Fee
-        ac_balance[idx] = apply_fee(ac_balance[idx], amount_cents);
-        break;
-    }
+    apply_to_balance(ac_balance[idx], tx_type, amount_cents);
 }
 
 void apply_all(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[], int tx_count,
@@ -74,32 +68,111 @@ void bank_summary(const int tx_type[], const int tx_amount_cents[], int tx_count
                   int *out_total_fees, int *out_total_interest,
                   int *out_net_exposure)
 {
+    // one vectorized pass with 64-bit sums; the int outputs keep the original API
+    KindTotals k = sum_by_kind(tx_type, tx_amount_cents, tx_count > 0 ? tx_count : 0);
+    *out_total_deposits = static_cast<int>(k.amount[0] + k.amount[4]);
+    *out_total_withdrawals = static_cast<int>(k.amount[1] + k.amount[5]);
+    *out_total_fees = static_cast<int>(k.amount[2]);
+    *out_total_interest = static_cast<int>(k.amount[3]);
+    *out_net_exposure = static_cast<int>(sum_balances(ac_balance, ac_count > 0 ? ac_count : 0));
+}
 
-    *out_total_deposits = *out_total_withdrawals = *out_total_fees = *out_total_interest = *out_net_exposure = 0;
-
-    for (int i = 0; i < tx_count; i++)
+// FNV-1a over the id bytes, stopping at the terminator or MAX_LEN
+static unsigned int hash_id(const char account_id[])
+{
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < MAX_LEN && account_id[i] != '\0'; i++)
     {
-        switch (tx_type[i])
-        {
-        case 0:
-        case 4:
-            *out_total_deposits += tx_amount_cents[i];
-            break;
-        case 1:
-        case 5:
-            *out_total_withdrawals += tx_amount_cents[i];
-            break;
-        case 2:
-            *out_total_fees += tx_amount_cents[i];
-            break;
-        case 3:
-            *out_total_interest += tx_amount_cents[i];
-            break;
-        }
+        h ^= static_cast<unsigned char>(account_id[i]);
+        h *= 16777619u;
     }
+    return h;
+}
+
+int index_capacity_for(int ac_capacity)
+{
+    // keep the load factor at or below 1/2
+    int cap = 16;
+    while (cap < 2 * ac_capacity)
+        cap *= 2;
+    return cap;
+}
 
+void index_init(int ac_index[], int index_capacity)
+{
+    for (int i = 0; i < index_capacity; i++)
+        ac_index[i] = INDEX_EMPTY;
+}
+
+// Returns the slot holding account_id, or the empty slot where it would be inserted
+static int index_probe(const char ac_account_id[][MAX_LEN], const int ac_index[], int index_capacity, const char account_id[])
+{
+    unsigned int mask = static_cast<unsigned int>(index_capacity - 1);
+    unsigned int slot = hash_id(account_id) & mask;
+    while (ac_index[slot] != INDEX_EMPTY && strncmp(ac_account_id[ac_index[slot]], account_id, MAX_LEN) != 0)
+        slot = (slot + 1) & mask;
+    return static_cast<int>(slot);
+}
+
+void index_rebuild(const char ac_account_id[][MAX_LEN], int ac_count, int ac_index[], int index_capacity)
+{
+    index_init(ac_index, index_capacity);
     for (int i = 0; i < ac_count; i++)
     {
-        *out_net_exposure += ac_balance[i];
+        int slot = index_probe(ac_account_id, ac_index, index_capacity, ac_account_id[i]);
+        if (ac_index[slot] == INDEX_EMPTY)
+            ac_index[slot] = i;
     }
 }
+
+int index_find(const char ac_account_id[][MAX_LEN], const int ac_index[], int index_capacity, const char account_id[])
+{
+    return ac_index[index_probe(ac_account_id, ac_index, index_capacity, account_id)];
+}
+
+int get_or_create_account_indexed(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_index[], int index_capacity,
+                                  int ac_capacity, int &ac_count, const char account_id[])
+{
+    int slot = index_probe(ac_account_id, ac_index, index_capacity, account_id);
+    if (ac_index[slot] != INDEX_EMPTY)
+        return ac_index[slot];
+
+    if (ac_count < ac_capacity)
+    {
+        // all MAX_LEN bytes, as hash_id and index_probe read them: a full-width id is kept
+        // whole (without a terminator) rather than cut to a different id
+        strncpy(ac_account_id[ac_count], account_id, MAX_LEN);
+        ac_balance[ac_count] = 0;
+        ac_index[slot] = ac_count;
+        return ac_count++;
+    }
+    return -1; // no space
+}
+
+void apply_one_indexed(char ac_account_id[][MAX_LEN], int ac_balance[], int ac_index[], int index_capacity,
+                       int ac_capacity, int &ac_count, const char account_id[], int tx_type, int amount_cents)
+{
+    int idx = get_or_create_account_indexed(ac_account_id, ac_balance, ac_index, index_capacity, ac_capacity, ac_count, account_id);
+    if (idx == -1)
+        return; // no space
+
+    apply_to_balance(ac_balance[idx], tx_type, amount_cents);
+}
+
+void apply_all_indexed(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[], int tx_count,
+                       char ac_account_id[][MAX_LEN], int ac_balance[], int ac_index[], int index_capacity,
+                       int ac_capacity, int &ac_count)
+{
+    for (int i = 0; i < tx_count; i++)
+    {
+        apply_one_indexed(ac_account_id, ac_balance, ac_index, index_capacity, ac_capacity, ac_count,
+                          tx_account_id[i], tx_type[i], tx_amount_cents[i]);
+    }
+}
+
+int balance_of_indexed(const char ac_account_id[][MAX_LEN], const int ac_balance[], const int ac_index[], int index_capacity,
+                       const char account_id[])
+{
+    int idx = index_find(ac_account_id, ac_index, index_capacity, account_id);
+    return (idx != -1) ? ac_balance[idx] : 0;
+}
@@ -3,8 +3,9 @@
 
 #include "structs.h"
 #include "calculator.h"
+#include "AuditView.h"
 
-const int kMaxAudit = 256;
+const int kMaxAudit = kDefaultAuditCapacity;
 
 class Account
 {
@@ -15,7 +16,7 @@ public:
     double apr() const;
     long long balance_cents() const;
     int audit_size() const;
-    const TxRecord *audit_data() const;
+    AuditView<TxRecord> audit() const;
 // operations 
     void deposit(long long amount_cents, long long ts, const char *note = nullptr);
     void withdraw(long long amount_cents, long long ts, const char *note = nullptr);
@@ -29,8 +30,7 @@ private:
     const char *id_;
     AccountSettings settings_;
     long long balance_cents_;
-    TxRecord audit_[kMaxAudit];
-    int audit_count_;
+    AuditRing<TxRecord> audit_;
 };
 
 #endif // ACCOUNT_H
@@ -0,0 +1,185 @@
+// Fixed-capacity audit trail shared by Account (P3) and BaseAccount (P4)
+#ifndef AUDIT_RING_H
+#define AUDIT_RING_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+// Circular buffer that keeps the newest `capacity` records. Storage for all of them is allocated
+// by the constructor, so push() never allocates; once full it overwrites the oldest record.
+// Index 0 and begin() are the oldest record, so iteration is chronological.
+//
+// With `lazy` set, storage is instead allocated on the first push and doubles until it
+// reaches `capacity`, so a quiet ring holds only what it has recorded; pushes before the ring
+// first fills may then allocate.
+//
+// The storage comes from a std::pmr::memory_resource, the default resource (the heap) unless
+// one is given; a copy allocates from the same resource as the ring it copies. T must be
+// default constructible and copy assignable.
+template <class T>
+class AuditRing
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator(const AuditRing *ring, int pos) : ring_(ring), pos_(pos) {}
+        reference operator*() const { return (*ring_)[pos_]; }
+        pointer operator->() const { return &(*ring_)[pos_]; }
+        const_iterator &operator++()
+        {
+            ++pos_;
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++pos_;
+            return tmp;
+        }
+        bool operator==(const const_iterator &o) const { return pos_ == o.pos_; }
+        bool operator!=(const const_iterator &o) const { return pos_ != o.pos_; }
+
+    private:
+        const AuditRing *ring_;
+        int pos_;
+    };
+
+    explicit AuditRing(int capacity, std::pmr::memory_resource *mr = std::pmr::get_default_resource(), bool lazy = false)
+        : buf_(nullptr), mr_(mr), capacity_(capacity > 0 ? capacity : 0), allocated_(0), head_(0), size_(0)
+    {
+        if (!lazy && capacity_ > 0)
+            grow(capacity_);
+    }
+
+    // a copy of a ring with all its storage allocated gets all of it too
+    AuditRing(const AuditRing &other)
+        : buf_(nullptr), mr_(other.mr_), capacity_(other.capacity_), allocated_(0), head_(0), size_(0)
+    {
+        if (other.allocated_ == capacity_ && capacity_ > 0)
+            grow(capacity_);
+        for (const T &rec : other)
+            push(rec);
+    }
+    AuditRing &operator=(const AuditRing &other)
+    {
+        if (this != &other)
+        {
+            AuditRing tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+    AuditRing(AuditRing &&other) noexcept
+        : buf_(other.buf_), mr_(other.mr_), capacity_(other.capacity_), allocated_(other.allocated_),
+          head_(other.head_), size_(other.size_)
+    {
+        other.buf_ = nullptr;
+        other.allocated_ = 0;
+        other.head_ = 0;
+        other.size_ = 0;
+    }
+    AuditRing &operator=(AuditRing &&other) noexcept
+    {
+        // the storage goes with its resource, so rings on different resources move freely
+        AuditRing tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+    ~AuditRing() { release(buf_, allocated_); }
+
+    std::pmr::memory_resource *resource() const { return mr_; }
+    int capacity() const { return capacity_; }
+    int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == capacity_; }
+
+    // Returns true when the oldest record was evicted (or the ring has no capacity)
+    bool push(const T &rec)
+    {
+        if (capacity_ == 0)
+            return true;
+        if (size_ < capacity_)
+        {
+            if (size_ == allocated_)
+                grow(allocated_ ? allocated_ * 2 : 4); // lazy rings only
+            buf_[slot(size_)] = rec;
+            ++size_;
+            return false;
+        }
+        buf_[head_] = rec;
+        head_ = (head_ + 1 == capacity_) ? 0 : head_ + 1;
+        return true;
+    }
+
+    void clear()
+    {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    const T &operator[](int i) const { return buf_[slot(i)]; }
+    const T &front() const { return buf_[head_]; }
+    const T &back() const { return buf_[slot(size_ - 1)]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+    void swap(AuditRing &other) noexcept
+    {
+        std::swap(buf_, other.buf_);
+        std::swap(mr_, other.mr_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(allocated_, other.allocated_);
+        std::swap(head_, other.head_);
+        std::swap(size_, other.size_);
+    }
+
+private:
+    // only called before the ring first fills, while head_ is still 0
+    void grow(int n)
+    {
+        if (n > capacity_)
+            n = capacity_;
+        T *bigger = static_cast<T *>(mr_->allocate(n * sizeof(T), alignof(T)));
+        for (int i = 0; i < n; ++i)
+            ::new (static_cast<void *>(bigger + i)) T();
+        for (int i = 0; i < size_; ++i)
+            bigger[i] = buf_[i];
+        release(buf_, allocated_);
+        buf_ = bigger;
+        allocated_ = n;
+    }
+
+    void release(T *p, int n)
+    {
+        if (!p)
+            return;
+        std::destroy_n(p, n);
+        mr_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    int slot(int i) const
+    {
+        int s = head_ + i;
+        return (s >= capacity_) ? s - capacity_ : s;
+    }
+
+    T *buf_;
+    std::pmr::memory_resource *mr_;
+    int capacity_;
+    int allocated_; // <= capacity_
+    int head_; // oldest record
+    int size_;
+};
+
+#endif // AUDIT_RING_H
@@ -0,0 +1,154 @@
+// Non-owning, non-copying views over an AuditRing
+#ifndef AUDIT_VIEW_H
+#define AUDIT_VIEW_H
+
+#include <cstddef>
+#include <iterator>
+#include "AuditRing.h"
+
+// Record predicates usable with AuditView::where(); records need `kind` and `timestamp` fields.
+template <class K>
+struct AuditKindIs
+{
+    K kind;
+    template <class T>
+    bool operator()(const T &rec) const { return rec.kind == kind; }
+};
+
+struct AuditTimeBetween
+{
+    long long from; // inclusive
+    long long to;   // inclusive
+    template <class T>
+    bool operator()(const T &rec) const { return rec.timestamp >= from && rec.timestamp <= to; }
+};
+
+template <class P1, class P2>
+struct AuditBoth
+{
+    P1 first;
+    P2 second;
+    template <class T>
+    bool operator()(const T &rec) const { return first(rec) && second(rec); }
+};
+
+// Records of an AuditView that satisfy Pred, evaluated lazily while iterating.
+template <class T, class Pred>
+class FilteredAuditView
+{
+public:
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator(const AuditRing<T> *ring, const Pred *pred, int pos) : ring_(ring), pred_(pred), pos_(pos) { skip(); }
+        reference operator*() const { return (*ring_)[pos_]; }
+        pointer operator->() const { return &(*ring_)[pos_]; }
+        const_iterator &operator++()
+        {
+            ++pos_;
+            skip();
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const const_iterator &o) const { return pos_ == o.pos_; }
+        bool operator!=(const const_iterator &o) const { return pos_ != o.pos_; }
+
+    private:
+        void skip()
+        {
+            while (ring_ && pos_ < ring_->size() && !(*pred_)((*ring_)[pos_]))
+                ++pos_;
+        }
+
+        const AuditRing<T> *ring_;
+        const Pred *pred_;
+        int pos_;
+    };
+
+    FilteredAuditView(const AuditRing<T> *ring, Pred pred) : ring_(ring), pred_(pred) {}
+
+    const_iterator begin() const { return const_iterator(ring_, &pred_, 0); }
+    const_iterator end() const { return const_iterator(ring_, &pred_, ring_ ? ring_->size() : 0); }
+
+    // O(n) in the unfiltered size
+    std::size_t count() const
+    {
+        std::size_t n = 0;
+        for (auto it = begin(); it != end(); ++it)
+            ++n;
+        return n;
+    }
+
+    template <class Fn>
+    void for_each(Fn &&fn) const
+    {
+        for (const T &rec : *this)
+            fn(rec);
+    }
+
+    template <class P>
+    FilteredAuditView<T, AuditBoth<Pred, P>> where(P pred) const
+    {
+        return FilteredAuditView<T, AuditBoth<Pred, P>>(ring_, AuditBoth<Pred, P>{pred_, pred});
+    }
+    template <class K>
+    FilteredAuditView<T, AuditBoth<Pred, AuditKindIs<K>>> of_kind(K kind) const { return where(AuditKindIs<K>{kind}); }
+    FilteredAuditView<T, AuditBoth<Pred, AuditTimeBetween>> between(long long from, long long to) const
+    {
+        return where(AuditTimeBetween{from, to});
+    }
+
+private:
+    const AuditRing<T> *ring_;
+    Pred pred_;
+};
+
+// Chronological view of an account audit. Holds only a pointer to the ring, so it is cheap
+// to return by value; it is valid while the owning account is alive and sees later appends.
+template <class T>
+class AuditView
+{
+public:
+    using const_iterator = typename AuditRing<T>::const_iterator;
+
+    AuditView() : ring_(nullptr) {}
+    explicit AuditView(const AuditRing<T> &ring) : ring_(&ring) {}
+
+    std::size_t size() const { return ring_ ? static_cast<std::size_t>(ring_->size()) : 0; }
+    bool empty() const { return size() == 0; }
+    const T &operator[](std::size_t i) const { return (*ring_)[static_cast<int>(i)]; }
+    const T &front() const { return ring_->front(); }
+    const T &back() const { return ring_->back(); }
+    const_iterator begin() const { return ring_ ? ring_->begin() : const_iterator(nullptr, 0); }
+    const_iterator end() const { return ring_ ? ring_->end() : const_iterator(nullptr, 0); }
+
+    // Visitor variant: fn(const T&) is called oldest first
+    template <class Fn>
+    void for_each(Fn &&fn) const
+    {
+        for (const T &rec : *this)
+            fn(rec);
+    }
+
+    template <class P>
+    FilteredAuditView<T, P> where(P pred) const { return FilteredAuditView<T, P>(ring_, pred); }
+    template <class K>
+    FilteredAuditView<T, AuditKindIs<K>> of_kind(K kind) const { return where(AuditKindIs<K>{kind}); }
+    FilteredAuditView<T, AuditTimeBetween> between(long long from, long long to) const { return where(AuditTimeBetween{from, to}); }
+
+private:
+    const AuditRing<T> *ring_;
+};
+
+#endif // AUDIT_VIEW_H
@@ -4,11 +4,14 @@
 
 #include "enums.h"
 
+const int kDefaultAuditCapacity = 256;
+
 struct AccountSettings
 {
     AccountType type;
     double apr; 
     long long fee_flat_cents;
+    int audit_capacity = kDefaultAuditCapacity; // records kept before the oldest is dropped
 };
 
 struct TxRecord
@@ -1,15 +1,16 @@
 #include "account.h"
 #include <cstring>
+#include "tx_kinds.h"
 
 Account::Account(const char *id, const AccountSettings &settings, long long opening_balance_cents)
-    : id_(id), settings_(settings), balance_cents_(opening_balance_cents), audit_count_(0) {}
+    : id_(id), settings_(settings), balance_cents_(opening_balance_cents), audit_(settings.audit_capacity) {}
 
 const char *Account::id() const { return id_; }
 AccountType Account::type() const { return settings_.type; }
 double Account::apr() const { return settings_.apr; }
 long long Account::balance_cents() const { return balance_cents_; }
-int Account::audit_size() const { return audit_count_; }
-const TxRecord *Account::audit_data() const { return audit_; }
+int Account::audit_size() const { return audit_.size(); }
+AuditView<TxRecord> Account::audit() const { return AuditView<TxRecord>(audit_); }
 
 void Account::deposit(long long amount_cents, long long ts, const char *note)
 {
@@ -38,36 +39,15 @@ void Account::post_simple_interest(int days, int basis, long long ts, const char
 
 void Account::apply(const TxRecord &tx)
 {
-    switch (tx.kind)
-    {
-    case TxKind::Deposit:
-        deposit(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case TxKind::Withdrawal:
-        withdraw(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case TxKind::Fee:
-        charge_fee(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case TxKind::Interest:
-        // if amount is positive ---> post interest 
-        if (tx.amount_cents > 0)
-            deposit(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    }
+    // kinds as in the shared table (tx_kinds.h): an Interest record credits the amount it
+    // carries and the transfer legs post as themselves; unknown kinds are ignored
+    if (!Calculator::known_kind(tx.kind)) return;
+    balance_cents_ += Calculator::kind_delta(tx.kind, tx.amount_cents);
+    record(tx.kind, tx.amount_cents, tx.timestamp, tx.note);
 }
 
 void Account::record(TxKind kind, long long amount, long long ts, const char *note)
 {
-    if (audit_count_ < kMaxAudit)
-    {
-        audit_[audit_count_++] = {kind, amount, ts, note};
-    }
-    else
-    {
-        // Drop oldest
-        for (int i = 1; i < kMaxAudit; ++i)
-            audit_[i - 1] = audit_[i];
-        audit_[kMaxAudit - 1] = {kind, amount, ts, note};
-    }
+    // ring buffer drops the oldest record once full
+    audit_.push({kind, amount, ts, note});
 }
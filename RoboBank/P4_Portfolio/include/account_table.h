@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include "types.h"
+#include "calculator.h"
+#include "Enums.h"
+#include "AuditRing.h"
+
+namespace p4 {
+
+// Running sums of the balances per account type, indexed by AccountType (Checking, Savings)
+struct TypeTotals
+{
+    long long by_type[2] = {0, 0};
+};
+
+// Per-profile month-end amounts for one close (see AccountTable::month_end_rates): the interest
+// accrual under DayCount and the flat fee, each 0 where the close does not post it
+template <class DayCount>
+struct MonthEndRates
+{
+    std::vector<Calculator::Accrual<DayCount>> accrual;
+    std::vector<long long> fee;
+};
+
+// Changed flags per row and per page of rows, for read views (see p4::ViewBuilder). The
+// stores are relaxed atomics and skipped when the flag is already set, so parallel workers can
+// mark rows at once without writing to shared lines.
+class ChangeMarks
+{
+public:
+    static const unsigned kPageShift = 9; // 512 rows, the page of p4::ReadView
+
+    void resize(size_t rows); // keeps the flags set so far
+    size_t pages() const { return (rows_n_ + (size_t(1) << kPageShift) - 1) >> kPageShift; }
+    void mark(size_t row)
+    {
+        set(rows_[row]);
+        set(pages_[row >> kPageShift]);
+    }
+    bool page(size_t p) const { return pages_[p].load(std::memory_order_relaxed) != 0; }
+    bool row(size_t r) const { return rows_[r].load(std::memory_order_relaxed) != 0; }
+    void clear_page(size_t p); // and the flags of its rows
+
+private:
+    static void set(std::atomic<std::uint8_t> &f)
+    {
+        if (!f.load(std::memory_order_relaxed)) f.store(1, std::memory_order_relaxed);
+    }
+
+    std::unique_ptr<std::atomic<std::uint8_t>[]> rows_, pages_;
+    size_t rows_n_ = 0;
+    size_t cap_ = 0;
+};
+
+// Portfolio's account storage: one row per account handle, one column per field. Checking
+// and savings rows live side by side and are told apart by the type column, so the apply path
+// is a plain function over the columns rather than a virtual call per account. Settings are
+// deduplicated (most accounts share a few profiles) and rows refer to them by index.
+class AccountTable
+{
+public:
+    static const int kNoAccount = -1; // type of a handle with no row
+
+    // audit rings are allocated from audit_mr, lazily (see AuditRing)
+    explicit AccountTable(std::pmr::memory_resource *audit_mr = std::pmr::get_default_resource());
+
+    // Creates the row for h (rows below h that have no account stay kNoAccount)
+    void add(AccountHandle h, const AccountSettings &settings, long long opening_balance_cents);
+    void reserve(size_t rows);
+
+    bool contains(AccountHandle h) const { return h < type_.size() && type_[h] != kNoAccount; }
+    size_t rows() const { return type_.size(); } // handle bound, including empty rows
+    size_t count(AccountType t) const { return by_type_[t == AccountType::Savings]; }
+
+    AccountType type(AccountHandle h) const { return static_cast<AccountType>(type_[h]); }
+    long long balance(AccountHandle h) const { return balance_[h]; }
+    const AccountSettings &settings(AccountHandle h) const { return profiles_[profile_[h]]; }
+    const AuditRing<TxEntry> &audit(AccountHandle h) const { return audit_[h]; }
+
+    // hot path: posts tx.kind and tx.amount_cents to tx.account (Interest is credited like a
+    // deposit)
+    void apply(const TxEntry &tx);
+    // For workers applying different rows at once: the balance change goes to the caller's
+    // `totals` rather than the table's, to be added with merge_totals once the workers are done
+    void apply(const TxEntry &tx, TypeTotals &totals);
+    void merge_totals(const TypeTotals &t);
+    // apply() on each entry in order, balances by kind: the entries are bucketed by kind (a
+    // stable counting sort of their indices, in `scratch`), each bucket's balances are posted by
+    // a kernel compiled for its kind (Calculator::with_kind), then the audit rings are written
+    // in batch order. Same result as the loop over apply().
+    void apply_by_kind(const TxEntry *txs, size_t n, std::pmr::memory_resource *scratch);
+    // apply() in two halves, for batches that need every balance current before any audit
+    // entry is written: apply_balance(tx) then apply_audit(tx) is the same as apply(tx)
+    void apply_balance(const TxEntry &tx);
+    void apply_audit(const TxEntry &tx);
+    // puts back a balance saved before apply_balance, to roll a batch back
+    void set_balance(AccountHandle h, long long balance_cents);
+    // Computes simple interest on the balance at the row's apr and posts it; savings and
+    // checking both accept this, see charge_monthly_fee / accrue_interest for the type specific
+    // helpers
+    void post_interest(AccountHandle h, int days, int basis, long long ts, NoteId note);
+    // Checking only: charges the account's flat fee; false for other types
+    bool charge_monthly_fee(AccountHandle h, long long ts, NoteId note);
+    // Savings only: posts simple interest at the account's apr; false for other types
+    bool accrue_interest(AccountHandle h, int days, int basis, long long ts, NoteId note);
+    // The per-profile tables of one close: interest over `days` under the DayCount convention
+    // (Calculator::Act365, Act360 or Thirty360) when `interest`, the flat fee when `fees`.
+    // Built once per close; valid until the next add().
+    template <class DayCount>
+    MonthEndRates<DayCount> month_end_rates(long long days, bool interest, bool fees) const;
+    // Month-end amounts for rows [begin, end) into delta[0, end - begin): the interest a savings
+    // row accrues, minus the flat fee of a checking row, else 0. Reads the columns only, so
+    // ranges can run in parallel.
+    template <class DayCount>
+    void month_end_deltas(const MonthEndRates<DayCount> &rates, size_t begin, size_t end, long long delta[]) const;
+    // refills the audit ring from saved records (oldest first) without touching the balance
+    void restore_audit(AccountHandle h, const TxEntry *entries, size_t n);
+
+    // sums of the balances per type, kept up by every posting: O(1)
+    const TypeTotals &totals() const { return totals_; }
+    // the same sums from a scan of the balance column, to check totals() against
+    TypeTotals rescan_totals() const;
+
+    // columns, rows() long; empty rows have balance 0 and type kNoAccount
+    const long long *balances() const { return balance_.data(); }
+    const int *types() const { return type_.data(); }
+
+    // While on, every write to a row (balance, type or audit) marks it in changes(); a read
+    // view copies the marked pages and clears them. Off by default: the check is one branch.
+    void track_changes(bool on);
+    bool tracking_changes() const { return track_; }
+    ChangeMarks &changes() { return marks_; }
+
+private:
+    void mark(AccountHandle h)
+    {
+        if (track_) marks_.mark(h);
+    }
+    void post(AccountHandle h, TxKind kind, long long amount_cents, long long ts, NoteId note, TypeTotals &totals);
+    std::uint32_t profile_of(const AccountSettings &s);
+
+    struct ProfileHash
+    {
+        size_t operator()(const AccountSettings &s) const;
+    };
+    struct ProfileEq
+    {
+        bool operator()(const AccountSettings &a, const AccountSettings &b) const;
+    };
+
+    std::vector<long long> balance_;
+    std::vector<int> type_;                     // AccountType, or kNoAccount
+    std::vector<std::uint32_t> profile_;        // index into profiles_
+    std::vector<AuditRing<TxEntry>> audit_;
+    std::pmr::memory_resource *audit_mr_;
+    std::deque<AccountSettings> profiles_;      // deque: settings() references stay valid
+    std::unordered_map<AccountSettings, std::uint32_t, ProfileHash, ProfileEq> profile_ids_; // settings -> profile
+    std::uint32_t last_profile_;
+    size_t by_type_[2];
+    TypeTotals totals_;
+    bool track_;
+    ChangeMarks marks_;
+};
+
+}
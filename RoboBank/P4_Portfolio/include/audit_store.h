@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "types.h"
+
+namespace p4 {
+
+struct AuditStoreOptions
+{
+    size_t segment_entries = 1u << 16; // records per segment; the open segment is scanned, sealed ones are indexed
+    size_t resident_segments = 64;     // sealed segments kept in memory, 0 for no limit
+    // Where older segments go past the limit: files in this directory (read back on query), or
+    // when empty, compaction to their summaries (counted in AuditStoreStats::compacted_entries)
+    std::string spill_dir;
+    // compacted summaries kept; past it the neighbouring pair with the fewest records is merged
+    // into one, coarser in time (0 for no limit)
+    size_t compacted_summaries = 256;
+};
+
+// Amount and count per TxKind
+struct KindSums
+{
+    long long amount[6] = {0, 0, 0, 0, 0, 0};
+    std::uint64_t count[6] = {0, 0, 0, 0, 0, 0};
+};
+
+struct AuditStoreStats
+{
+    std::uint64_t entries = 0;           // appended in total
+    std::uint64_t segments = 0;          // sealed
+    std::uint64_t spilled_segments = 0;
+    std::uint64_t compacted_segments = 0;
+    std::uint64_t compacted_entries = 0; // no longer returned by account queries
+};
+
+// Time-indexed store for the portfolio audit (see Portfolio::attach_audit_store). Records are
+// appended in segments. A sealed segment is sorted by timestamp, with a posting list per
+// account and per-kind sums for the segment and for each block of 256 records. Queries skip
+// segments outside the window, take the sums of segments and blocks inside it and binary search
+// or scan only the edge blocks and posting lists, plus one scan of the open segment.
+// Timestamps need not arrive in order.
+//
+// Memory: the resident segments hold their records and indexes (about 40 bytes a record).
+// A spilled or compacted segment keeps only its sums and at most 16 block summaries, about
+// 2 KB. With compaction the summaries are capped at compacted_summaries, so memory is bounded
+// by resident_segments and compacted_summaries whatever has been appended. With spilling, the
+// 2 KB per spilled segment (about 32 bytes per 1000 records) sits beside its file on disk.
+//
+// Spill files are written with the host layout, named per store so several stores may share a
+// spill_dir, and removed by the destructor. Spill I/O failures throw std::system_error.
+class AuditStore
+{
+public:
+    explicit AuditStore(AuditStoreOptions opts = AuditStoreOptions());
+    ~AuditStore();
+    AuditStore(const AuditStore &) = delete;
+    AuditStore &operator=(const AuditStore &) = delete;
+
+    // All or nothing: the records are stored before any spill, and a spill that fails (throws)
+    // leaves its segment resident, past the limit, until the next seal spills it
+    void append(const TxEntry *entries, size_t n);
+    void seal(); // seals the open segment now, e.g. before a burst of queries
+
+    // Appends to `out` the records of account h with from <= timestamp <= to, in timestamp
+    // order (equal timestamps in append order); returns how many
+    size_t account_between(AccountHandle h, long long from, long long to, std::vector<TxEntry> &out) const;
+    // Sums per kind of the records with from <= timestamp <= to. *exact is false when a
+    // compacted segment overlaps the window only in part, so its records could not be counted.
+    KindSums kind_totals(long long from, long long to, bool *exact = nullptr) const;
+
+    const AuditStoreStats &stats() const { return stats_; }
+
+private:
+    struct Segment;
+
+    void seal_open();
+    void index_segment(Segment &g);
+    void spill_excess();
+    void spill_or_compact();
+    void merge_compacted();
+
+    AuditStoreOptions opts_;
+    std::string spill_prefix_; // file name prefix unique to this store
+    std::vector<TxEntry> open_;
+    std::vector<std::unique_ptr<Segment>> sealed_; // oldest first
+    size_t first_resident_;                        // sealed_ below this are spilled or compacted
+    AuditStoreStats stats_;
+};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "policy.h"
+
+namespace p4 {
+
+// The legs of an all-or-nothing posting for Portfolio::commit: every leg is applied, in order,
+// or none is. A transfer is two legs; a payroll run is one debit plus a credit per employee.
+class Batch
+{
+public:
+    void reserve(size_t legs) { legs_.reserve(legs); }
+    void clear() { legs_.clear(); }
+
+    void post(const std::string &account_id, TxKind kind, long long amount_cents, long long ts,
+              const std::string &note = std::string())
+    {
+        legs_.push_back(TxRecord{kind, amount_cents, ts, note, account_id});
+    }
+    void transfer(const std::string &from_id, const std::string &to_id, long long amount_cents, long long ts,
+                  const std::string &note = std::string())
+    {
+        post(from_id, TxKind::TransferOut, amount_cents, ts, note);
+        post(to_id, TxKind::TransferIn, amount_cents, ts, note);
+    }
+
+    size_t size() const { return legs_.size(); }
+    const std::vector<TxRecord> &legs() const { return legs_; }
+
+private:
+    std::vector<TxRecord> legs_;
+};
+
+struct BatchResult
+{
+    bool committed = false;
+    std::uint32_t leg = 0;                    // the first refused leg when not committed
+    RejectReason reason = RejectReason::None; // why it was refused
+};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "portfolio.h"
+
+// Thread-safe portfolio for serving transfers from many request threads.
+//  - accounts are guarded by striped mutexes; a two-account transfer locks both stripes in
+//    ascending stripe order, so concurrent transfers cannot deadlock
+//  - balances are mirrored into atomics after every posting, so balance_of(handle) and
+//    total_exposure() never take a lock (total_exposure is a running sum; transfers leave it
+//    unchanged, so readers never see half of a transfer)
+//  - the account table is sized once at construction; name lookups take a shared lock
+//  - transfers are checked against a p4::TxPolicy under the stripe locks, as
+//    Portfolio::transfer; apply() posts unchecked, as Portfolio::apply_all
+// Only per-account audits are kept: there is no portfolio-level log in this mode because
+// transfers from different threads have no defined global order.
+class ConcurrentPortfolio
+{
+public:
+    explicit ConcurrentPortfolio(size_t max_accounts, size_t lock_stripes = 1024);
+
+    bool add_account(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0);
+    p4::AccountHandle handle_of(std::string_view id) const; // p4::StringPool::npos if missing
+    p4::NoteId intern_note(std::string_view note);
+    size_t count() const;
+    size_t capacity() const;
+
+    bool apply(const p4::TxRecord &tx); // false if the account is missing
+    bool apply(const p4::TxEntry &tx);
+    // false if either account is missing or policy() refuses a leg; *reason says which
+    bool transfer(const p4::TransferRecord &tr, p4::RejectReason *reason = nullptr);
+    bool transfer(p4::AccountHandle from, p4::AccountHandle to, long long amount_cents, long long ts,
+                  p4::NoteId note = p4::kNoNote, p4::RejectReason *reason = nullptr);
+    // set before the portfolio is shared between threads
+    void set_policy(const p4::TxPolicy &policy);
+    const p4::TxPolicy &policy() const;
+
+    long long balance_of(const std::string &id) const;
+    long long balance_of(p4::AccountHandle h) const; // lock-free
+    long long total_exposure() const;                // lock-free
+    // lock-free running sum per type; a transfer between a checking and a savings account
+    // moves the two sums one after the other
+    long long total_of(AccountType t) const;
+
+    // Runs fn(const IAccount &) with the account's stripe held, e.g. to read its audit. The
+    // notes pool is held shared as well, so fn may look up notes (acc.notes().view) while other
+    // threads intern new ones.
+    template <class Fn>
+    bool with_account(p4::AccountHandle h, Fn &&fn) const
+    {
+        if (h == 0 || h >= published_.load(std::memory_order_acquire)) return false;
+        std::lock_guard<std::mutex> lock(stripe_of(h).mu);
+        std::shared_lock<std::shared_mutex> notes_lock(notes_mu_);
+        fn(static_cast<const IAccount &>(*slots_[h]));
+        return true;
+    }
+
+private:
+    struct alignas(64) Stripe
+    {
+        std::mutex mu;
+    };
+    struct alignas(64) PaddedBalance
+    {
+        std::atomic<long long> cents{0};
+    };
+
+    Stripe &stripe_of(p4::AccountHandle h) const { return stripes_[h % stripes_.size()]; }
+    long long post_locked(const p4::TxEntry &tx);
+
+    mutable std::shared_mutex dir_mu_;   // ids_ and account creation
+    mutable std::shared_mutex notes_mu_; // notes_: interning exclusive, lookups shared
+    p4::StringPool ids_;
+    p4::StringPool notes_;
+    std::vector<std::unique_ptr<BaseAccount>> slots_; // fixed size, filled up to published_
+    std::unique_ptr<PaddedBalance[]> balances_;
+    std::atomic<size_t> published_;
+    mutable std::vector<Stripe> stripes_;
+    std::atomic<long long> exposure_;
+    std::atomic<long long> by_type_[2]; // indexed by AccountType
+    p4::TxPolicy policy_;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace p4 {
+
+// CRC-32 (IEEE 802.3, reflected 0xEDB88320) used to check journal frames and snapshots.
+// Pass the previous result as `crc` to checksum data in pieces.
+inline std::uint32_t crc32(const void *data, std::size_t len, std::uint32_t crc = 0)
+{
+    static const struct Table
+    {
+        std::uint32_t v[256];
+        Table()
+        {
+            for (std::uint32_t i = 0; i < 256; ++i)
+            {
+                std::uint32_t c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                v[i] = c;
+            }
+        }
+    } table;
+
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    crc = ~crc;
+    for (std::size_t i = 0; i < len; ++i)
+        crc = table.v[(crc ^ p[i]) & 0xFFu] ^ (crc >> 8);
+    return ~crc;
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "types.h"
+
+namespace p4 {
+
+// Transaction file formats read by Portfolio::ingest_file.
+//  Csv:    one transaction per line, `account_id,kind,amount_cents,timestamp[,note]`; kind is the
+//          TxKind number, the note is the rest of the line. Empty lines and lines starting with
+//          '#' are ignored, as is a first line starting with "account_id" (a header).
+//  Binary: "RBTX" magic and uint32 version, then records of int64 amount_cents, int64 timestamp,
+//          uint8 kind, uint16 id length, uint16 note length, id bytes, note bytes (host order).
+enum class IngestFormat
+{
+    Csv = 0,
+    Binary = 1
+};
+
+enum class IngestStatus
+{
+    Applied = 0,
+    Malformed = 1,      // unparsable line or truncated record
+    UnknownKind = 2,    // kind outside 0..5
+    NegativeAmount = 3,
+    MissingId = 4       // empty account id
+};
+
+struct IngestReject
+{
+    std::uint64_t line; // 1-based line (Csv) or record number (Binary)
+    IngestStatus status;
+};
+
+struct IngestOptions
+{
+    size_t chunk_bytes = 4u << 20; // read size; a chunk grows only to hold one longer line
+    size_t chunks_in_flight = 4;   // buffers shared by the read, parse and apply stages
+    bool auto_create = true;       // as in apply_all
+    // false: skip Portfolio::audit(). With keep_notes off as well, memory then grows only with
+    // the accounts the file creates, not with its size.
+    bool portfolio_audit = true;
+    // false: drop each record's note (its entries get the empty note). Every distinct note is
+    // interned for good, so a file of mostly unique notes grows memory with its size.
+    bool keep_notes = true;
+    size_t max_rejects = 1000;     // rejects kept in IngestReport::rejects; the counts are always exact
+};
+
+struct IngestReport
+{
+    bool opened = false; // false if the file could not be read or has a bad binary header
+    std::uint64_t bytes = 0;
+    std::uint64_t records = 0; // transactions found, valid or not
+    std::uint64_t applied = 0;
+    std::uint64_t skipped_missing = 0; // valid, but the account is missing and auto_create is off
+    std::uint64_t malformed = 0;
+    std::uint64_t unknown_kind = 0;
+    std::uint64_t negative_amount = 0;
+    std::uint64_t missing_id = 0;
+    std::vector<IngestReject> rejects;
+
+    std::uint64_t rejected() const { return malformed + unknown_kind + negative_amount + missing_id; }
+};
+
+// Writes IngestFormat::Binary files.
+class BinaryTxWriter
+{
+public:
+    explicit BinaryTxWriter(const std::string &path);
+    bool ok() const;
+    bool write(const TxView &tx); // false if the id or note is longer than 65535 bytes
+    bool write(const TxRecord &tx);
+    bool close();
+
+private:
+    std::ofstream out_;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.h"
+
+class Portfolio;
+
+namespace p4 {
+
+struct JournalOptions
+{
+    size_t group_commit_bytes = 1 << 20;      // buffered frames are written and fsync'd once this full
+    bool fsync = true;                        // false: write() only, leave durability to the OS
+    size_t snapshot_every_bytes = 256u << 20; // journal bytes between automatic snapshots (0 = never)
+};
+
+struct JournalStats
+{
+    uint64_t frames = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    uint64_t syncs = 0;
+    uint64_t snapshots = 0;
+};
+
+// Binary append-only write-ahead journal for a Portfolio.
+//
+// Layout of `dir`: journal.<seq> segments and snapshot.<seq> files. snapshot.N holds every
+// account (id, settings, balance) as of the start of journal.N, so recovery loads the newest
+// valid snapshot and replays only the segments from N on. Each Portfolio operation (batch,
+// transfer, add_account) becomes one CRC-checked frame, replayed whole or not at all; a torn
+// frame at the end of a segment (crash mid-write) ends that segment's replay.
+//
+// Frames are buffered and written with a single fsync per group_commit_bytes (group commit);
+// call sync() where a caller needs durability. Integers are stored in host byte order.
+// Only operations that go through Portfolio are journaled, not direct IAccount calls, and
+// audits from before the newest snapshot are not restored.
+//
+// I/O failures throw std::system_error: a journal that silently stops writing is not a journal.
+// A failed write cuts the segment back to its last whole frame and keeps the frames buffered,
+// so the next write sends them again from there; an operation that rolls back instead drops
+// its own frame with abort_frame.
+class Journal
+{
+public:
+    explicit Journal(const std::string &dir, JournalOptions opts = JournalOptions());
+    ~Journal();
+    Journal(const Journal &) = delete;
+    Journal &operator=(const Journal &) = delete;
+
+    // Rebuilds `into` (expected empty, no journal attached) and opens a fresh segment for
+    // appends; call it before attaching, also on an empty directory. Returns the number of
+    // frames replayed after the snapshot.
+    size_t recover(Portfolio &into);
+
+    // Portfolio-side hooks; a frame groups the records of one operation. begin_frame takes
+    // the automatic snapshot when one is due, while `p` matches everything logged so far.
+    void begin_frame(const Portfolio &p);
+    void log_account(AccountHandle h, std::string_view id, const AccountSettings &settings, long long opening_balance_cents);
+    void log_entries(const Portfolio &p, const TxEntry *entries, size_t n);
+    void end_frame();
+    // drops the current operation's frame: the open one, or after end_frame the one it closed
+    // while that is still buffered (end_frame threw writing it). Notes first defined in it
+    // are defined again by the next frame.
+    void abort_frame();
+
+    void sync();                       // write buffered frames and fsync
+    void snapshot(const Portfolio &p); // snapshot + rotate to a new segment + drop older files
+    const JournalStats &stats() const;
+
+private:
+    void open_segment(uint64_t seq);
+    void write_buffer();
+    bool replay_segment(const std::string &path, Portfolio &into, size_t &frames);
+    bool load_snapshot(const std::string &path, Portfolio &into);
+    void remove_before(uint64_t seq);
+    std::string path_of(const char *kind, uint64_t seq) const;
+
+    std::string dir_;
+    JournalOptions opts_;
+    int fd_;
+    uint64_t seq_;
+    std::vector<char> buf_;           // complete frames not yet written
+    size_t frame_start_;              // offset of the open frame in buf_, or npos
+    size_t last_frame_;               // offset of the frame end_frame closed, while buffered, or npos
+    std::vector<NoteId> frame_notes_; // notes first defined by that frame (or the open one)
+    uint64_t frame_entries_;          // entries logged in it
+    std::vector<bool> note_defined_;  // note ids already defined in the current segment
+    uint64_t segment_bytes_;
+    JournalStats stats_;
+
+    // recovery: note ids in the segment being replayed -> ids in the rebuilt portfolio.
+    // Account handles need no map: ids are interned only on creation, in the same order.
+    std::vector<NoteId> note_map_;
+};
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+namespace p4 {
+
+// Where a Portfolio gets its memory (see Portfolio(const MemoryOptions &)). Account rows are
+// already columns and ids and notes already live in StringPool arenas; these options cover the
+// two remaining sources of small allocations.
+struct MemoryOptions
+{
+    // where everything below comes from; null is std::pmr::get_default_resource(). It need not
+    // be thread-safe unless other code shares it: a portfolio calls it from one thread at a time.
+    std::pmr::memory_resource *upstream = nullptr;
+    // Carve the per-account audit rings from a pool of large chunks instead of one heap block
+    // per account and per growth step. Either way ring allocations are synchronized, as
+    // parallel apply grows rings from several workers at once; false takes a lock around
+    // upstream instead.
+    bool pooled_audit = true;
+    // Scratch of one batch call (apply_checked, transfer_batch, apply_all_parallel,
+    // apply_from_ledger): its temporaries are bump allocated from an arena of this many bytes,
+    // spilling to upstream, and released all at once when the call returns. 0 for the heap.
+    size_t batch_arena_bytes = 256 * 1024;
+};
+
+}
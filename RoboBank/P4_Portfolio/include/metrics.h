@@ -0,0 +1,167 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Built with PORTFOLIO_METRICS=0 (cmake -DPORTFOLIO_METRICS=OFF) the hooks below are empty
+// inlines and the snapshot is all zeros
+#ifndef PORTFOLIO_METRICS
+#define PORTFOLIO_METRICS 1
+#endif
+
+namespace p4 {
+
+enum class Counter : std::uint8_t
+{
+    TxApplied,       // postings applied by the batch paths (apply_all, apply_checked, ...)
+    Batches,         // batch calls
+    AutoCreated,     // accounts created for unknown ids by auto_create
+    TxRejected,      // refused by apply_checked / transfer_batch / commit
+    Transfers,       // transfer() calls
+    TransferMissing, // transfer() with an unknown id
+    TransferRefused, // transfer() refused by the policy
+    Lookups,         // id -> handle lookups
+    LookupMisses,
+    AuditEvictions,  // account audit records dropped to make room
+    Count
+};
+
+enum class Timer : std::uint8_t
+{
+    Batch,    // every batch call
+    Transfer, // one transfer() in 64
+    Lookup,   // one lookup in 1024
+    Count
+};
+
+// Log2 buckets of nanoseconds: bucket 0 holds 0 ns, bucket k holds [2^(k-1), 2^k)
+struct LatencyHistogram
+{
+    static const int kBuckets = 40;
+    std::uint64_t bucket[kBuckets] = {};
+    std::uint64_t count = 0;
+    std::uint64_t sum_ns = 0;
+
+    // upper bound of the bucket that holds quantile q, 0 when empty
+    std::uint64_t quantile_ns(double q) const;
+};
+
+// Totals over every thread since start (or reset_metrics). The counters are process wide: all
+// portfolios of the process add to them.
+struct MetricsSnapshot
+{
+    std::uint64_t counter[static_cast<int>(Counter::Count)] = {};
+    LatencyHistogram latency[static_cast<int>(Timer::Count)];
+
+    std::uint64_t operator[](Counter c) const { return counter[static_cast<int>(c)]; }
+    const LatencyHistogram &of(Timer t) const { return latency[static_cast<int>(t)]; }
+};
+
+MetricsSnapshot metrics_snapshot();
+void reset_metrics();
+// Prometheus text exposition format
+std::string metrics_text(const MetricsSnapshot &s);
+// writes metrics_text(metrics_snapshot()) to `path` through a temporary file and a rename, so
+// a scraper (e.g. node_exporter's textfile collector) never reads half a file
+bool write_metrics_file(const std::string &path);
+
+// Answers every connection on 127.0.0.1:port with an HTTP response holding metrics_text, from
+// a background thread, until destroyed. POSIX only: start() is false elsewhere.
+class MetricsServer
+{
+public:
+    MetricsServer();
+    ~MetricsServer();
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    bool start(unsigned short port); // port 0 picks a free one, see port()
+    void stop();
+    unsigned short port() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+namespace metrics {
+
+#if PORTFOLIO_METRICS
+    // One per thread, written only by its thread: the hot path is a relaxed load and store on
+    // a line no other thread writes. Recycled for a new thread once its thread exits.
+    struct alignas(64) Shard
+    {
+        std::atomic<std::uint64_t> counter[static_cast<int>(Counter::Count)] = {};
+        std::atomic<std::uint64_t> bucket[static_cast<int>(Timer::Count)][LatencyHistogram::kBuckets] = {};
+        std::atomic<std::uint64_t> sum_ns[static_cast<int>(Timer::Count)] = {};
+        std::uint32_t tick[static_cast<int>(Timer::Count)] = {}; // sampling
+    };
+
+    Shard *register_shard();
+    inline thread_local Shard *tls_shard = nullptr;
+
+    inline Shard &shard()
+    {
+        Shard *s = tls_shard;
+        return s ? *s : *(tls_shard = register_shard());
+    }
+
+    inline void bump(std::atomic<std::uint64_t> &a, std::uint64_t n)
+    {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    inline void add(Counter c, std::uint64_t n = 1) { bump(shard().counter[static_cast<int>(c)], n); }
+
+    inline void add_batch(std::uint64_t applied)
+    {
+        Shard &s = shard();
+        bump(s.counter[static_cast<int>(Counter::Batches)], 1);
+        bump(s.counter[static_cast<int>(Counter::TxApplied)], applied);
+    }
+
+    void record(Timer t, std::uint64_t ns);
+
+    // Times its scope into the histogram of t, for the sampled share of the calls
+    class Scope
+    {
+    public:
+        explicit Scope(Timer t) : t_(t)
+        {
+            static const std::uint32_t mask[] = {0, 63, 1023};
+            Shard &s = shard();
+            on_ = (s.tick[static_cast<int>(t)]++ & mask[static_cast<int>(t)]) == 0;
+            if (on_) start_ = std::chrono::steady_clock::now();
+        }
+        ~Scope()
+        {
+            if (on_)
+                record(t_, static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                          std::chrono::steady_clock::now() - start_)
+                                                          .count()));
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Timer t_;
+        bool on_;
+        std::chrono::steady_clock::time_point start_;
+    };
+#else
+    inline void add(Counter, std::uint64_t = 1) {}
+    inline void add_batch(std::uint64_t) {}
+
+    class Scope
+    {
+    public:
+        explicit Scope(Timer) {}
+    };
+#endif
+
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+
+namespace p4 {
+
+// Day-count conventions of Calculator (calculator.h): the year basis the accrual days are divided by
+enum class DayCount
+{
+    Act365 = 0,
+    Act360 = 1,
+    Thirty360 = 2 // count `days` with Calculator::Thirty360::days(from, to)
+};
+
+// Options for Portfolio::close_month. Savings accounts accrue simple interest on their balance
+// at their apr for `days` under `day_count`, exactly (see Calculator::simple_interest); checking
+// accounts pay their flat monthly fee.
+struct MonthEndOptions
+{
+    long long timestamp = 0; // of the posted records
+    long long days = 30;
+    DayCount day_count = DayCount::Act365;
+    bool accrue_interest = true;
+    bool charge_fees = true;
+    bool skip_zero = true; // no record for a zero interest or fee
+    unsigned threads = 1;  // workers over account ranges; small books always run on one
+};
+
+struct MonthEndReport
+{
+    size_t interest_posted = 0;
+    size_t fees_charged = 0;
+    long long interest_cents = 0;
+    long long fee_cents = 0;
+};
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace p4 {
+
+// Bounded lock-free queue for many producers and one consumer (Vyukov's bounded queue: each
+// cell carries a sequence number that says whose turn it is). Producers claim a cell with one
+// CAS on the tail and publish it with a release store; the consumer needs no atomic RMW at
+// all. try_push fails when the ring is full rather than waiting, so the caller picks the
+// back-pressure policy.
+template <class T>
+class MpscRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscRing(size_t capacity) : head_(0)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n *= 2;
+        mask_ = n - 1;
+        cells_.reset(new Cell[n]);
+        for (size_t i = 0; i < n; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+    MpscRing(const MpscRing &) = delete;
+    MpscRing &operator=(const MpscRing &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // any thread; v is left untouched when the ring is full
+    bool try_push(T &&v)
+    {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;)
+        {
+            c = &cells_[pos & mask_];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (dif == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (dif < 0)
+                return false; // the consumer has not freed this cell yet: full
+            else
+                pos = tail_.load(std::memory_order_relaxed);
+        }
+        c->value = std::move(v);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only
+    bool try_pop(T &out)
+    {
+        Cell &c = cells_[head_ & mask_];
+        if (c.seq.load(std::memory_order_acquire) != head_ + 1) return false;
+        out = std::move(c.value);
+        c.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    // consumer thread only: no published cell at the head. A push in progress (claimed but
+    // not yet published) counts as empty.
+    bool empty() const { return cells_[head_ & mask_].seq.load(std::memory_order_acquire) != head_ + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> tail_; // producers
+    alignas(64) size_t head_;              // consumer
+};
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <climits>
+#include <cstdint>
+#include "types.h"
+#include "tx_kinds.h"
+
+namespace p4 {
+
+enum class RejectReason : std::uint8_t
+{
+    None = 0,
+    UnknownKind = 1,    // kind outside 0..5
+    NegativeAmount = 2, // below TxPolicy::min_amount_cents
+    AmountTooLarge = 3, // above TxPolicy::max_amount_cents
+    KindNotAllowed = 4, // the account type does not take this kind
+    Overdraft = 5,      // the debit would take the balance below -overdraft_limit_cents
+    MissingAccount = 6  // and auto_create is off (or a transfer side is missing)
+};
+
+// One rejected transaction of a batch, by its position in the batch
+struct TxRejection
+{
+    std::uint32_t index;
+    RejectReason reason;
+};
+
+// Rules enforced by Portfolio::apply_checked, Portfolio::transfer and
+// ConcurrentPortfolio::transfer. Per account type arrays are indexed by AccountType (Checking,
+// Savings).
+struct TxPolicy
+{
+    long long min_amount_cents = 0;
+    long long max_amount_cents = 0x7FFFFFFFFFFFFFFFLL;
+    long long overdraft_limit_cents[2] = {0, 0}; // how far below zero a debit may take the balance (LLONG_MAX: no limit)
+    unsigned allowed_kinds[2] = {0x3Fu, 0x3Fu};   // bit k set: TxKind k may post to the type
+
+    static bool is_debit(TxKind k) { return Calculator::known_kind(k) && Calculator::kKindSign[k] < 0; }
+
+    // Rules that need no account: computed with selects, not branches, for the batch pre-pass
+    RejectReason check_amount(TxKind kind, long long amount_cents) const
+    {
+        bool bad_kind = static_cast<unsigned>(kind) > static_cast<unsigned>(TxKind::TransferOut);
+        RejectReason r = amount_cents > max_amount_cents ? RejectReason::AmountTooLarge : RejectReason::None;
+        r = amount_cents < min_amount_cents ? RejectReason::NegativeAmount : r;
+        return bad_kind ? RejectReason::UnknownKind : r;
+    }
+
+    // Rules against the account the transaction posts to, for a kind check_amount accepted
+    RejectReason check_account(int account_type, long long balance_cents, TxKind kind, long long amount_cents) const
+    {
+        int t = account_type == 1;
+        if (!((allowed_kinds[t] >> kind) & 1u)) return RejectReason::KindNotAllowed;
+        if (is_debit(kind) && overdraws(balance_cents, amount_cents, overdraft_limit_cents[t])) return RejectReason::Overdraft;
+        return RejectReason::None;
+    }
+
+    // amount - limit > balance, without overflow for any limit (balance + limit overflows for
+    // a large one): when amount - limit is out of range its sign alone decides
+    static bool overdraws(long long balance_cents, long long amount_cents, long long limit_cents)
+    {
+        if (limit_cents >= 0 ? amount_cents < LLONG_MIN + limit_cents : amount_cents > LLONG_MAX + limit_cents)
+            return limit_cents < 0;
+        return amount_cents - limit_cents > balance_cents;
+    }
+};
+
+}
@@ -1,12 +1,30 @@
 #pragma once
+#include <exception>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <utility>
 #include "types.h"
+#include "string_pool.h"
+#include "account_table.h"
+#include "ingest.h"
+#include "month_end.h"
+#include "policy.h"
+#include "batch.h"
+#include "transfer_batch.h"
+#include "memory_options.h"
+#include "metrics.h"
+#include "read_view.h"
 #include "Enums.h" // for AccountType (from P3_Account/include)
+#include "AuditView.h"
 #include "RoboBankLedger.h"
 
+namespace p4 { class Journal; class AuditStore; }
+
 class IAccount
 {
 public:
@@ -19,13 +37,21 @@ public:
     virtual void charge_fee(long long fee_cents, long long ts, const std::string &note) = 0;
     virtual void post_simple_interest(int days, int basis, long long ts, const std::string &note) = 0;
     virtual void apply(const p4::TxRecord &tx) = 0;
-    virtual std::vector<p4::TxRecord> audit() const = 0;
+    // hot path: already-interned record, no string work
+    virtual void apply(const p4::TxEntry &tx) = 0;
+    // chronological, non-copying view; see AuditView for kind/time filters and for_each
+    virtual AuditView<p4::TxEntry> audit() const = 0;
+    // resolves TxEntry::note ids found in audit()
+    virtual const p4::StringPool &notes() const = 0;
+    virtual const p4::AccountSettings &settings() const = 0;
 };
 
 class BaseAccount : public IAccount
 {
 public:
-    BaseAccount(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0);
+    // notes: shared note pool (the Portfolio's); a private one is created when null
+    BaseAccount(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0,
+                p4::StringPool *notes = nullptr, p4::AccountHandle handle = 0);
     const std::string &id() const override;
     virtual AccountType type() const = 0; // keep abstract for derived
     long long balance_cents() const override;
@@ -34,19 +60,32 @@ public:
     void charge_fee(long long fee_cents, long long ts, const std::string &note) override;
     void post_simple_interest(int days, int basis, long long ts, const std::string &note) override;
     void apply(const p4::TxRecord &tx) override;
-    std::vector<p4::TxRecord> audit() const override;
+    void apply(const p4::TxEntry &tx) override;
+    AuditView<p4::TxEntry> audit() const override;
+    const p4::StringPool &notes() const override;
+    const p4::AccountSettings &settings() const override;
+    p4::AccountHandle handle() const;
+    // refills the audit ring from saved records (oldest first) without touching the balance
+    void restore_audit(const p4::TxEntry *entries, size_t n);
 
 protected:
+    void post(p4::TxKind kind, long long amount_cents, long long ts, p4::NoteId note);
+    void post_interest(int days, int basis, long long ts, p4::NoteId note);
+
     std::string id_;
     p4::AccountSettings settings_;
     long long balance_cents_;
-    std::vector<p4::TxRecord> audit_;
+    p4::AccountHandle handle_;
+    std::unique_ptr<p4::StringPool> own_notes_;
+    p4::StringPool *notes_;
+    AuditRing<p4::TxEntry> audit_;
 };
 
 class CheckingAccount : public BaseAccount
 {
 public:
-    CheckingAccount(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0);
+    CheckingAccount(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0,
+                    p4::StringPool *notes = nullptr, p4::AccountHandle handle = 0);
     AccountType type() const override;
     // additional helpers
     void charge_monthly_fee(long long ts);
@@ -55,28 +94,194 @@ public:
 class SavingsAccount : public BaseAccount
 {
 public:
-    SavingsAccount(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0);
+    SavingsAccount(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0,
+                   p4::StringPool *notes = nullptr, p4::AccountHandle handle = 0);
     AccountType type() const override;
     // additional helpers
     void accrue_interest(int days, int basis, long long ts);
 };
 
+// IAccount over one row of a Portfolio's account table, as returned by Portfolio::get_account.
+// Holds no account state of its own: reads and posts go straight to the table.
+class AccountRef : public IAccount
+{
+public:
+    AccountRef(p4::AccountTable *table, p4::StringPool *notes, p4::AccountHandle handle, std::string_view id);
+    const std::string &id() const override;
+    AccountType type() const override;
+    long long balance_cents() const override;
+    void deposit(long long amount_cents, long long ts, const std::string &note) override;
+    void withdraw(long long amount_cents, long long ts, const std::string &note) override;
+    void charge_fee(long long fee_cents, long long ts, const std::string &note) override;
+    void post_simple_interest(int days, int basis, long long ts, const std::string &note) override;
+    void apply(const p4::TxRecord &tx) override;
+    void apply(const p4::TxEntry &tx) override;
+    AuditView<p4::TxEntry> audit() const override;
+    const p4::StringPool &notes() const override;
+    const p4::AccountSettings &settings() const override;
+    p4::AccountHandle handle() const;
+
+private:
+    p4::AccountTable *table_;
+    p4::StringPool *notes_;
+    p4::AccountHandle handle_;
+    std::string id_;
+};
+
 class Portfolio
 {
 public:
     Portfolio();
+    // see p4::MemoryOptions; mem.upstream must outlive the portfolio
+    explicit Portfolio(const p4::MemoryOptions &mem);
     bool add_account(const std::string &id, const p4::AccountSettings &settings, long long opening_balance_cents = 0);
-    IAccount *get_account(const std::string &id) const;
+    // A new IAccount facade over the account's row (null if there is none), valid while the
+    // portfolio lives. Not cached, so concurrent calls on a const portfolio stay read-only;
+    // bulk paths do not need it.
+    std::unique_ptr<IAccount> get_account(const std::string &id) const;
     size_t count() const;
+    // room for `accounts` accounts in total without regrowing the id and account tables
+    void reserve(size_t accounts);
+    // Posts every transaction as given; see apply_checked for the policy-checked path
     void apply_all(const std::vector<p4::TxRecord> &txs, bool auto_create = true);
+    // Applies, in order, the transactions that pass policy() and returns the others by index.
+    // Overdraft is checked against the running balance, so earlier transactions in the batch
+    // count. Rejected transactions create no account and leave no audit record.
+    std::vector<p4::TxRejection> apply_checked(const std::vector<p4::TxRecord> &txs, bool auto_create = true);
+    // All or nothing: applies every leg of `batch` in order when each one passes policy()
+    // against the balance the legs before it leave, else changes nothing and reports the first
+    // refused leg. Legs must name existing accounts. Costs O(legs) whatever the portfolio size;
+    // the legs are journaled as one frame.
+    p4::BatchResult commit(const p4::Batch &batch);
+    // Same result as apply_all: accounts are created and notes interned serially, then the
+    // batch is split into shards by account handle (per-account order is kept) and applied on
+    // `threads` workers. The portfolio audit is appended in input order.
+    void apply_all_parallel(const std::vector<p4::TxRecord> &txs, unsigned threads, bool auto_create = true);
+    // Streams a transaction file (see p4::IngestFormat) through a read -> parse/validate -> apply
+    // pipeline on three threads. Memory is bounded by opts.chunks_in_flight chunks whatever the
+    // file size; transactions are applied in file order, in one apply_all-style batch per chunk.
+    p4::IngestReport ingest_file(const std::string &path, p4::IngestFormat fmt,
+                                 const p4::IngestOptions &opts = p4::IngestOptions());
+    // Month-end close over every account in one pass over the account columns: savings accrue
+    // interest, checking pay their flat fee (see p4::MonthEndOptions). The records are appended
+    // to audit() and the account audits in handle order and journaled as one frame.
+    p4::MonthEndReport close_month(const p4::MonthEndOptions &opts = p4::MonthEndOptions());
     void apply_from_ledger(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[], int tx_count);
-    bool transfer(const p4::TransferRecord &tr);
+    // A two-leg commit(): false if either account is missing or policy() refuses a leg;
+    // *reason says which
+    bool transfer(const p4::TransferRecord &tr, p4::RejectReason *reason = nullptr);
+    // Same result as transfer() on each transfer of the batch in order (see
+    // p4::TransferBatchOptions for netting): each distinct id is resolved and each note interned
+    // once, and no strings are built per transfer. The postings are journaled as one frame; if
+    // the journal write fails the whole batch is rolled back and the error rethrown.
+    p4::TransferBatchReport transfer_batch(const p4::TransferBatch &batch,
+                                           const p4::TransferBatchOptions &opts = p4::TransferBatchOptions());
     long long balance_of(const std::string &id) const;
+    // The totals are running sums kept by every posting, so these are O(1) whatever the
+    // number of accounts
     long long total_exposure() const;
+    long long total_of(AccountType t) const;
     std::vector<std::string> list_ids() const;
     std::unordered_map<AccountType, long long> totals_by_type() const;
+    // Consistency check: rescans every balance and compares with the running totals. In check
+    // mode the three readers above also rescan on each call, return the rescanned figures and
+    // count any disagreement in totals_mismatches().
+    bool verify_totals() const;
+    void set_check_totals(bool on);
+    // Batch mode of apply_all, apply_from_ledger and ingest_file (see
+    // p4::AccountTable::apply_by_kind): each batch's balances are posted in runs of one kind,
+    // then its audits in order. Same results; off by default.
+    void set_apply_by_kind(bool on);
+    size_t totals_mismatches() const;
+
+    // rules for apply_checked and transfer; the default allows no overdraft
+    void set_policy(const p4::TxPolicy &policy);
+    const p4::TxPolicy &policy() const;
+
+    // interned handles: ids map 1:1 to handles, notes are deduplicated
+    p4::AccountHandle handle_of(std::string_view id) const; // p4::StringPool::npos if missing
+    std::string_view id_of(p4::AccountHandle h) const;
+    std::string_view note_of(p4::NoteId n) const;
+    const std::vector<p4::TxEntry> &audit() const;
+
+    // Appends every later add_account/apply/transfer to `journal` (see p4::Journal) before it
+    // is applied; null detaches. Recover into the portfolio first, then attach.
+    void attach_journal(p4::Journal *journal);
+
+    // Moves the portfolio audit into `store` (see p4::AuditStore) at the end of every operation,
+    // so memory stays bounded: audit() then holds only the records of the operation in progress,
+    // and history is queried through the store. Records already in audit() go first; null detaches.
+    void attach_audit_store(p4::AuditStore *store);
+
+    // Point-in-time views (see p4::ReadView) for reports on other threads while this one keeps
+    // applying. From here on every posting marks its page, and at the end of an operation the
+    // writer copies the marked pages into a new view when a reader is waiting in next_view (or
+    // every opts.publish_every operations). Call on the writer's thread; it publishes a first view.
+    void enable_read_views(const p4::ReadViewOptions &opts = p4::ReadViewOptions());
+    // writer's thread, between operations: publishes a view of the state now and returns it
+    std::shared_ptr<const p4::ReadView> publish_view();
+    // Any thread. latest_view is the newest published view (null until enable_read_views);
+    // next_view asks the writer for a new one and waits up to `timeout` for the end of its
+    // current operation, returning the latest view if none comes.
+    std::shared_ptr<const p4::ReadView> latest_view() const;
+    std::shared_ptr<const p4::ReadView> next_view(std::chrono::milliseconds timeout = std::chrono::milliseconds(100)) const;
+
+    // Columnar snapshot (see p4::MappedSnapshot, which serves reads from the file directly):
+    // accounts with settings and balances, plus audit rings and notes when with_audit is set.
+    bool save_snapshot(const std::string &path, bool with_audit = false) const;
+    // Into an empty portfolio with no journal attached; handles and note ids match the saved ones.
+    bool load_snapshot(const std::string &path);
 
 private:
-    std::unordered_map<std::string, std::unique_ptr<IAccount>> accounts_;
-    std::vector<p4::TxRecord> audit_; // portfolio level audit
+    friend class p4::Journal; // replays records into the tables below
+
+    // Scratch memory of one batch call (see p4::MemoryOptions::batch_arena_bytes); a local
+    // whose pmr containers must not outlive it
+    struct Scratch
+    {
+        explicit Scratch(Portfolio &p);
+        std::optional<std::pmr::monotonic_buffer_resource> arena;
+        std::pmr::memory_resource *resource;
+    };
+
+    p4::AccountHandle create_account(std::string_view id, const p4::AccountSettings &settings, long long opening_balance_cents);
+    // Rec is p4::TxRecord or p4::TxView (instantiated in portfolio.cpp)
+    template <class Rec>
+    void resolve(const Rec *txs, size_t n, bool auto_create, std::vector<p4::TxEntry> &out);
+    // room for `more` appends to an audit that grows batch by batch, growing it geometrically
+    static void reserve_more(std::vector<p4::TxEntry> &v, size_t more);
+    // Checks and applies the staged entries audit_[first, end) as one unit: balances move under
+    // an undo log, and a refused entry or a journal failure rolls them back and drops the stage
+    p4::BatchResult commit_staged(size_t first);
+    // hands audit_ to the attached audit store, if any
+    void flush_audit();
+    // end of every operation: flush_audit, then a read view if one is due, then the error of a
+    // journal write that failed during the operation, or else of flush_audit, if any
+    void end_operation();
+    // journal_->end_frame() for operations that do not roll back: when the write fails the frame
+    // stays buffered for the next write, so the operation is finished in memory to match it and
+    // end_operation rethrows the failure
+    void close_frame();
+    // posts resolved entries, one by one or by kind (set_apply_by_kind)
+    void apply_entries(const p4::TxEntry *txs, size_t n, std::pmr::memory_resource *scratch);
+    // the running totals, or in check mode the rescanned ones
+    p4::TypeTotals read_totals() const;
+
+    p4::MemoryOptions mem_;                        // upstream resolved, never null
+    std::unique_ptr<std::pmr::memory_resource> audit_mr_; // audit rings: a pool, or upstream behind a lock
+    std::unique_ptr<char[]> arena_;                // batch_arena_bytes, reused by every Scratch
+    p4::StringPool ids_;                           // account id -> handle
+    p4::StringPool notes_;                         // shared by all accounts' audits
+    p4::AccountTable accounts_;                   // indexed by handle; no row if id interned without account
+    size_t count_;
+    std::vector<p4::TxEntry> audit_; // portfolio level audit
+    p4::Journal *journal_;
+    std::exception_ptr journal_error_; // set by close_frame, rethrown by end_operation
+    p4::AuditStore *audit_store_;
+    p4::TxPolicy policy_;
+    bool check_totals_;
+    bool apply_by_kind_;
+    mutable size_t totals_mismatches_;
+    std::vector<std::pair<p4::AccountHandle, long long>> undo_; // commit_staged, transfer_batch: balances before each leg
+    std::unique_ptr<p4::ViewBuilder> views_;                    // null until enable_read_views
 };
@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "types.h"
+#include "account_table.h"
+#include "string_pool.h"
+#include "Enums.h"
+
+namespace p4 {
+
+struct ReadViewOptions
+{
+    // also copy the audit rings of the accounts changed since the previous view (one block
+    // per changed page) and the notes, for ReadView::audit
+    bool with_audit = false;
+    // publish at the end of every n-th operation as well; 0 only when a reader asks (next_view)
+    unsigned publish_every = 0;
+};
+
+// Immutable point-in-time copy of a Portfolio at the end of an operation: balances, types, ids,
+// running totals and, with ReadViewOptions::with_audit, the account audits. Columns are held in
+// pages of 512 rows shared with the previous view, so the writer copies only the pages written
+// since then. Any number of threads may read a view while the writer goes on; pages are freed
+// when the last view holding them is dropped. Ids and notes are views into the portfolio's
+// string pools, so a ReadView must not outlive its Portfolio.
+class ReadView
+{
+public:
+    static const unsigned kPageShift = ChangeMarks::kPageShift;
+    static const size_t kPageRows = size_t(1) << kPageShift;
+
+    std::uint64_t version() const { return version_; } // 1, 2, ... per portfolio
+    size_t count() const { return count_; }
+    size_t rows() const { return rows_; } // handle bound, as AccountTable::rows
+
+    bool contains(AccountHandle h) const { return h < rows_ && row(h).type != AccountTable::kNoAccount; }
+    long long balance_of(AccountHandle h) const { return h < rows_ ? row(h).balance : 0; }
+    AccountType type_of(AccountHandle h) const { return static_cast<AccountType>(row(h).type); }
+    std::string_view id_of(AccountHandle h) const { return (*ids_[h >> kPageShift])[h & (kPageRows - 1)]; }
+
+    // the portfolio's running totals when the view was taken
+    long long total_exposure() const { return totals_.by_type[0] + totals_.by_type[1]; }
+    long long total_of(AccountType t) const { return totals_.by_type[t == AccountType::Savings]; }
+    std::unordered_map<AccountType, long long> totals_by_type() const;
+    std::vector<std::string> list_ids() const;
+
+    bool has_audit() const { return with_audit_; }
+    // the account's audit ring oldest first, n entries; n is 0 without with_audit
+    const TxEntry *audit(AccountHandle h, size_t &n) const;
+    std::string_view note_of(NoteId n) const; // with_audit only
+
+private:
+    friend class ViewBuilder;
+
+    struct Row
+    {
+        long long balance;
+        int type;
+    };
+    template <class T>
+    using Pages = std::vector<std::shared_ptr<const std::array<T, kPageRows>>>;
+    // a row's audit: entries [offset, offset + size) of a block holding the rings of the rows
+    // of one page that changed before the same view
+    struct Audit
+    {
+        std::shared_ptr<const std::vector<TxEntry>> block;
+        std::uint32_t offset = 0;
+        std::uint32_t size = 0;
+    };
+
+    const Row &row(AccountHandle h) const { return (*rows_pages_[h >> kPageShift])[h & (kPageRows - 1)]; }
+
+    std::uint64_t version_ = 0;
+    size_t rows_ = 0;
+    size_t count_ = 0;
+    size_t type_count_[2] = {0, 0};
+    TypeTotals totals_;
+    Pages<Row> rows_pages_;
+    Pages<std::string_view> ids_;
+    bool with_audit_ = false;
+    Pages<Audit> audit_;
+    Pages<std::string_view> notes_;
+    size_t note_count_ = 0;
+};
+
+// Portfolio's side of read views: builds each view from the previous one and the table's
+// change marks on the writer's thread, and hands the newest to readers. Readers only take a
+// mutex to copy a shared_ptr, so they never wait for an operation and the writer never waits
+// for a report.
+class ViewBuilder
+{
+public:
+    explicit ViewBuilder(const ReadViewOptions &opts);
+
+    // writer's thread, between operations: a view of the state now, published to readers. The
+    // first one copies everything and turns on the table's change tracking.
+    std::shared_ptr<const ReadView> publish(AccountTable &table, const StringPool &ids, const StringPool &notes,
+                                            size_t count);
+    // writer's thread, at the end of every operation: true when a reader waits or
+    // publish_every is reached
+    bool due()
+    {
+        if (wanted_.load(std::memory_order_relaxed)) return true;
+        return opts_.publish_every && ++ops_ >= opts_.publish_every;
+    }
+
+    // any thread
+    std::shared_ptr<const ReadView> latest() const;
+    std::shared_ptr<const ReadView> next(std::chrono::milliseconds timeout) const;
+
+private:
+    ReadViewOptions opts_;
+    unsigned ops_;
+    std::shared_ptr<const ReadView> last_; // writer's thread only
+    mutable std::mutex mu_;
+    mutable std::condition_variable cv_;
+    std::shared_ptr<const ReadView> published_; // under mu_
+    mutable std::atomic<bool> wanted_;
+};
+
+}
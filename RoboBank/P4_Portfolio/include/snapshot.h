@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "types.h"
+#include "Enums.h"
+
+namespace p4 {
+
+// On-disk layout written by Portfolio::save_snapshot. All integers are host byte order and
+// every section starts on a 64-byte boundary, so a mapped file is used in place.
+struct SnapshotHeader
+{
+    static const std::uint32_t kMagic = 0x53434252u; // "RBCS"
+    static const std::uint32_t kVersion = 1;
+
+    enum Section
+    {
+        IdOffsets,    // uint64[accounts + 1] into IdChars
+        IdChars,      // account ids back to back
+        Type,         // int32[accounts]
+        Apr,          // double[accounts]
+        FeeFlat,      // int64[accounts]
+        AuditCap,     // int32[accounts]
+        Balance,      // int64[accounts]
+        Index,        // uint32[index_slots]: open addressing on hash_bytes(id), row or npos
+        NoteOffsets,  // uint64[notes + 1] into NoteChars (with_audit only)
+        NoteChars,    //
+        AuditOffsets, // uint64[accounts + 1] into AuditEntries (with_audit only)
+        AuditEntries, // TxEntry[audit_entries], each account's ring oldest first
+        kSections
+    };
+
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t file_size;
+    std::uint64_t accounts;
+    std::uint64_t notes;         // 0 without audits
+    std::uint64_t audit_entries; // 0 without audits
+    std::uint64_t index_slots;   // power of two, at least 2 * accounts
+    long long total_exposure;
+    long long checking_total;
+    long long savings_total;
+    std::uint64_t checking_accounts;
+    std::uint64_t savings_accounts;
+    std::uint64_t offset[kSections];
+    std::uint64_t size[kSections];
+    std::uint32_t header_crc; // crc32 of the header up to this field
+    std::uint32_t reserved;
+};
+
+// Read-only view of a snapshot file mapped into memory. open() checks only the header, the
+// section sizes against the counts and the ends of the offset columns, so it costs the same for
+// ten accounts or ten million; column pages are faulted in on first touch. The row accessors
+// trust the columns: verify() checks them all, at a cost proportional to the file. Rows are in handle order: row i is the account that
+// Portfolio::load_snapshot creates i-th.
+class MappedSnapshot
+{
+public:
+    static const std::uint32_t npos = 0xFFFFFFFFu;
+
+    MappedSnapshot();
+    ~MappedSnapshot();
+    MappedSnapshot(const MappedSnapshot &) = delete;
+    MappedSnapshot &operator=(const MappedSnapshot &) = delete;
+
+    bool open(const std::string &path); // false if missing, truncated or not a snapshot
+    void close();
+    bool is_open() const { return hdr_ != nullptr; }
+    // Offsets in order, valid types, an index holding each (distinct) id once, distinct notes and
+    // audit records of a known kind and note. Portfolio::load_snapshot calls it before loading.
+    bool verify() const;
+
+    std::size_t count() const { return static_cast<std::size_t>(hdr_->accounts); }
+    std::uint32_t find(std::string_view id) const; // row, or npos
+    std::string_view id(std::uint32_t row) const;
+    AccountType type(std::uint32_t row) const { return static_cast<AccountType>(col<std::int32_t>(SnapshotHeader::Type)[row]); }
+    AccountSettings settings(std::uint32_t row) const;
+    long long balance(std::uint32_t row) const { return col<long long>(SnapshotHeader::Balance)[row]; }
+
+    long long balance_of(std::string_view id) const; // 0 if missing, as Portfolio::balance_of
+    long long total_exposure() const { return hdr_->total_exposure; }
+    std::unordered_map<AccountType, long long> totals_by_type() const;
+
+    bool has_audit() const { return hdr_->size[SnapshotHeader::AuditOffsets] != 0; }
+    std::size_t note_count() const { return static_cast<std::size_t>(hdr_->notes); }
+    std::string_view note(NoteId n) const;
+    // audit entries of one row, oldest first; their account field is the row's handle
+    const TxEntry *audit(std::uint32_t row, std::size_t &n) const;
+
+private:
+    template <class T>
+    const T *col(int section) const { return reinterpret_cast<const T *>(base_ + hdr_->offset[section]); }
+
+    const char *base_;
+    const SnapshotHeader *hdr_;
+    std::size_t mapped_;
+#ifdef _WIN32
+    void *file_;
+    void *mapping_;
+#endif
+};
+
+}
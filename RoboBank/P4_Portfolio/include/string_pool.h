@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace p4 {
+
+// FNV-1a; also keys the id index stored in snapshot files, so it must not change
+std::uint32_t hash_bytes(std::string_view s);
+
+// Deduplicating string arena. Each distinct string is copied once into a chunked arena and
+// gets a dense 32-bit id; views returned by view() stay valid for the pool's lifetime.
+// Lookups and repeated interns do not allocate. Id 0 is always the empty string.
+class StringPool
+{
+public:
+    static const std::uint32_t npos = 0xFFFFFFFFu;
+
+    StringPool();
+    StringPool(const StringPool &) = delete;
+    StringPool &operator=(const StringPool &) = delete;
+
+    std::uint32_t intern(std::string_view s);
+    // sizes the tables for n strings, so interning up to n does not reallocate them
+    void reserve(std::size_t n);
+    std::uint32_t find(std::string_view s) const; // npos if absent
+    std::string_view view(std::uint32_t id) const { return entries_[id]; }
+    std::size_t size() const { return entries_.size(); }
+    std::size_t arena_bytes() const { return arena_bytes_; }
+
+private:
+    std::size_t probe(std::string_view s, std::uint32_t hash) const;
+    const char *store(std::string_view s);
+    void grow_index();
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::size_t block_used_;
+    std::size_t block_size_;
+    std::size_t arena_bytes_;
+    std::vector<std::string_view> entries_;
+    std::vector<std::uint32_t> hashes_;
+    std::vector<std::uint32_t> index_; // open addressing, slot -> id or npos
+};
+
+}
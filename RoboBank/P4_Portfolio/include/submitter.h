@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include "types.h"
+#include "policy.h"
+#include "mpsc_ring.h"
+
+class Portfolio;
+
+namespace p4 {
+
+struct SubmitOptions
+{
+    size_t queue_capacity = 16384; // transactions waiting; rounded up to a power of two
+    size_t max_batch = 1024;       // transactions per apply_checked call
+    bool auto_create = true;       // as in apply_checked
+    unsigned spin = 256;           // polls of an empty queue before the apply thread sleeps
+};
+
+// Called on the apply thread with RejectReason::None when applied, else why not; keep it short,
+// the next batch waits for it. An exception it throws is caught and dropped (counted in
+// SubmitStats::callback_errors); it does not affect the batch.
+using SubmitCallback = std::function<void(RejectReason)>;
+
+struct SubmitStats
+{
+    std::uint64_t submitted = 0;
+    std::uint64_t completed = 0;
+    std::uint64_t batches = 0;    // apply_checked calls
+    std::uint64_t full_waits = 0; // submits that found the queue full and waited
+    std::uint64_t callback_errors = 0; // callbacks that threw
+};
+
+// Asynchronous front end for a Portfolio: any number of threads submit transactions and
+// transfers into a bounded lock-free queue (MpscRing), and one apply thread drains it, applying
+// runs of transactions with apply_checked (so the policy applies and each one gets a reason)
+// and transfers with transfer(), in queue order. Being the only writer, the apply thread needs
+// no lock on the portfolio; while a TxSubmitter runs, nothing else may touch the portfolio.
+//
+// submit() blocks while the queue is full (back-pressure); try_submit() returns false instead.
+// stop() and the destructor apply everything submitted before returning. If the portfolio
+// throws (a journal write failure), the open futures of that batch get the exception and its
+// open callbacks are not called.
+class TxSubmitter
+{
+public:
+    explicit TxSubmitter(Portfolio &portfolio, const SubmitOptions &opts = SubmitOptions());
+    ~TxSubmitter();
+    TxSubmitter(const TxSubmitter &) = delete;
+    TxSubmitter &operator=(const TxSubmitter &) = delete;
+
+    std::future<RejectReason> submit(TxRecord tx);
+    std::future<RejectReason> submit(TransferRecord tr);
+    void submit(TxRecord tx, SubmitCallback done);
+    void submit(TransferRecord tr, SubmitCallback done);
+    // false, and `done` is not called, when the queue is full
+    bool try_submit(TxRecord tx, SubmitCallback done);
+    bool try_submit(TransferRecord tr, SubmitCallback done);
+
+    // Applies what is queued and ends the apply thread; submitting afterwards is an error
+    void stop();
+    SubmitStats stats() const;
+
+private:
+    // a transaction, or a transfer from tx.account_id to to_id
+    struct Item
+    {
+        TxRecord tx;
+        std::string to_id;
+        bool transfer = false;
+        std::optional<std::promise<RejectReason>> promise;
+        SubmitCallback done;
+    };
+
+    static Item item_of(TxRecord &&tx);
+    static Item item_of(TransferRecord &&tr);
+    bool push(Item &&item, bool wait);
+    std::future<RejectReason> push_promise(Item &&item);
+    void run();
+    void wake();
+
+    Portfolio &portfolio_;
+    SubmitOptions opts_;
+    MpscRing<Item> ring_;
+    std::atomic<bool> stopping_;
+    std::atomic<bool> sleeping_;
+    std::mutex mu_; // only for the apply thread's sleep
+    std::condition_variable cv_;
+    std::atomic<std::uint64_t> submitted_, full_waits_;
+    std::atomic<std::uint64_t> completed_, batches_, callback_errors_; // written by the apply thread
+    std::thread thread_;
+};
+
+}
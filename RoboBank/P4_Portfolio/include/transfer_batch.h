@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "types.h"
+#include "policy.h"
+#include "string_pool.h"
+
+namespace p4 {
+
+// Columnar transfers for Portfolio::transfer_batch. Ids and notes are interned into the batch
+// as they are added, so a settlement run of millions of transfers between a few thousand
+// accounts stores each id once, and the portfolio resolves each id once.
+class TransferBatch
+{
+public:
+    void reserve(size_t transfers)
+    {
+        from_.reserve(transfers);
+        to_.reserve(transfers);
+        note_.reserve(transfers);
+        amount_.reserve(transfers);
+        timestamp_.reserve(transfers);
+    }
+
+    void add(std::string_view from_id, std::string_view to_id, long long amount_cents, long long ts,
+             std::string_view note = std::string_view())
+    {
+        from_.push_back(ids_.intern(from_id));
+        to_.push_back(ids_.intern(to_id));
+        note_.push_back(notes_.intern(note));
+        amount_.push_back(amount_cents);
+        timestamp_.push_back(ts);
+    }
+    void add(const TransferRecord &tr) { add(tr.from_id, tr.to_id, tr.amount_cents, tr.timestamp, tr.note); }
+
+    size_t size() const { return amount_.size(); }
+    // columns, size() long; from/to index ids(), note indexes notes()
+    const std::uint32_t *from() const { return from_.data(); }
+    const std::uint32_t *to() const { return to_.data(); }
+    const std::uint32_t *note() const { return note_.data(); }
+    const long long *amount_cents() const { return amount_.data(); }
+    const long long *timestamp() const { return timestamp_.data(); }
+    const StringPool &ids() const { return ids_; }
+    const StringPool &notes() const { return notes_; }
+
+private:
+    StringPool ids_, notes_;
+    std::vector<std::uint32_t> from_, to_, note_;
+    std::vector<long long> amount_, timestamp_;
+};
+
+struct TransferBatchOptions
+{
+    // Post one transfer per account pair, of the net amount (timestamped with the pair's latest
+    // transfer, with its first note), instead of one per transfer. Balances come out as with
+    // sequential transfers whenever none would be refused; a refused net transfer rejects every
+    // transfer of its pair, and a pair that nets to zero posts nothing. A self-transfer (same
+    // account both sides) is never netted: each posts, or is refused, on its own.
+    bool net_pairs = false;
+};
+
+struct TransferBatchReport
+{
+    size_t applied = 0;             // transfers applied (netted ones included)
+    size_t postings = 0;            // transfers posted: applied, or the net pairs posted
+    std::vector<TxRejection> rejected; // by index in the batch, in batch order
+};
+
+}
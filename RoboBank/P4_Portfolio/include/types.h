@@ -1,14 +1,19 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace p4 {
 
+const int kDefaultAuditCapacity = 256;
+
 struct AccountSettings
 {
     int type;
     double apr; 
     long long fee_flat_cents;
+    int audit_capacity = kDefaultAuditCapacity; // per-account audit ring size
 };
 
 enum TxKind
@@ -30,6 +35,32 @@ struct TxRecord
     std::string account_id; 
 };
 
+// Interned forms used on the hot path: an account handle indexes the Portfolio's account
+// table, a note id indexes its deduplicated note pool (see StringPool).
+using AccountHandle = std::uint32_t;
+using NoteId = std::uint32_t;
+const NoteId kNoNote = 0; // the empty note
+
+// Compact, trivially copyable transaction/audit record
+struct TxEntry
+{
+    long long amount_cents;
+    long long timestamp;
+    AccountHandle account;
+    NoteId note;
+    TxKind kind;
+};
+
+// Non-owning TxRecord: the strings live in a caller's buffer (ledger arrays, an ingest chunk)
+struct TxView
+{
+    TxKind kind;
+    long long amount_cents;
+    long long timestamp;
+    std::string_view note;
+    std::string_view account_id;
+};
+
 struct TransferRecord
 {
     std::string from_id;
@@ -0,0 +1,271 @@
+#include "../include/account_table.h"
+#include <algorithm>
+#include <cstring>
+#include "calculator.h"
+#include "tx_kinds.h"
+#include "LedgerKernels.h"
+#include "../include/metrics.h"
+
+using namespace std;
+
+namespace p4 {
+
+const int AccountTable::kNoAccount;
+
+// apr is compared and hashed by its bits, so every distinct value is its own profile
+size_t AccountTable::ProfileHash::operator()(const AccountSettings &s) const
+{
+    uint64_t apr;
+    memcpy(&apr, &s.apr, sizeof(apr));
+    uint64_t h = apr * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint64_t>(s.fee_flat_cents) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    h ^= (static_cast<uint64_t>(static_cast<uint32_t>(s.type)) << 32 | static_cast<uint32_t>(s.audit_capacity)) +
+         0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    return static_cast<size_t>(h);
+}
+
+bool AccountTable::ProfileEq::operator()(const AccountSettings &a, const AccountSettings &b) const
+{
+    return a.type == b.type && memcmp(&a.apr, &b.apr, sizeof(a.apr)) == 0 && a.fee_flat_cents == b.fee_flat_cents &&
+           a.audit_capacity == b.audit_capacity;
+}
+
+void ChangeMarks::resize(size_t rows)
+{
+    if (rows > cap_)
+    {
+        size_t cap = cap_ ? cap_ : 4096;
+        while (cap < rows)
+            cap *= 2;
+        // zeroed; the flags set so far move over
+        unique_ptr<atomic<uint8_t>[]> r(new atomic<uint8_t>[cap]()), p(new atomic<uint8_t>[(cap >> kPageShift) + 1]());
+        for (size_t i = 0; i < rows_n_; ++i)
+            r[i].store(rows_[i].load(memory_order_relaxed), memory_order_relaxed);
+        for (size_t i = 0; i < pages(); ++i)
+            p[i].store(pages_[i].load(memory_order_relaxed), memory_order_relaxed);
+        rows_ = std::move(r);
+        pages_ = std::move(p);
+        cap_ = cap;
+    }
+    rows_n_ = rows;
+}
+
+void ChangeMarks::clear_page(size_t p)
+{
+    pages_[p].store(0, memory_order_relaxed);
+    size_t end = min(rows_n_, (p + 1) << kPageShift);
+    for (size_t r = p << kPageShift; r < end; ++r)
+        rows_[r].store(0, memory_order_relaxed);
+}
+
+AccountTable::AccountTable(std::pmr::memory_resource *audit_mr)
+    : audit_mr_(audit_mr), last_profile_(0), by_type_{0, 0}, track_(false)
+{
+}
+
+void AccountTable::track_changes(bool on)
+{
+    track_ = on;
+    if (on) marks_.resize(rows());
+}
+
+void AccountTable::reserve(size_t rows)
+{
+    balance_.reserve(rows);
+    type_.reserve(rows);
+    profile_.reserve(rows);
+    audit_.reserve(rows);
+}
+
+uint32_t AccountTable::profile_of(const AccountSettings &s)
+{
+    // accounts are usually created in runs with the same settings; the map covers the rest
+    if (last_profile_ < profiles_.size() && ProfileEq()(profiles_[last_profile_], s)) return last_profile_;
+    auto it = profile_ids_.find(s);
+    if (it != profile_ids_.end()) return last_profile_ = it->second;
+    profile_ids_.emplace(s, static_cast<uint32_t>(profiles_.size()));
+    profiles_.push_back(s);
+    return last_profile_ = static_cast<uint32_t>(profiles_.size() - 1);
+}
+
+void AccountTable::add(AccountHandle h, const AccountSettings &settings, long long opening_balance_cents)
+{
+    if (h >= type_.size())
+    {
+        balance_.resize(h + 1, 0);
+        type_.resize(h + 1, kNoAccount);
+        profile_.resize(h + 1, 0);
+        audit_.resize(h + 1, AuditRing<TxEntry>(0, audit_mr_, true));
+        if (track_) marks_.resize(h + 1);
+    }
+    int t = settings.type == AccountType::Checking ? AccountType::Checking : AccountType::Savings;
+    balance_[h] = opening_balance_cents;
+    totals_.by_type[t] += opening_balance_cents;
+    type_[h] = t;
+    profile_[h] = profile_of(settings);
+    // lazy: most rows of a big book record far fewer entries than their capacity
+    audit_[h] = AuditRing<TxEntry>(settings.audit_capacity, audit_mr_, true);
+    ++by_type_[t];
+    mark(h);
+}
+
+void AccountTable::post(AccountHandle h, TxKind kind, long long amount_cents, long long ts, NoteId note, TypeTotals &totals)
+{
+    if (!Calculator::known_kind(kind)) return;
+    const long long delta = Calculator::kind_delta(kind, amount_cents);
+    balance_[h] += delta;
+    // rows that are posted to always have a type, 0 or 1
+    totals.by_type[type_[h]] += delta;
+    mark(h);
+    if (audit_[h].push(TxEntry{amount_cents, ts, h, note, kind})) metrics::add(Counter::AuditEvictions);
+}
+
+void AccountTable::post_interest(AccountHandle h, int days, int basis, long long ts, NoteId note)
+{
+    long long interest_amt = Calculator::interest(balance_[h], settings(h).apr, days, basis);
+    post(h, TxKind::Interest, interest_amt, ts, note, totals_);
+}
+
+void AccountTable::apply(const TxEntry &tx)
+{
+    post(tx.account, tx.kind, tx.amount_cents, tx.timestamp, tx.note, totals_);
+}
+
+void AccountTable::apply(const TxEntry &tx, TypeTotals &totals)
+{
+    post(tx.account, tx.kind, tx.amount_cents, tx.timestamp, tx.note, totals);
+}
+
+void AccountTable::merge_totals(const TypeTotals &t)
+{
+    totals_.by_type[0] += t.by_type[0];
+    totals_.by_type[1] += t.by_type[1];
+}
+
+void AccountTable::apply_by_kind(const TxEntry *txs, size_t n, std::pmr::memory_resource *scratch)
+{
+    const int kinds = Calculator::kTxKinds;
+    // unknown kinds get no bucket: post() ignores them
+    size_t start[kinds + 1] = {};
+    for (size_t i = 0; i < n; ++i)
+        if (Calculator::known_kind(txs[i].kind)) ++start[txs[i].kind + 1];
+    for (int k = 0; k < kinds; ++k)
+        start[k + 1] += start[k];
+    pmr::vector<uint32_t> order(start[kinds], scratch);
+    size_t fill[kinds];
+    copy(start, start + kinds, fill);
+    for (size_t i = 0; i < n; ++i)
+        if (Calculator::known_kind(txs[i].kind)) order[fill[txs[i].kind]++] = static_cast<uint32_t>(i);
+
+    for (int k = 0; k < kinds; ++k)
+    {
+        const uint32_t *run = order.data() + start[k];
+        const size_t len = start[k + 1] - start[k];
+        if (!len) continue;
+        Calculator::with_kind(k, [&](auto traits) {
+            using Kind = decltype(traits);
+            for (size_t j = 0; j < len; ++j)
+            {
+                const TxEntry &tx = txs[run[j]];
+                long long &balance = balance_[tx.account];
+                balance = Kind::post(balance, tx.amount_cents);
+                totals_.by_type[type_[tx.account]] += Kind::sign * tx.amount_cents;
+            }
+        });
+    }
+    for (size_t i = 0; i < n; ++i)
+        apply_audit(txs[i]);
+}
+
+void AccountTable::apply_balance(const TxEntry &tx)
+{
+    // unknown kinds add 0
+    const long long delta = Calculator::kind_delta(tx.kind, tx.amount_cents);
+    balance_[tx.account] += delta;
+    totals_.by_type[type_[tx.account]] += delta;
+    mark(tx.account);
+}
+
+void AccountTable::set_balance(AccountHandle h, long long balance_cents)
+{
+    totals_.by_type[type_[h]] += balance_cents - balance_[h];
+    balance_[h] = balance_cents;
+    mark(h);
+}
+
+void AccountTable::apply_audit(const TxEntry &tx)
+{
+    // post() records only the kinds it applies
+    if (static_cast<unsigned>(tx.kind) > TxKind::TransferOut) return;
+    if (audit_[tx.account].push(tx)) metrics::add(Counter::AuditEvictions);
+    mark(tx.account);
+}
+
+bool AccountTable::charge_monthly_fee(AccountHandle h, long long ts, NoteId note)
+{
+    if (type_[h] != AccountType::Checking) return false;
+    post(h, TxKind::Fee, settings(h).fee_flat_cents, ts, note, totals_);
+    return true;
+}
+
+bool AccountTable::accrue_interest(AccountHandle h, int days, int basis, long long ts, NoteId note)
+{
+    if (type_[h] != AccountType::Savings) return false;
+    post_interest(h, days, basis, ts, note);
+    return true;
+}
+
+template <class DayCount>
+MonthEndRates<DayCount> AccountTable::month_end_rates(long long days, bool interest, bool fees) const
+{
+    // per profile, so the row loop is a gather and a select with no branches
+    MonthEndRates<DayCount> r;
+    r.accrual.resize(profiles_.size());
+    r.fee.resize(profiles_.size());
+    for (size_t p = 0; p < profiles_.size(); ++p)
+    {
+        r.accrual[p] = Calculator::Accrual<DayCount>(interest ? Calculator::rate_from_apr(profiles_[p].apr) : 0, days);
+        r.fee[p] = fees ? profiles_[p].fee_flat_cents : 0;
+    }
+    return r;
+}
+
+template <class DayCount>
+void AccountTable::month_end_deltas(const MonthEndRates<DayCount> &rates, size_t begin, size_t end, long long delta[]) const
+{
+    const Calculator::Accrual<DayCount> *a = rates.accrual.data();
+    const long long *f = rates.fee.data();
+    for (size_t i = begin; i < end; ++i)
+    {
+        uint32_t p = profile_[i];
+        // integer math, so it matches post_interest(days, DayCount::basis) exactly
+        long long in = a[p](balance_[i]);
+        int t = type_[i];
+        delta[i - begin] = t == AccountType::Savings ? in : (t == AccountType::Checking ? -f[p] : 0);
+    }
+}
+
+template MonthEndRates<Calculator::Act365> AccountTable::month_end_rates(long long, bool, bool) const;
+template MonthEndRates<Calculator::Act360> AccountTable::month_end_rates(long long, bool, bool) const;
+template MonthEndRates<Calculator::Thirty360> AccountTable::month_end_rates(long long, bool, bool) const;
+template void AccountTable::month_end_deltas(const MonthEndRates<Calculator::Act365> &, size_t, size_t, long long[]) const;
+template void AccountTable::month_end_deltas(const MonthEndRates<Calculator::Act360> &, size_t, size_t, long long[]) const;
+template void AccountTable::month_end_deltas(const MonthEndRates<Calculator::Thirty360> &, size_t, size_t, long long[]) const;
+
+TypeTotals AccountTable::rescan_totals() const
+{
+    ExposureTotals e = exposure_by_type(balance_.data(), type_.data(), balance_.size());
+    TypeTotals t;
+    t.by_type[0] = e.by_type[0];
+    t.by_type[1] = e.by_type[1];
+    return t;
+}
+
+void AccountTable::restore_audit(AccountHandle h, const TxEntry *entries, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        audit_[h].push(entries[i]);
+    mark(h);
+}
+
+}
@@ -0,0 +1,385 @@
+#include "../include/audit_store.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace p4 {
+
+namespace {
+    const size_t kBlock = 256;      // records per block summary of a resident segment
+    const size_t kColdBlocks = 16; // block summaries kept per spilled or compacted segment
+
+    // spill file: u64 entries, u64 keys, then keys[keys], starts[keys + 1], post[entries],
+    // entries[entries]; block summaries stay in memory
+    const size_t kSpillHeader = 16;
+
+    // "audit-<pid>-<n>-": stores (and processes) sharing a spill directory write, and delete,
+    // only their own files
+    std::string spill_prefix()
+    {
+        static std::atomic<std::uint64_t> instances{0};
+#ifdef _WIN32
+        long long pid = ::_getpid();
+#else
+        long long pid = ::getpid();
+#endif
+        return "audit-" + std::to_string(pid) + "-" + std::to_string(instances.fetch_add(1)) + "-";
+    }
+
+    [[noreturn]] void spill_failed(const std::string &path)
+    {
+        throw std::system_error(std::make_error_code(std::errc::io_error), "audit spill " + path);
+    }
+
+    void add(KindSums &to, const TxEntry &e)
+    {
+        unsigned k = static_cast<unsigned>(e.kind);
+        if (k >= 6) return;
+        to.amount[k] += e.amount_cents;
+        ++to.count[k];
+    }
+
+    void add(KindSums &to, const KindSums &from)
+    {
+        for (int k = 0; k < 6; ++k)
+        {
+            to.amount[k] += from.amount[k];
+            to.count[k] += from.count[k];
+        }
+    }
+
+    // reads n items of T at byte offset `at` of an open spill file
+    template <class T>
+    void read_at(std::ifstream &in, const std::string &path, std::uint64_t at, T *out, size_t n)
+    {
+        in.seekg(static_cast<std::streamoff>(at));
+        in.read(reinterpret_cast<char *>(out), static_cast<std::streamsize>(n * sizeof(T)));
+        if (!in) spill_failed(path);
+    }
+}
+
+struct AuditStore::Segment
+{
+    struct Block
+    {
+        long long min_ts, max_ts;
+        KindSums sums;
+    };
+
+    long long min_ts, max_ts;
+    size_t count;
+    KindSums sums;
+    std::vector<Block> blocks; // over entries, block_records each; coarsened when spilled or compacted
+    size_t block_records = kBlock;
+    // resident only: entries sorted by timestamp (stable); post lists entry positions by
+    // account, ascending, and account keys[k]'s positions are post[starts[k], starts[k + 1])
+    std::vector<TxEntry> entries;
+    std::vector<AccountHandle> keys;
+    std::vector<std::uint32_t> starts;
+    std::vector<std::uint32_t> post;
+    std::string path;                               // spilled only
+    std::uint64_t keys_bytes = 0, starts_bytes = 0; // section sizes in the spill file
+    bool compacted = false;
+
+    // merges runs of neighbouring blocks so at most max_blocks remain
+    void coarsen(size_t max_blocks)
+    {
+        if (blocks.size() <= max_blocks) return;
+        const size_t f = (blocks.size() + max_blocks - 1) / max_blocks;
+        std::vector<Block> out;
+        for (size_t b = 0; b < blocks.size(); b += f)
+        {
+            Block m = blocks[b];
+            for (size_t k = b + 1; k < std::min(blocks.size(), b + f); ++k)
+            {
+                m.min_ts = std::min(m.min_ts, blocks[k].min_ts);
+                m.max_ts = std::max(m.max_ts, blocks[k].max_ts);
+                add(m.sums, blocks[k].sums);
+            }
+            out.push_back(m);
+        }
+        blocks.swap(out);
+        block_records *= f;
+    }
+
+    std::uint64_t post_offset() const { return kSpillHeader + keys_bytes + starts_bytes; }
+    std::uint64_t entries_offset() const { return post_offset() + count * sizeof(std::uint32_t); }
+};
+
+AuditStore::AuditStore(AuditStoreOptions opts) : opts_(opts), first_resident_(0)
+{
+    if (opts_.segment_entries == 0) opts_.segment_entries = 1;
+    if (!opts_.spill_dir.empty())
+    {
+        std::error_code ec;
+        fs::create_directories(opts_.spill_dir, ec);
+        if (ec) throw std::system_error(ec, "audit spill directory " + opts_.spill_dir);
+        spill_prefix_ = spill_prefix();
+    }
+    open_.reserve(opts_.segment_entries);
+}
+
+AuditStore::~AuditStore()
+{
+    for (const auto &s : sealed_)
+    {
+        std::error_code ec;
+        if (!s->path.empty()) fs::remove(s->path, ec);
+    }
+}
+
+void AuditStore::append(const TxEntry *entries, size_t n)
+{
+    // every record goes in before any spill I/O, so a failed spill cannot cut a batch in two
+    stats_.entries += n;
+    while (n)
+    {
+        size_t take = std::min(n, opts_.segment_entries - open_.size());
+        open_.insert(open_.end(), entries, entries + take);
+        entries += take;
+        n -= take;
+        if (open_.size() == opts_.segment_entries) seal_open();
+    }
+    spill_excess();
+}
+
+void AuditStore::seal()
+{
+    seal_open();
+    spill_excess();
+}
+
+void AuditStore::seal_open()
+{
+    if (open_.empty()) return;
+    std::unique_ptr<Segment> s(new Segment());
+    Segment &g = *s;
+    g.count = open_.size();
+    g.entries.swap(open_);
+    try
+    {
+        index_segment(g);
+    }
+    catch (...)
+    {
+        open_.swap(g.entries); // timestamp order now, which the open segment does not mind
+        throw;
+    }
+    sealed_.push_back(std::move(s));
+    ++stats_.segments;
+    open_.reserve(opts_.segment_entries);
+}
+
+void AuditStore::index_segment(Segment &g)
+{
+    // stable: records with equal timestamps stay in append order
+    std::stable_sort(g.entries.begin(), g.entries.end(),
+                     [](const TxEntry &a, const TxEntry &b) { return a.timestamp < b.timestamp; });
+    g.min_ts = g.entries.front().timestamp;
+    g.max_ts = g.entries.back().timestamp;
+    for (size_t b = 0; b < g.count; b += kBlock)
+    {
+        Segment::Block blk{g.entries[b].timestamp, g.entries[std::min(g.count, b + kBlock) - 1].timestamp, KindSums()};
+        for (size_t i = b; i < std::min(g.count, b + kBlock); ++i)
+            add(blk.sums, g.entries[i]);
+        add(g.sums, blk.sums);
+        g.blocks.push_back(blk);
+    }
+    // posting lists: positions sorted by account, then position (so by timestamp)
+    g.post.resize(g.count);
+    for (size_t i = 0; i < g.count; ++i)
+        g.post[i] = static_cast<std::uint32_t>(i);
+    const TxEntry *e = g.entries.data();
+    std::sort(g.post.begin(), g.post.end(), [e](std::uint32_t a, std::uint32_t b) {
+        return e[a].account != e[b].account ? e[a].account < e[b].account : a < b;
+    });
+    for (size_t i = 0; i < g.count; ++i)
+    {
+        if (i == 0 || e[g.post[i]].account != e[g.post[i - 1]].account)
+        {
+            g.keys.push_back(e[g.post[i]].account);
+            g.starts.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+    g.starts.push_back(static_cast<std::uint32_t>(g.count));
+}
+
+void AuditStore::spill_excess()
+{
+    while (opts_.resident_segments && sealed_.size() - first_resident_ > opts_.resident_segments)
+        spill_or_compact();
+}
+
+void AuditStore::spill_or_compact()
+{
+    Segment &s = *sealed_[first_resident_];
+    if (opts_.spill_dir.empty())
+    {
+        s.compacted = true;
+        ++stats_.compacted_segments;
+        stats_.compacted_entries += s.count;
+    }
+    else
+    {
+        // the segment changes only once its file is whole: a failed write leaves it resident,
+        // to be spilled by the next seal
+        std::string path =
+            (fs::path(opts_.spill_dir) / (spill_prefix_ + std::to_string(first_resident_) + ".seg")).string();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        std::uint64_t head[2] = {s.count, s.keys.size()};
+        out.write(reinterpret_cast<const char *>(head), sizeof(head));
+        out.write(reinterpret_cast<const char *>(s.keys.data()), static_cast<std::streamsize>(s.keys.size() * sizeof(AccountHandle)));
+        out.write(reinterpret_cast<const char *>(s.starts.data()), static_cast<std::streamsize>(s.starts.size() * sizeof(std::uint32_t)));
+        out.write(reinterpret_cast<const char *>(s.post.data()), static_cast<std::streamsize>(s.count * sizeof(std::uint32_t)));
+        out.write(reinterpret_cast<const char *>(s.entries.data()), static_cast<std::streamsize>(s.count * sizeof(TxEntry)));
+        out.close();
+        if (!out)
+        {
+            std::error_code ec;
+            fs::remove(path, ec);
+            spill_failed(path);
+        }
+        s.path = path;
+        s.keys_bytes = s.keys.size() * sizeof(AccountHandle);
+        s.starts_bytes = s.starts.size() * sizeof(std::uint32_t);
+        ++stats_.spilled_segments;
+    }
+    ++first_resident_;
+    // the summaries stay, coarser: they still answer kind_totals for the blocks a window covers
+    s.coarsen(kColdBlocks);
+    std::vector<TxEntry>().swap(s.entries);
+    std::vector<AccountHandle>().swap(s.keys);
+    std::vector<std::uint32_t>().swap(s.starts);
+    std::vector<std::uint32_t>().swap(s.post);
+    if (!s.compacted) return;
+    while (opts_.compacted_summaries && first_resident_ > opts_.compacted_summaries)
+        merge_compacted(); // may free s
+}
+
+void AuditStore::merge_compacted()
+{
+    // the neighbouring pair with the fewest records, so history loses time resolution evenly
+    size_t best = 0;
+    for (size_t i = 1; i + 1 < first_resident_; ++i)
+        if (sealed_[i]->count + sealed_[i + 1]->count < sealed_[best]->count + sealed_[best + 1]->count) best = i;
+    Segment &a = *sealed_[best];
+    const Segment &b = *sealed_[best + 1];
+    a.min_ts = std::min(a.min_ts, b.min_ts);
+    a.max_ts = std::max(a.max_ts, b.max_ts);
+    a.count += b.count;
+    add(a.sums, b.sums);
+    a.blocks.insert(a.blocks.end(), b.blocks.begin(), b.blocks.end());
+    a.coarsen(kColdBlocks);
+    sealed_.erase(sealed_.begin() + static_cast<std::ptrdiff_t>(best + 1));
+    --first_resident_;
+}
+
+size_t AuditStore::account_between(AccountHandle h, long long from, long long to, std::vector<TxEntry> &out) const
+{
+    const size_t first = out.size();
+    std::vector<AccountHandle> keys;
+    std::vector<std::uint32_t> positions;
+    for (const auto &sp : sealed_)
+    {
+        const Segment &s = *sp;
+        if (s.compacted || s.max_ts < from || s.min_ts > to) continue;
+        if (s.path.empty())
+        {
+            auto it = std::lower_bound(s.keys.begin(), s.keys.end(), h);
+            if (it == s.keys.end() || *it != h) continue;
+            size_t r = static_cast<size_t>(it - s.keys.begin());
+            const std::uint32_t *b = s.post.data() + s.starts[r], *e = s.post.data() + s.starts[r + 1];
+            const TxEntry *en = s.entries.data();
+            b = std::lower_bound(b, e, from, [en](std::uint32_t p, long long t) { return en[p].timestamp < t; });
+            for (; b != e && en[*b].timestamp <= to; ++b)
+                out.push_back(en[*b]);
+            continue;
+        }
+        // spilled: the key directory, then the account's positions, then its records in the window
+        std::ifstream in(s.path, std::ios::binary);
+        keys.resize(s.keys_bytes / sizeof(AccountHandle));
+        read_at(in, s.path, kSpillHeader, keys.data(), keys.size());
+        auto it = std::lower_bound(keys.begin(), keys.end(), h);
+        if (it == keys.end() || *it != h) continue;
+        std::uint32_t range[2];
+        read_at(in, s.path, kSpillHeader + s.keys_bytes + (it - keys.begin()) * sizeof(std::uint32_t), range, 2);
+        positions.resize(range[1] - range[0]);
+        read_at(in, s.path, s.post_offset() + range[0] * sizeof(std::uint32_t), positions.data(), positions.size());
+        for (std::uint32_t p : positions)
+        {
+            TxEntry x;
+            read_at(in, s.path, s.entries_offset() + p * sizeof(TxEntry), &x, 1);
+            if (x.timestamp > to) break;
+            if (x.timestamp >= from) out.push_back(x);
+        }
+    }
+    for (const TxEntry &x : open_)
+        if (x.account == h && x.timestamp >= from && x.timestamp <= to) out.push_back(x);
+    // segments overlap in time when timestamps arrive out of order; stable keeps append order
+    auto earlier = [](const TxEntry &a, const TxEntry &b) { return a.timestamp < b.timestamp; };
+    auto b = out.begin() + static_cast<std::ptrdiff_t>(first);
+    if (!std::is_sorted(b, out.end(), earlier)) std::stable_sort(b, out.end(), earlier);
+    return out.size() - first;
+}
+
+KindSums AuditStore::kind_totals(long long from, long long to, bool *exact) const
+{
+    KindSums sums;
+    bool all = true;
+    std::vector<TxEntry> edge;
+    for (const auto &sp : sealed_)
+    {
+        const Segment &s = *sp;
+        if (s.max_ts < from || s.min_ts > to) continue;
+        if (s.min_ts >= from && s.max_ts <= to)
+        {
+            add(sums, s.sums);
+            continue;
+        }
+        // blocks are in timestamp order: whole ones from their sums, the edge ones record by record
+        std::ifstream in;
+        for (size_t k = 0; k < s.blocks.size(); ++k)
+        {
+            const Segment::Block &blk = s.blocks[k];
+            if (blk.max_ts < from || blk.min_ts > to) continue;
+            if (blk.min_ts >= from && blk.max_ts <= to)
+            {
+                add(sums, blk.sums);
+                continue;
+            }
+            const size_t b = k * s.block_records, n = std::min(s.count, b + s.block_records) - b;
+            const TxEntry *e;
+            if (s.compacted)
+            {
+                all = false;
+                continue;
+            }
+            if (s.path.empty())
+                e = s.entries.data() + b;
+            else
+            {
+                if (!in.is_open()) in.open(s.path, std::ios::binary);
+                edge.resize(n);
+                read_at(in, s.path, s.entries_offset() + b * sizeof(TxEntry), edge.data(), n);
+                e = edge.data();
+            }
+            for (size_t i = 0; i < n; ++i)
+                if (e[i].timestamp >= from && e[i].timestamp <= to) add(sums, e[i]);
+        }
+    }
+    for (const TxEntry &e : open_)
+        if (e.timestamp >= from && e.timestamp <= to) add(sums, e);
+    if (exact) *exact = all;
+    return sums;
+}
+
+}
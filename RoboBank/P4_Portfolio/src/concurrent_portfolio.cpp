@@ -0,0 +1,164 @@
+#include "../include/concurrent_portfolio.h"
+
+using namespace std;
+
+ConcurrentPortfolio::ConcurrentPortfolio(size_t max_accounts, size_t lock_stripes)
+    : slots_(max_accounts + 1), balances_(new PaddedBalance[max_accounts + 1]), published_(0),
+      stripes_(lock_stripes ? lock_stripes : 1), exposure_(0)
+{
+    by_type_[0].store(0, memory_order_relaxed);
+    by_type_[1].store(0, memory_order_relaxed);
+}
+
+size_t ConcurrentPortfolio::capacity() const { return slots_.size() - 1; }
+
+size_t ConcurrentPortfolio::count() const
+{
+    // handle 0 is the pool's empty string and never holds an account
+    size_t n = published_.load(memory_order_acquire);
+    return n ? n - 1 : 0;
+}
+
+bool ConcurrentPortfolio::add_account(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents)
+{
+    if (id.empty()) return false;
+    unique_lock<shared_mutex> lock(dir_mu_);
+    if (ids_.find(id) != p4::StringPool::npos) return false;
+    if (ids_.size() >= slots_.size()) return false; // table full
+
+    p4::AccountHandle h = ids_.intern(id);
+    if (settings.type == AccountType::Checking)
+        slots_[h] = make_unique<CheckingAccount>(id, settings, opening_balance_cents, &notes_, h);
+    else
+        slots_[h] = make_unique<SavingsAccount>(id, settings, opening_balance_cents, &notes_, h);
+    balances_[h].cents.store(opening_balance_cents, memory_order_relaxed);
+    exposure_.fetch_add(opening_balance_cents, memory_order_relaxed);
+    by_type_[settings.type != AccountType::Checking].fetch_add(opening_balance_cents, memory_order_relaxed);
+    published_.store(h + 1, memory_order_release);
+    return true;
+}
+
+p4::AccountHandle ConcurrentPortfolio::handle_of(string_view id) const
+{
+    if (id.empty()) return p4::StringPool::npos;
+    shared_lock<shared_mutex> lock(dir_mu_);
+    return ids_.find(id);
+}
+
+p4::NoteId ConcurrentPortfolio::intern_note(string_view note)
+{
+    unique_lock<shared_mutex> lock(notes_mu_);
+    return notes_.intern(note);
+}
+
+// Caller holds the account's stripe; returns the balance change
+long long ConcurrentPortfolio::post_locked(const p4::TxEntry &tx)
+{
+    BaseAccount &acc = *slots_[tx.account];
+    long long before = acc.balance_cents();
+    acc.apply(tx);
+    long long after = acc.balance_cents();
+    balances_[tx.account].cents.store(after, memory_order_relaxed);
+    return after - before;
+}
+
+bool ConcurrentPortfolio::apply(const p4::TxEntry &tx)
+{
+    if (tx.account == 0 || tx.account >= published_.load(memory_order_acquire)) return false;
+    lock_guard<mutex> lock(stripe_of(tx.account).mu);
+    long long delta = post_locked(tx);
+    if (delta)
+    {
+        exposure_.fetch_add(delta, memory_order_relaxed);
+        by_type_[slots_[tx.account]->type() == AccountType::Savings].fetch_add(delta, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool ConcurrentPortfolio::apply(const p4::TxRecord &tx)
+{
+    p4::AccountHandle h = handle_of(tx.account_id);
+    if (h == p4::StringPool::npos) return false;
+    return apply(p4::TxEntry{tx.amount_cents, tx.timestamp, h, intern_note(tx.note), tx.kind});
+}
+
+void ConcurrentPortfolio::set_policy(const p4::TxPolicy &policy) { policy_ = policy; }
+const p4::TxPolicy &ConcurrentPortfolio::policy() const { return policy_; }
+
+bool ConcurrentPortfolio::transfer(p4::AccountHandle from, p4::AccountHandle to, long long amount_cents, long long ts,
+                                   p4::NoteId note, p4::RejectReason *reason)
+{
+    size_t n = published_.load(memory_order_acquire);
+    p4::RejectReason r = p4::RejectReason::MissingAccount;
+    if (from != 0 && to != 0 && from < n && to < n) r = policy_.check_amount(p4::TxKind::TransferOut, amount_cents);
+    if (reason) *reason = r;
+    if (r != p4::RejectReason::None) return false;
+
+    // lock both stripes in ascending order; a self-transfer or shared stripe locks once
+    size_t a = from % stripes_.size();
+    size_t b = to % stripes_.size();
+    unique_lock<mutex> first(stripes_[a < b ? a : b].mu);
+    unique_lock<mutex> second;
+    if (a != b) second = unique_lock<mutex>(stripes_[a < b ? b : a].mu);
+
+    // as Portfolio::transfer: the out leg against the source balance, the in leg against the
+    // destination's after it; both are checked before either posts
+    const BaseAccount &src = *slots_[from], &dst = *slots_[to];
+    long long src_after = src.balance_cents() - amount_cents;
+    r = policy_.check_account(static_cast<int>(src.type()), src.balance_cents(), p4::TxKind::TransferOut, amount_cents);
+    if (r == p4::RejectReason::None)
+        r = policy_.check_account(static_cast<int>(dst.type()), from == to ? src_after : dst.balance_cents(),
+                                  p4::TxKind::TransferIn, amount_cents);
+    if (reason) *reason = r;
+    if (r != p4::RejectReason::None) return false;
+
+    long long out = post_locked(p4::TxEntry{amount_cents, ts, from, note, p4::TxKind::TransferOut});
+    long long in = post_locked(p4::TxEntry{amount_cents, ts, to, note, p4::TxKind::TransferIn});
+    // a transfer nets to zero, so the running total never shows one leg alone
+    if (out + in) exposure_.fetch_add(out + in, memory_order_relaxed);
+    int tf = slots_[from]->type() == AccountType::Savings, tt = slots_[to]->type() == AccountType::Savings;
+    if (tf == tt)
+    {
+        if (out + in) by_type_[tf].fetch_add(out + in, memory_order_relaxed);
+    }
+    else
+    {
+        by_type_[tf].fetch_add(out, memory_order_relaxed);
+        by_type_[tt].fetch_add(in, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool ConcurrentPortfolio::transfer(const p4::TransferRecord &tr, p4::RejectReason *reason)
+{
+    p4::AccountHandle from = handle_of(tr.from_id);
+    p4::AccountHandle to = handle_of(tr.to_id);
+    if (from == p4::StringPool::npos || to == p4::StringPool::npos)
+    {
+        if (reason) *reason = p4::RejectReason::MissingAccount;
+        return false;
+    }
+    return transfer(from, to, tr.amount_cents, tr.timestamp, intern_note(tr.note), reason);
+}
+
+long long ConcurrentPortfolio::balance_of(p4::AccountHandle h) const
+{
+    if (h >= published_.load(memory_order_acquire)) return 0;
+    return balances_[h].cents.load(memory_order_relaxed);
+}
+
+long long ConcurrentPortfolio::balance_of(const string &id) const
+{
+    p4::AccountHandle h = handle_of(id);
+    return (h == p4::StringPool::npos) ? 0 : balance_of(h);
+}
+
+long long ConcurrentPortfolio::total_exposure() const
+{
+    return exposure_.load(memory_order_relaxed);
+}
+
+long long ConcurrentPortfolio::total_of(AccountType t) const
+{
+    return by_type_[t == AccountType::Savings].load(memory_order_relaxed);
+}
@@ -0,0 +1,346 @@
+#include "../include/ingest.h"
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "../include/portfolio.h"
+
+using namespace std;
+
+namespace p4 {
+
+namespace {
+    const uint32_t kBinaryMagic = 0x58544252u; // "RBTX"
+    const uint32_t kBinaryVersion = 1;
+    const size_t kRecordHeader = 21; // amount, timestamp, kind, id length, note length
+
+    // One unit of work; a fixed set of these cycles read -> parse -> apply -> read, which is
+    // what bounds the pipeline's memory.
+    struct Chunk
+    {
+        vector<char> data;
+        size_t size = 0;
+        vector<TxView> txs;  // views into data
+        vector<IngestReject> rejects;
+        uint64_t records = 0;
+    };
+
+    class ChunkQueue
+    {
+    public:
+        void push(Chunk *c)
+        {
+            {
+                lock_guard<mutex> lock(mu_);
+                q_.push_back(c);
+            }
+            cv_.notify_one();
+        }
+        // null once the queue is closed and drained
+        Chunk *pop()
+        {
+            unique_lock<mutex> lock(mu_);
+            cv_.wait(lock, [&] { return !q_.empty() || closed_; });
+            if (q_.empty()) return nullptr;
+            Chunk *c = q_.front();
+            q_.pop_front();
+            return c;
+        }
+        void close()
+        {
+            {
+                lock_guard<mutex> lock(mu_);
+                closed_ = true;
+            }
+            cv_.notify_all();
+        }
+
+    private:
+        mutex mu_;
+        condition_variable cv_;
+        deque<Chunk *> q_;
+        bool closed_ = false;
+    };
+
+    template <class T>
+    bool parse_int(string_view s, T &v)
+    {
+        auto r = from_chars(s.data(), s.data() + s.size(), v);
+        return r.ec == errc() && r.ptr == s.data() + s.size();
+    }
+
+    // length of the complete lines/records at the start of [p, p + n)
+    size_t complete_prefix(IngestFormat fmt, const char *p, size_t n)
+    {
+        if (fmt == IngestFormat::Csv)
+        {
+            for (size_t i = n; i > 0; --i)
+                if (p[i - 1] == '\n') return i;
+            return 0;
+        }
+        size_t at = 0;
+        while (n - at >= kRecordHeader)
+        {
+            uint16_t id_len, note_len;
+            memcpy(&id_len, p + at + 17, 2);
+            memcpy(&note_len, p + at + 19, 2);
+            size_t rec = kRecordHeader + id_len + note_len;
+            if (n - at < rec) break;
+            at += rec;
+        }
+        return at;
+    }
+
+    void reject(Chunk &c, uint64_t line, IngestStatus status)
+    {
+        c.rejects.push_back(IngestReject{line, status});
+    }
+
+    // validate stage: a well-formed record can still be refused
+    bool validate(Chunk &c, uint64_t line, const TxView &tx)
+    {
+        IngestStatus st = IngestStatus::Applied;
+        if (static_cast<int>(tx.kind) < 0 || static_cast<int>(tx.kind) > TxKind::TransferOut)
+            st = IngestStatus::UnknownKind;
+        else if (tx.amount_cents < 0)
+            st = IngestStatus::NegativeAmount;
+        else if (tx.account_id.empty())
+            st = IngestStatus::MissingId;
+        if (st == IngestStatus::Applied) return true;
+        reject(c, line, st);
+        return false;
+    }
+
+    void parse_csv(Chunk &c, uint64_t &line)
+    {
+        const char *p = c.data.data();
+        const char *end = p + c.size;
+        while (p < end)
+        {
+            const char *eol = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!eol) eol = end;
+            string_view l(p, static_cast<size_t>(eol - p));
+            p = eol + 1;
+            ++line;
+            if (!l.empty() && l.back() == '\r') l.remove_suffix(1);
+            if (l.empty() || l[0] == '#' || (line == 1 && l.compare(0, 10, "account_id") == 0)) continue;
+
+            ++c.records;
+            string_view f[4];
+            size_t start = 0;
+            bool ok = true;
+            for (int i = 0; i < 4 && ok; ++i)
+            {
+                size_t comma = l.find(',', start);
+                if (comma == string_view::npos && i < 3)
+                    ok = false;
+                else
+                {
+                    f[i] = l.substr(start, comma == string_view::npos ? string_view::npos : comma - start);
+                    start = comma == string_view::npos ? l.size() : comma + 1;
+                }
+            }
+            int kind = 0;
+            TxView tx;
+            if (ok) ok = parse_int(f[1], kind) && parse_int(f[2], tx.amount_cents) && parse_int(f[3], tx.timestamp);
+            if (!ok)
+            {
+                reject(c, line, IngestStatus::Malformed);
+                continue;
+            }
+            tx.kind = static_cast<TxKind>(kind);
+            tx.account_id = f[0];
+            tx.note = start < l.size() ? l.substr(start) : string_view();
+            if (validate(c, line, tx)) c.txs.push_back(tx);
+        }
+    }
+
+    void parse_binary(Chunk &c, uint64_t &record)
+    {
+        const char *p = c.data.data();
+        size_t n = c.size, at = 0;
+        while (at < n)
+        {
+            ++record;
+            ++c.records;
+            uint16_t id_len = 0, note_len = 0;
+            if (n - at >= kRecordHeader)
+            {
+                memcpy(&id_len, p + at + 17, 2);
+                memcpy(&note_len, p + at + 19, 2);
+            }
+            if (n - at < kRecordHeader || n - at < kRecordHeader + id_len + note_len)
+            {
+                reject(c, record, IngestStatus::Malformed); // truncated file
+                return;
+            }
+            TxView tx;
+            int64_t amount, ts;
+            memcpy(&amount, p + at, 8);
+            memcpy(&ts, p + at + 8, 8);
+            tx.amount_cents = amount;
+            tx.timestamp = ts;
+            tx.kind = static_cast<TxKind>(static_cast<unsigned char>(p[at + 16]));
+            tx.account_id = string_view(p + at + kRecordHeader, id_len);
+            tx.note = string_view(p + at + kRecordHeader + id_len, note_len);
+            at += kRecordHeader + id_len + note_len;
+            if (validate(c, record, tx)) c.txs.push_back(tx);
+        }
+    }
+}
+
+BinaryTxWriter::BinaryTxWriter(const string &path) : out_(path, ios::binary | ios::trunc)
+{
+    out_.write(reinterpret_cast<const char *>(&kBinaryMagic), 4);
+    out_.write(reinterpret_cast<const char *>(&kBinaryVersion), 4);
+}
+
+bool BinaryTxWriter::ok() const { return static_cast<bool>(out_); }
+
+bool BinaryTxWriter::write(const TxView &tx)
+{
+    if (tx.account_id.size() > 0xFFFF || tx.note.size() > 0xFFFF) return false;
+    char h[kRecordHeader];
+    int64_t amount = tx.amount_cents, ts = tx.timestamp;
+    uint16_t id_len = static_cast<uint16_t>(tx.account_id.size()), note_len = static_cast<uint16_t>(tx.note.size());
+    memcpy(h, &amount, 8);
+    memcpy(h + 8, &ts, 8);
+    h[16] = static_cast<char>(tx.kind);
+    memcpy(h + 17, &id_len, 2);
+    memcpy(h + 19, &note_len, 2);
+    out_.write(h, sizeof(h));
+    out_.write(tx.account_id.data(), id_len);
+    out_.write(tx.note.data(), note_len);
+    return static_cast<bool>(out_);
+}
+
+bool BinaryTxWriter::write(const TxRecord &tx)
+{
+    return write(TxView{tx.kind, tx.amount_cents, tx.timestamp, tx.note, tx.account_id});
+}
+
+bool BinaryTxWriter::close()
+{
+    out_.close();
+    return static_cast<bool>(out_);
+}
+
+}
+
+p4::IngestReport Portfolio::ingest_file(const string &path, p4::IngestFormat fmt, const p4::IngestOptions &opts)
+{
+    p4::IngestReport report;
+    ifstream in(path, ios::binary);
+    if (!in) return report;
+    if (fmt == p4::IngestFormat::Binary)
+    {
+        uint32_t header[2] = {0, 0};
+        in.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!in || header[0] != p4::kBinaryMagic || header[1] != p4::kBinaryVersion) return report;
+        report.bytes += sizeof(header);
+    }
+    report.opened = true;
+
+    const size_t chunk_bytes = opts.chunk_bytes ? opts.chunk_bytes : 1;
+    vector<unique_ptr<p4::Chunk>> pool;
+    p4::ChunkQueue free_q, parse_q, apply_q;
+    for (size_t i = 0; i < (opts.chunks_in_flight ? opts.chunks_in_flight : 1); ++i)
+    {
+        pool.push_back(make_unique<p4::Chunk>());
+        free_q.push(pool.back().get());
+    }
+
+    // read stage: fill a chunk, keep the partial last line for the next one
+    uint64_t bytes_read = 0;
+    thread reader([&] {
+        vector<char> carry;
+        bool eof = false;
+        while (!eof)
+        {
+            p4::Chunk *c = free_q.pop();
+            if (!c) break; // apply stage failed
+            size_t want = carry.size() + chunk_bytes;
+            if (c->data.size() < want) c->data.resize(want);
+            memcpy(c->data.data(), carry.data(), carry.size());
+            in.read(c->data.data() + carry.size(), static_cast<streamsize>(chunk_bytes));
+            size_t got = static_cast<size_t>(in.gcount());
+            bytes_read += got;
+            size_t filled = carry.size() + got;
+            eof = got < chunk_bytes;
+            size_t cut = eof ? filled : p4::complete_prefix(fmt, c->data.data(), filled);
+            carry.assign(c->data.data() + cut, c->data.data() + filled);
+            c->size = cut;
+            parse_q.push(c);
+        }
+        parse_q.close();
+    });
+
+    // parse + validate stage; one thread so line numbers and order follow the file
+    thread parser([&] {
+        uint64_t line = 0;
+        for (p4::Chunk *c = parse_q.pop(); c; c = parse_q.pop())
+        {
+            c->txs.clear();
+            c->rejects.clear();
+            c->records = 0;
+            if (fmt == p4::IngestFormat::Csv)
+                p4::parse_csv(*c, line);
+            else
+                p4::parse_binary(*c, line);
+            if (!opts.keep_notes)
+                for (p4::TxView &tx : c->txs)
+                    tx.note = string_view();
+            apply_q.push(c);
+        }
+        apply_q.close();
+    });
+
+    // apply stage on the calling thread: Portfolio itself is single-threaded
+    vector<p4::TxEntry> scratch;
+    exception_ptr failed;
+    try
+    {
+        for (p4::Chunk *c = apply_q.pop(); c; c = apply_q.pop())
+        {
+            vector<p4::TxEntry> &out = opts.portfolio_audit ? audit_ : scratch;
+            if (!opts.portfolio_audit) scratch.clear();
+            size_t first = out.size();
+            resolve(c->txs.data(), c->txs.size(), opts.auto_create, out);
+            apply_entries(out.data() + first, out.size() - first, mem_.upstream);
+            size_t applied = out.size() - first;
+            p4::metrics::add_batch(applied);
+            end_operation(); // each chunk is an operation
+
+            report.records += c->records;
+            report.applied += applied;
+            report.skipped_missing += c->txs.size() - applied;
+            for (const p4::IngestReject &r : c->rejects)
+            {
+                switch (r.status)
+                {
+                case p4::IngestStatus::Malformed: ++report.malformed; break;
+                case p4::IngestStatus::UnknownKind: ++report.unknown_kind; break;
+                case p4::IngestStatus::NegativeAmount: ++report.negative_amount; break;
+                case p4::IngestStatus::MissingId: ++report.missing_id; break;
+                default: break;
+                }
+                if (report.rejects.size() < opts.max_rejects) report.rejects.push_back(r);
+            }
+            free_q.push(c);
+        }
+    }
+    catch (...)
+    {
+        failed = current_exception(); // e.g. a journal write error
+        free_q.close();
+    }
+    reader.join();
+    parser.join();
+    if (failed) rethrow_exception(failed);
+    report.bytes += bytes_read;
+    return report;
+}
@@ -0,0 +1,573 @@
+#include "../include/journal.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include "../include/crc32.h"
+#include "../include/portfolio.h"
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace p4 {
+
+namespace {
+    const uint32_t kJournalMagic = 0x4E4A4252u;  // "RBJN"
+    const uint32_t kSnapshotMagic = 0x4E534252u; // "RBSN"
+    const uint32_t kVersion = 1;
+    const size_t kFrameHeader = 8;   // u32 payload length, u32 crc of payload
+    const size_t kSegmentHeader = 16; // magic, version, u64 seq
+    const size_t kEntryBytes = 25;   // amount, timestamp, account, note, kind
+    const size_t npos = static_cast<size_t>(-1);
+
+    // record tags inside a frame payload
+    const char kAccountRec = 'A';
+    const char kNoteRec = 'N';
+    const char kEntriesRec = 'E';
+
+    [[noreturn]] void fail(const std::string &what)
+    {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    [[noreturn]] void corrupt(const std::string &path)
+    {
+        throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "journal corrupt " + path);
+    }
+
+    int open_append(const std::string &path)
+    {
+#ifdef _WIN32
+        return ::_open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+        return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+    }
+
+    void write_all(int fd, const char *p, size_t n, const std::string &path)
+    {
+        while (n > 0)
+        {
+#ifdef _WIN32
+            int w = ::_write(fd, p, static_cast<unsigned>(std::min<size_t>(n, 1u << 30)));
+#else
+            ssize_t w = ::write(fd, p, n);
+#endif
+            if (w < 0)
+            {
+                if (errno == EINTR) continue;
+                fail("journal write " + path);
+            }
+            p += w;
+            n -= static_cast<size_t>(w);
+        }
+    }
+
+    void flush_fd(int fd, const std::string &path)
+    {
+#ifdef _WIN32
+        if (::_commit(fd) != 0) fail("journal fsync " + path);
+#else
+        if (::fsync(fd) != 0) fail("journal fsync " + path);
+#endif
+    }
+
+    // cuts the file back to `size` and moves the write position there
+    bool truncate_fd(int fd, uint64_t size)
+    {
+#ifdef _WIN32
+        return ::_chsize_s(fd, static_cast<long long>(size)) == 0 &&
+               ::_lseeki64(fd, static_cast<long long>(size), SEEK_SET) >= 0;
+#else
+        return ::ftruncate(fd, static_cast<off_t>(size)) == 0 &&
+               ::lseek(fd, static_cast<off_t>(size), SEEK_SET) >= 0;
+#endif
+    }
+
+    void close_fd(int fd)
+    {
+#ifdef _WIN32
+        ::_close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+
+    // makes a create/rename/unlink in `dir` durable; a no-op where directories cannot be opened
+    void sync_dir(const std::string &dir)
+    {
+#ifndef _WIN32
+        int fd = ::open(dir.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        ::fsync(fd);
+        ::close(fd);
+#else
+        (void)dir;
+#endif
+    }
+
+    template <class T>
+    void put(std::vector<char> &buf, const T &v)
+    {
+        size_t at = buf.size();
+        buf.resize(at + sizeof(T));
+        std::memcpy(buf.data() + at, &v, sizeof(T));
+    }
+
+    void put_bytes(std::vector<char> &buf, std::string_view s)
+    {
+        put(buf, static_cast<uint32_t>(s.size()));
+        buf.insert(buf.end(), s.begin(), s.end());
+    }
+
+    void put_settings(std::vector<char> &buf, const AccountSettings &s)
+    {
+        put(buf, static_cast<int32_t>(s.type));
+        put(buf, s.apr);
+        put(buf, static_cast<int64_t>(s.fee_flat_cents));
+        put(buf, static_cast<int32_t>(s.audit_capacity));
+    }
+
+    // bounds-checked reader over one frame payload or snapshot body
+    class Reader
+    {
+    public:
+        Reader(const char *p, size_t n) : p_(p), end_(p + n) {}
+        bool done() const { return p_ == end_; }
+
+        template <class T>
+        bool get(T &v)
+        {
+            if (static_cast<size_t>(end_ - p_) < sizeof(T)) return false;
+            std::memcpy(&v, p_, sizeof(T));
+            p_ += sizeof(T);
+            return true;
+        }
+
+        bool get_bytes(std::string_view &s)
+        {
+            uint32_t n;
+            if (!get(n) || static_cast<size_t>(end_ - p_) < n) return false;
+            s = std::string_view(p_, n);
+            p_ += n;
+            return true;
+        }
+
+        bool get_settings(AccountSettings &s)
+        {
+            int32_t type, cap;
+            int64_t fee;
+            if (!get(type) || !get(s.apr) || !get(fee) || !get(cap)) return false;
+            s.type = type;
+            s.fee_flat_cents = fee;
+            s.audit_capacity = cap;
+            return true;
+        }
+
+    private:
+        const char *p_;
+        const char *end_;
+    };
+
+    bool read_file(const std::string &path, std::vector<char> &out)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // "journal.12" -> 12; false for other names, including "snapshot.12.tmp"
+    bool parse_name(const std::string &name, const char *kind, uint64_t &seq)
+    {
+        size_t k = std::strlen(kind);
+        if (name.size() <= k + 1 || name.compare(0, k, kind) != 0 || name[k] != '.') return false;
+        seq = 0;
+        for (size_t i = k + 1; i < name.size(); ++i)
+        {
+            if (name[i] < '0' || name[i] > '9') return false;
+            seq = seq * 10 + static_cast<uint64_t>(name[i] - '0');
+        }
+        return true;
+    }
+}
+
+Journal::Journal(const std::string &dir, JournalOptions opts)
+    : dir_(dir), opts_(opts), fd_(-1), seq_(0), frame_start_(npos), last_frame_(npos), frame_entries_(0),
+      segment_bytes_(0)
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec) throw std::system_error(ec, "journal directory " + dir_);
+    buf_.reserve(opts_.group_commit_bytes + 4096);
+}
+
+Journal::~Journal()
+{
+    if (fd_ < 0) return;
+    try
+    {
+        sync();
+    }
+    catch (...)
+    {
+        // nothing to report to from a destructor; unsynced frames are lost as in a crash
+    }
+    close_fd(fd_);
+}
+
+const JournalStats &Journal::stats() const { return stats_; }
+
+std::string Journal::path_of(const char *kind, uint64_t seq) const
+{
+    return (fs::path(dir_) / (std::string(kind) + "." + std::to_string(seq))).string();
+}
+
+void Journal::open_segment(uint64_t seq)
+{
+    if (fd_ >= 0) close_fd(fd_);
+    std::string path = path_of("journal", seq);
+    fd_ = open_append(path);
+    if (fd_ < 0) fail("journal open " + path);
+    seq_ = seq;
+    segment_bytes_ = 0;
+    note_defined_.clear();
+
+    char header[kSegmentHeader];
+    std::memcpy(header, &kJournalMagic, 4);
+    std::memcpy(header + 4, &kVersion, 4);
+    std::memcpy(header + 8, &seq, 8);
+    write_all(fd_, header, sizeof(header), path);
+    if (opts_.fsync) flush_fd(fd_, path);
+    sync_dir(dir_);
+}
+
+void Journal::begin_frame(const Portfolio &p)
+{
+    // from here on abort_frame concerns this operation's frame only
+    last_frame_ = npos;
+    frame_notes_.clear();
+    frame_entries_ = 0;
+    if (opts_.snapshot_every_bytes && segment_bytes_ + buf_.size() >= opts_.snapshot_every_bytes)
+        snapshot(p);
+    frame_start_ = buf_.size();
+    buf_.resize(frame_start_ + kFrameHeader); // patched in end_frame
+}
+
+void Journal::log_account(AccountHandle h, std::string_view id, const AccountSettings &settings, long long opening_balance_cents)
+{
+    buf_.push_back(kAccountRec);
+    put(buf_, h);
+    put_bytes(buf_, id);
+    put_settings(buf_, settings);
+    put(buf_, static_cast<int64_t>(opening_balance_cents));
+}
+
+void Journal::log_entries(const Portfolio &p, const TxEntry *entries, size_t n)
+{
+    if (n == 0) return;
+    // define each note the first time this segment uses it, so a segment replays on its own
+    for (size_t i = 0; i < n; ++i)
+    {
+        NoteId note = entries[i].note;
+        if (note < note_defined_.size() && note_defined_[note]) continue;
+        if (note >= note_defined_.size()) note_defined_.resize(note + 1, false);
+        note_defined_[note] = true;
+        frame_notes_.push_back(note);
+        buf_.push_back(kNoteRec);
+        put(buf_, note);
+        put_bytes(buf_, p.note_of(note));
+    }
+
+    buf_.push_back(kEntriesRec);
+    put(buf_, static_cast<uint32_t>(n));
+    size_t at = buf_.size();
+    buf_.resize(at + n * kEntryBytes);
+    char *out = buf_.data() + at;
+    for (size_t i = 0; i < n; ++i, out += kEntryBytes)
+    {
+        const TxEntry &e = entries[i];
+        int64_t amount = e.amount_cents, ts = e.timestamp;
+        uint8_t kind = static_cast<uint8_t>(e.kind);
+        std::memcpy(out, &amount, 8);
+        std::memcpy(out + 8, &ts, 8);
+        std::memcpy(out + 16, &e.account, 4);
+        std::memcpy(out + 20, &e.note, 4);
+        std::memcpy(out + 24, &kind, 1);
+    }
+    stats_.entries += n;
+    frame_entries_ += n;
+}
+
+void Journal::end_frame()
+{
+    uint32_t len = static_cast<uint32_t>(buf_.size() - frame_start_ - kFrameHeader);
+    uint32_t crc = crc32(buf_.data() + frame_start_ + kFrameHeader, len);
+    std::memcpy(buf_.data() + frame_start_, &len, 4);
+    std::memcpy(buf_.data() + frame_start_ + 4, &crc, 4);
+    last_frame_ = frame_start_;
+    frame_start_ = npos;
+    ++stats_.frames;
+    if (buf_.size() >= opts_.group_commit_bytes) write_buffer();
+}
+
+void Journal::abort_frame()
+{
+    size_t start = frame_start_ != npos ? frame_start_ : last_frame_;
+    if (start == npos) return;
+    if (frame_start_ == npos) --stats_.frames;
+    buf_.resize(start);
+    // notes first defined by the dropped frame are defined again by the next one that uses them
+    for (NoteId note : frame_notes_)
+        if (note < note_defined_.size()) note_defined_[note] = false;
+    stats_.entries -= frame_entries_;
+    frame_notes_.clear();
+    frame_entries_ = 0;
+    frame_start_ = last_frame_ = npos;
+}
+
+void Journal::write_buffer()
+{
+    if (buf_.empty()) return;
+    std::string path = path_of("journal", seq_);
+    if (fd_ < 0)
+        throw std::system_error(std::make_error_code(std::errc::io_error), "journal segment unusable " + path);
+    try
+    {
+        write_all(fd_, buf_.data(), buf_.size(), path);
+        if (opts_.fsync) flush_fd(fd_, path);
+    }
+    catch (...)
+    {
+        // Cut off whatever part of the buffer reached the file, so the segment ends on a whole
+        // frame again and the next write, which sends the whole buffer, does not repeat it. A
+        // segment that cannot be cut back takes no more writes.
+        if (!truncate_fd(fd_, kSegmentHeader + segment_bytes_))
+        {
+            close_fd(fd_);
+            fd_ = -1;
+        }
+        throw;
+    }
+    if (opts_.fsync) ++stats_.syncs;
+    segment_bytes_ += buf_.size();
+    stats_.bytes += buf_.size();
+    buf_.clear();
+    last_frame_ = npos;
+    frame_notes_.clear();
+    frame_entries_ = 0;
+}
+
+void Journal::sync()
+{
+    write_buffer();
+}
+
+void Journal::snapshot(const Portfolio &p)
+{
+    write_buffer();
+
+    // accounts in handle order, so reloading them interns the same handles
+    std::vector<char> body;
+    put(body, kSnapshotMagic);
+    put(body, kVersion);
+    uint64_t next = seq_ + 1;
+    put(body, next);
+    put(body, static_cast<uint64_t>(p.count()));
+    for (AccountHandle h = 0; h < p.accounts_.rows(); ++h)
+    {
+        if (!p.accounts_.contains(h)) continue;
+        put(body, h);
+        put_bytes(body, p.ids_.view(h));
+        put_settings(body, p.accounts_.settings(h));
+        put(body, static_cast<int64_t>(p.accounts_.balance(h)));
+    }
+    put(body, crc32(body.data(), body.size()));
+
+    std::string path = path_of("snapshot", next);
+    std::string tmp = path + ".tmp";
+    int fd = open_append(tmp);
+    if (fd < 0) fail("snapshot open " + tmp);
+    write_all(fd, body.data(), body.size(), tmp);
+    flush_fd(fd, tmp); // always: older segments are deleted on the strength of this file
+    close_fd(fd);
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) throw std::system_error(ec, "snapshot rename " + path);
+    sync_dir(dir_);
+
+    open_segment(next);
+    remove_before(next);
+    ++stats_.snapshots;
+}
+
+void Journal::remove_before(uint64_t seq)
+{
+    std::error_code ec;
+    for (const auto &f : fs::directory_iterator(dir_, ec))
+    {
+        std::string name = f.path().filename().string();
+        uint64_t n;
+        if ((parse_name(name, "journal", n) || parse_name(name, "snapshot", n)) && n < seq)
+            fs::remove(f.path(), ec);
+    }
+    sync_dir(dir_);
+}
+
+bool Journal::load_snapshot(const std::string &path, Portfolio &into)
+{
+    std::vector<char> data;
+    if (!read_file(path, data) || data.size() < 28) return false;
+    uint32_t stored;
+    std::memcpy(&stored, data.data() + data.size() - 4, 4);
+    if (crc32(data.data(), data.size() - 4) != stored) return false;
+
+    Reader r(data.data(), data.size() - 4);
+    uint32_t magic, version;
+    uint64_t seq, count;
+    r.get(magic);
+    r.get(version);
+    r.get(seq);
+    r.get(count);
+    if (magic != kSnapshotMagic || version != kVersion) return false;
+    // past this point `into` is modified; a file that passed its CRC but does not parse was
+    // written wrong, not torn, and there is nothing sane to fall back to
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        AccountHandle h;
+        std::string_view id;
+        AccountSettings s;
+        int64_t balance;
+        if (!r.get(h) || !r.get_bytes(id) || !r.get_settings(s) || !r.get(balance) ||
+            into.create_account(id, s, balance) != h)
+            corrupt(path);
+    }
+    if (!r.done()) corrupt(path);
+    return true;
+}
+
+bool Journal::replay_segment(const std::string &path, Portfolio &into, size_t &frames)
+{
+    std::vector<char> data;
+    if (!read_file(path, data)) return false;
+    if (data.size() < kSegmentHeader) return true; // crashed while creating the segment
+    uint32_t magic, version;
+    std::memcpy(&magic, data.data(), 4);
+    std::memcpy(&version, data.data() + 4, 4);
+    if (magic != kJournalMagic || version != kVersion) return false;
+
+    note_map_.clear();
+    size_t pos = kSegmentHeader;
+    while (data.size() - pos >= kFrameHeader)
+    {
+        uint32_t len, crc;
+        std::memcpy(&len, data.data() + pos, 4);
+        std::memcpy(&crc, data.data() + pos + 4, 4);
+        if (data.size() - pos - kFrameHeader < len) break; // torn tail
+        const char *payload = data.data() + pos + kFrameHeader;
+        if (crc32(payload, len) != crc) break;
+
+        // the CRC vouches for the whole frame, so its records are applied as they are parsed
+        Reader r(payload, len);
+        while (!r.done())
+        {
+            char tag;
+            r.get(tag);
+            if (tag == kAccountRec)
+            {
+                AccountHandle h;
+                std::string_view id;
+                AccountSettings s;
+                int64_t opening;
+                if (!r.get(h) || !r.get_bytes(id) || !r.get_settings(s) || !r.get(opening)) return false;
+                if (into.create_account(id, s, opening) != h) return false;
+            }
+            else if (tag == kNoteRec)
+            {
+                NoteId logged;
+                std::string_view note;
+                if (!r.get(logged) || !r.get_bytes(note)) return false;
+                if (logged >= note_map_.size()) note_map_.resize(logged + 1, kNoNote);
+                note_map_[logged] = into.notes_.intern(note);
+            }
+            else if (tag == kEntriesRec)
+            {
+                uint32_t n;
+                if (!r.get(n)) return false;
+                for (uint32_t i = 0; i < n; ++i)
+                {
+                    int64_t amount, ts;
+                    TxEntry e;
+                    uint8_t kind;
+                    if (!r.get(amount) || !r.get(ts) || !r.get(e.account) || !r.get(e.note) || !r.get(kind)) return false;
+                    if (!into.accounts_.contains(e.account) || e.note >= note_map_.size()) return false;
+                    e.amount_cents = amount;
+                    e.timestamp = ts;
+                    e.note = note_map_[e.note];
+                    e.kind = static_cast<TxKind>(kind);
+                    into.accounts_.apply(e);
+                    into.audit_.push_back(e);
+                }
+            }
+            else
+            {
+                return false;
+            }
+        }
+        pos += kFrameHeader + len;
+        ++frames;
+    }
+    return true;
+}
+
+size_t Journal::recover(Portfolio &into)
+{
+    std::vector<uint64_t> segments, snapshots;
+    for (const auto &f : fs::directory_iterator(dir_))
+    {
+        std::string name = f.path().filename().string();
+        uint64_t n;
+        if (parse_name(name, "journal", n))
+            segments.push_back(n);
+        else if (parse_name(name, "snapshot", n))
+            snapshots.push_back(n);
+    }
+    std::sort(segments.begin(), segments.end());
+    std::sort(snapshots.rbegin(), snapshots.rend());
+
+    // newest snapshot that checks out; none means replay from the first segment
+    uint64_t from = 0;
+    for (uint64_t s : snapshots)
+    {
+        if (load_snapshot(path_of("snapshot", s), into))
+        {
+            from = s;
+            break;
+        }
+    }
+
+    size_t frames = 0;
+    uint64_t next = from;
+    for (uint64_t s : segments)
+    {
+        if (s < from) continue; // left behind by a crash during snapshot()
+        if (!replay_segment(path_of("journal", s), into, frames)) corrupt(path_of("journal", s));
+        next = s + 1;
+    }
+
+    // never append after a torn tail: new frames go to a fresh segment
+    open_segment(next);
+    note_map_.clear();
+    return frames;
+}
+
+}
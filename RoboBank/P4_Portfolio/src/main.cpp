@@ -21,11 +21,11 @@ int main()
     p.apply_all(txs);
     std::cout << "CHK-001 balance=" << p.balance_of("CHK-001") << " expected 73500\n";
 
-    // Savings interest: 31 days at 5% APR on 500,000
-    std::vector<p4::TxRecord> interest_tx;
-    interest_tx.push_back(p4::TxRecord{p4::TxKind::Interest, 0, 4, std::string("interest"), std::string("SAV-010")});
-    p.apply_all(interest_tx);
-    std::cout << "SAV-010 balance=" << p.balance_of("SAV-010") << "\n";
+    // Month end: savings interest for 31 days at 5% APR on 500,000, checking pays its 150 fee
+    p4::MonthEndOptions month; month.timestamp = 4; month.days = 31;
+    p4::MonthEndReport closed = p.close_month(month);
+    std::cout << "month end: interest=" << closed.interest_cents << " fees=" << closed.fee_cents << "\n";
+    std::cout << "SAV-010 balance=" << p.balance_of("SAV-010") << " expected 502123\n";
 
     // Transfer 30,000 from SAV-010 to CHK-001
     p4::TransferRecord tr{"SAV-010", "CHK-001", 30000, 5, std::string("transfer")};
@@ -0,0 +1,349 @@
+#include "../include/metrics.h"
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace p4 {
+
+namespace {
+    const int kCounters = static_cast<int>(Counter::Count);
+    const int kTimers = static_cast<int>(Timer::Count);
+
+    const char *const kCounterNames[kCounters][2] = {
+        {"portfolio_tx_applied_total", "Postings applied by the batch paths"},
+        {"portfolio_batches_total", "Batch calls"},
+        {"portfolio_accounts_auto_created_total", "Accounts created for unknown ids"},
+        {"portfolio_tx_rejected_total", "Transactions refused by the checked paths"},
+        {"portfolio_transfers_total", "transfer() calls"},
+        {"portfolio_transfer_missing_account_total", "transfer() calls with an unknown id"},
+        {"portfolio_transfer_refused_total", "transfer() calls refused by the policy"},
+        {"portfolio_lookups_total", "Account id lookups"},
+        {"portfolio_lookup_misses_total", "Account id lookups that found no account"},
+        {"portfolio_audit_evictions_total", "Account audit records dropped to make room"},
+    };
+    const char *const kTimerNames[kTimers][2] = {
+        {"portfolio_batch_seconds", "Batch call latency"},
+        {"portfolio_transfer_seconds", "transfer() latency, one call in 64"},
+        {"portfolio_lookup_seconds", "Account id lookup latency, one call in 1024"},
+    };
+
+    // sums of every shard and of the retired ones, minus the baseline set by reset_metrics
+    struct Registry
+    {
+        std::mutex mu;
+#if PORTFOLIO_METRICS
+        std::vector<std::unique_ptr<metrics::Shard>> shards; // every shard made, live or free
+        std::vector<metrics::Shard *> free;                  // zeroed, for the next new thread
+#endif
+        MetricsSnapshot retired; // what threads that exited had counted
+        MetricsSnapshot baseline;
+    };
+
+    Registry &registry()
+    {
+        static Registry *r = new Registry(); // never destroyed: threads may outlive statics
+        return *r;
+    }
+
+#if PORTFOLIO_METRICS
+    void add_shard(MetricsSnapshot &s, const metrics::Shard &sh)
+    {
+        for (int c = 0; c < kCounters; ++c)
+            s.counter[c] += sh.counter[c].load(std::memory_order_relaxed);
+        for (int t = 0; t < kTimers; ++t)
+        {
+            LatencyHistogram &h = s.latency[t];
+            for (int b = 0; b < LatencyHistogram::kBuckets; ++b)
+            {
+                std::uint64_t n = sh.bucket[t][b].load(std::memory_order_relaxed);
+                h.bucket[b] += n;
+                h.count += n;
+            }
+            h.sum_ns += sh.sum_ns[t].load(std::memory_order_relaxed);
+        }
+    }
+
+    // Hands the thread's shard back when the thread exits: its counts move to the retired
+    // totals and the zeroed shard goes to the next new thread, so the registry holds at most
+    // as many shards as threads ever ran at once
+    thread_local bool tls_exiting = false;
+
+    struct ShardOwner
+    {
+        metrics::Shard *shard = nullptr;
+
+        ~ShardOwner()
+        {
+            if (!shard) return;
+            Registry &r = registry();
+            std::lock_guard<std::mutex> lock(r.mu);
+            add_shard(r.retired, *shard);
+            for (auto &a : shard->counter)
+                a.store(0, std::memory_order_relaxed);
+            for (auto &row : shard->bucket)
+                for (auto &a : row)
+                    a.store(0, std::memory_order_relaxed);
+            for (auto &a : shard->sum_ns)
+                a.store(0, std::memory_order_relaxed);
+            for (auto &t : shard->tick)
+                t = 0;
+            r.free.push_back(shard);
+            metrics::tls_shard = nullptr;
+            tls_exiting = true;
+        }
+    };
+#endif
+
+    MetricsSnapshot raw_snapshot(Registry &r)
+    {
+        MetricsSnapshot s = r.retired;
+#if PORTFOLIO_METRICS
+        for (const auto &sh : r.shards)
+            add_shard(s, *sh);
+#endif
+        return s;
+    }
+
+    std::uint64_t bucket_bound_ns(int b) { return b == 0 ? 0 : std::uint64_t(1) << b; }
+}
+
+std::uint64_t LatencyHistogram::quantile_ns(double q) const
+{
+    if (count == 0) return 0;
+    std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)), seen = 0;
+    for (int b = 0; b < kBuckets; ++b)
+    {
+        seen += bucket[b];
+        if (seen > rank) return bucket_bound_ns(b);
+    }
+    return bucket_bound_ns(kBuckets - 1);
+}
+
+#if PORTFOLIO_METRICS
+namespace metrics {
+    Shard *register_shard()
+    {
+        static thread_local ShardOwner owner;
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mu);
+        if (tls_exiting)
+        {
+            // counted from a later thread_local destructor: owner is gone, the shard stays live
+            r.shards.emplace_back(new Shard());
+            return r.shards.back().get();
+        }
+        if (r.free.empty())
+        {
+            r.shards.emplace_back(new Shard());
+            owner.shard = r.shards.back().get();
+        }
+        else
+        {
+            owner.shard = r.free.back();
+            r.free.pop_back();
+        }
+        return owner.shard;
+    }
+
+    void record(Timer t, std::uint64_t ns)
+    {
+        int b = 0;
+        while (b + 1 < LatencyHistogram::kBuckets && ns >= (std::uint64_t(1) << b))
+            ++b;
+        Shard &s = shard();
+        bump(s.bucket[static_cast<int>(t)][b], 1);
+        bump(s.sum_ns[static_cast<int>(t)], ns);
+    }
+}
+#endif
+
+MetricsSnapshot metrics_snapshot()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mu);
+    MetricsSnapshot s = raw_snapshot(r);
+    for (int c = 0; c < kCounters; ++c)
+        s.counter[c] -= r.baseline.counter[c];
+    for (int t = 0; t < kTimers; ++t)
+    {
+        for (int b = 0; b < LatencyHistogram::kBuckets; ++b)
+            s.latency[t].bucket[b] -= r.baseline.latency[t].bucket[b];
+        s.latency[t].count -= r.baseline.latency[t].count;
+        s.latency[t].sum_ns -= r.baseline.latency[t].sum_ns;
+    }
+    return s;
+}
+
+void reset_metrics()
+{
+    // the shards belong to their threads, so they are not cleared: later snapshots subtract
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mu);
+    r.baseline = raw_snapshot(r);
+}
+
+std::string metrics_text(const MetricsSnapshot &s)
+{
+    std::string out;
+    char line[256];
+    for (int c = 0; c < kCounters; ++c)
+    {
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", kCounterNames[c][0],
+                      kCounterNames[c][1], kCounterNames[c][0], kCounterNames[c][0],
+                      static_cast<unsigned long long>(s.counter[c]));
+        out += line;
+    }
+    for (int t = 0; t < kTimers; ++t)
+    {
+        const LatencyHistogram &h = s.latency[t];
+        const char *name = kTimerNames[t][0];
+        std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", name, kTimerNames[t][1], name);
+        out += line;
+        // cumulative, one line per bucket bound up to the last non-empty bucket
+        int last = 0;
+        for (int b = 0; b < LatencyHistogram::kBuckets; ++b)
+            if (h.bucket[b]) last = b;
+        std::uint64_t cum = 0;
+        for (int b = 0; b <= last; ++b)
+        {
+            cum += h.bucket[b];
+            std::snprintf(line, sizeof(line), "%s_bucket{le=\"%.9g\"} %llu\n", name, bucket_bound_ns(b) * 1e-9,
+                          static_cast<unsigned long long>(cum));
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9f\n%s_count %llu\n", name,
+                      static_cast<unsigned long long>(h.count), name, h.sum_ns * 1e-9, name,
+                      static_cast<unsigned long long>(h.count));
+        out += line;
+    }
+    return out;
+}
+
+bool write_metrics_file(const std::string &path)
+{
+    const std::string text = metrics_text(metrics_snapshot());
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        out.close();
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) fs::remove(tmp, ec);
+    return !ec;
+}
+
+struct MetricsServer::Impl
+{
+    std::thread thread;
+    std::atomic<bool> stop{false};
+    int fd = -1;
+    unsigned short port = 0;
+};
+
+MetricsServer::MetricsServer() : impl_(new Impl()) {}
+
+MetricsServer::~MetricsServer() { stop(); }
+
+unsigned short MetricsServer::port() const { return impl_->port; }
+
+#ifdef _WIN32
+bool MetricsServer::start(unsigned short) { return false; }
+void MetricsServer::stop() {}
+#else
+namespace {
+    // plain POSIX calls: SOCK_CLOEXEC, accept4 and MSG_NOSIGNAL are not everywhere (macOS)
+    int close_on_exec(int fd)
+    {
+        if (fd >= 0) ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        return fd;
+    }
+
+#ifdef MSG_NOSIGNAL
+    const int kSendFlags = MSG_NOSIGNAL;
+#else
+    const int kSendFlags = 0; // SO_NOSIGPIPE is set on the connection instead
+#endif
+}
+
+bool MetricsServer::start(unsigned short port)
+{
+    if (impl_->fd >= 0) return false;
+    int fd = close_on_exec(::socket(AF_INET, SOCK_STREAM, 0));
+    if (fd < 0) return false;
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, 8) != 0 ||
+        ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    impl_->fd = fd;
+    impl_->port = ntohs(addr.sin_port);
+    impl_->stop = false;
+    Impl *im = impl_.get();
+    impl_->thread = std::thread([im] {
+        // wakes every 100 ms to see stop()
+        pollfd p{im->fd, POLLIN, 0};
+        while (!im->stop.load())
+        {
+            if (::poll(&p, 1, 100) <= 0) continue;
+            int c = close_on_exec(::accept(im->fd, nullptr, nullptr));
+            if (c < 0) continue;
+#ifdef SO_NOSIGPIPE
+            int on = 1;
+            ::setsockopt(c, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+            // the request is not parsed: every path gets the metrics
+            char req[1024];
+            pollfd rp{c, POLLIN, 0};
+            if (::poll(&rp, 1, 100) > 0) (void)::recv(c, req, sizeof(req), 0);
+            std::string body = metrics_text(metrics_snapshot());
+            std::string resp = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+            for (size_t off = 0; off < resp.size();)
+            {
+                ssize_t w = ::send(c, resp.data() + off, resp.size() - off, kSendFlags);
+                if (w <= 0) break;
+                off += static_cast<size_t>(w);
+            }
+            ::close(c);
+        }
+    });
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (impl_->fd < 0) return;
+    impl_->stop = true;
+    impl_->thread.join();
+    ::close(impl_->fd);
+    impl_->fd = -1;
+    impl_->port = 0;
+}
+#endif
+
+}
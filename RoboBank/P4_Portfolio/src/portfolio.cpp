@@ -1,85 +1,87 @@
 #include "../include/portfolio.h"
 #include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include "Account.h"
+#include "tx_kinds.h"
+#include "../include/journal.h"
+#include "../include/audit_store.h"
 
 using namespace std;
 
 // BaseAccount implementation
-BaseAccount::BaseAccount(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents)
-    : id_(id), settings_(settings), balance_cents_(opening_balance_cents)
+BaseAccount::BaseAccount(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents,
+                         p4::StringPool *notes, p4::AccountHandle handle)
+    : id_(id), settings_(settings), balance_cents_(opening_balance_cents), handle_(handle),
+      own_notes_(notes ? nullptr : make_unique<p4::StringPool>()), notes_(notes ? notes : own_notes_.get()),
+      audit_(settings.audit_capacity)
 {
 }
 
 const string &BaseAccount::id() const { return id_; }
 long long BaseAccount::balance_cents() const { return balance_cents_; }
+p4::AccountHandle BaseAccount::handle() const { return handle_; }
+const p4::StringPool &BaseAccount::notes() const { return *notes_; }
+const p4::AccountSettings &BaseAccount::settings() const { return settings_; }
 
-void BaseAccount::deposit(long long amount_cents, long long ts, const string &note)
+void BaseAccount::post(p4::TxKind kind, long long amount_cents, long long ts, p4::NoteId note)
 {
-    balance_cents_ = Calculator::deposit(balance_cents_, amount_cents);
+    if (!Calculator::known_kind(kind)) return;
+    balance_cents_ += Calculator::kind_delta(kind, amount_cents);
     // record
-    p4::TxRecord r{p4::TxKind::Deposit, amount_cents, ts, note, id_};
-    audit_.push_back(r);
-    if (audit_.size() > 256) audit_.erase(audit_.begin());
+    audit_.push(p4::TxEntry{amount_cents, ts, handle_, note, kind});
+}
+
+void BaseAccount::post_interest(int days, int basis, long long ts, p4::NoteId note)
+{
+    long long interest_amt = Calculator::interest(balance_cents_, settings_.apr, days, basis);
+    post(p4::TxKind::Interest, interest_amt, ts, note);
+}
+
+void BaseAccount::deposit(long long amount_cents, long long ts, const string &note)
+{
+    post(p4::TxKind::Deposit, amount_cents, ts, notes_->intern(note));
 }
 
 void BaseAccount::withdraw(long long amount_cents, long long ts, const string &note)
 {
-    balance_cents_ = Calculator::withdrawal(balance_cents_, amount_cents);
-    p4::TxRecord r{p4::TxKind::Withdrawal, amount_cents, ts, note, id_};
-    audit_.push_back(r);
-    if (audit_.size() > 256) audit_.erase(audit_.begin());
+    post(p4::TxKind::Withdrawal, amount_cents, ts, notes_->intern(note));
 }
 
 void BaseAccount::charge_fee(long long fee_cents, long long ts, const string &note)
 {
-    balance_cents_ = Calculator::fee(balance_cents_, fee_cents);
-    p4::TxRecord r{p4::TxKind::Fee, fee_cents, ts, note, id_};
-    audit_.push_back(r);
-    if (audit_.size() > 256) audit_.erase(audit_.begin());
+    post(p4::TxKind::Fee, fee_cents, ts, notes_->intern(note));
 }
 
 void BaseAccount::post_simple_interest(int days, int basis, long long ts, const string &note)
 {
-    long long interest_amt = Calculator::interest(balance_cents_, settings_.apr, days, basis);
-    balance_cents_ = Calculator::deposit(balance_cents_, interest_amt);
-    p4::TxRecord r{p4::TxKind::Interest, interest_amt, ts, note, id_};
-    audit_.push_back(r);
-    if (audit_.size() > 256) audit_.erase(audit_.begin());
+    post_interest(days, basis, ts, notes_->intern(note));
 }
 
 void BaseAccount::apply(const p4::TxRecord &tx)
 {
-    switch (tx.kind)
-    {
-    case p4::TxKind::Deposit:
-        deposit(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case p4::TxKind::Withdrawal:
-        withdraw(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case p4::TxKind::Fee:
-        charge_fee(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case p4::TxKind::Interest:
-        post_simple_interest(0, 365, tx.timestamp, tx.note);
-        break;
-    case p4::TxKind::TransferIn:
-        deposit(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    case p4::TxKind::TransferOut:
-        withdraw(tx.amount_cents, tx.timestamp, tx.note);
-        break;
-    default:
-        break;
-    }
-}
-
-std::vector<p4::TxRecord> BaseAccount::audit() const { return audit_; }
+    apply(p4::TxEntry{tx.amount_cents, tx.timestamp, handle_, notes_->intern(tx.note), tx.kind});
+}
+
+void BaseAccount::apply(const p4::TxEntry &tx)
+{
+    // an Interest record carries the amount already accrued (see post_interest)
+    post(tx.kind, tx.amount_cents, tx.timestamp, tx.note);
+}
+
+AuditView<p4::TxEntry> BaseAccount::audit() const { return AuditView<p4::TxEntry>(audit_); }
+
+void BaseAccount::restore_audit(const p4::TxEntry *entries, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        audit_.push(entries[i]);
+}
 
 // CheckingAccount
-CheckingAccount::CheckingAccount(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents)
-    : BaseAccount(id, settings, opening_balance_cents)
+CheckingAccount::CheckingAccount(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents,
+                                 p4::StringPool *notes, p4::AccountHandle handle)
+    : BaseAccount(id, settings, opening_balance_cents, notes, handle)
 {
 }
 AccountType CheckingAccount::type() const { return AccountType::Checking; }
@@ -89,8 +91,9 @@ void CheckingAccount::charge_monthly_fee(long long ts)
 }
 
 // SavingsAccount
-SavingsAccount::SavingsAccount(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents)
-    : BaseAccount(id, settings, opening_balance_cents)
+SavingsAccount::SavingsAccount(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents,
+                               p4::StringPool *notes, p4::AccountHandle handle)
+    : BaseAccount(id, settings, opening_balance_cents, notes, handle)
 {
 }
 AccountType SavingsAccount::type() const { return AccountType::Savings; }
@@ -99,109 +102,471 @@ void SavingsAccount::accrue_interest(int days, int basis, long long ts)
     post_simple_interest(days, basis, ts, "accrued interest");
 }
 
+// AccountRef
+AccountRef::AccountRef(p4::AccountTable *table, p4::StringPool *notes, p4::AccountHandle handle, string_view id)
+    : table_(table), notes_(notes), handle_(handle), id_(id)
+{
+}
+
+const string &AccountRef::id() const { return id_; }
+AccountType AccountRef::type() const { return table_->type(handle_); }
+long long AccountRef::balance_cents() const { return table_->balance(handle_); }
+p4::AccountHandle AccountRef::handle() const { return handle_; }
+const p4::StringPool &AccountRef::notes() const { return *notes_; }
+const p4::AccountSettings &AccountRef::settings() const { return table_->settings(handle_); }
+AuditView<p4::TxEntry> AccountRef::audit() const { return AuditView<p4::TxEntry>(table_->audit(handle_)); }
+
+void AccountRef::deposit(long long amount_cents, long long ts, const string &note)
+{
+    table_->apply(p4::TxEntry{amount_cents, ts, handle_, notes_->intern(note), p4::TxKind::Deposit});
+}
+
+void AccountRef::withdraw(long long amount_cents, long long ts, const string &note)
+{
+    table_->apply(p4::TxEntry{amount_cents, ts, handle_, notes_->intern(note), p4::TxKind::Withdrawal});
+}
+
+void AccountRef::charge_fee(long long fee_cents, long long ts, const string &note)
+{
+    table_->apply(p4::TxEntry{fee_cents, ts, handle_, notes_->intern(note), p4::TxKind::Fee});
+}
+
+void AccountRef::post_simple_interest(int days, int basis, long long ts, const string &note)
+{
+    table_->post_interest(handle_, days, basis, ts, notes_->intern(note));
+}
+
+void AccountRef::apply(const p4::TxRecord &tx)
+{
+    table_->apply(p4::TxEntry{tx.amount_cents, tx.timestamp, handle_, notes_->intern(tx.note), tx.kind});
+}
+
+void AccountRef::apply(const p4::TxEntry &tx)
+{
+    p4::TxEntry e = tx;
+    e.account = handle_;
+    table_->apply(e);
+}
+
 // Portfolio
-Portfolio::Portfolio() {}
+namespace {
+    p4::MemoryOptions resolved(p4::MemoryOptions mem)
+    {
+        if (!mem.upstream) mem.upstream = pmr::get_default_resource();
+        return mem;
+    }
+
+    // serializes calls into a resource that may not be thread-safe (e.g. a caller's
+    // monotonic_buffer_resource); allocation strategy stays the upstream's
+    class LockedResource : public pmr::memory_resource
+    {
+    public:
+        explicit LockedResource(pmr::memory_resource *upstream) : upstream_(upstream) {}
+
+    private:
+        void *do_allocate(size_t bytes, size_t align) override
+        {
+            lock_guard<mutex> lock(mu_);
+            return upstream_->allocate(bytes, align);
+        }
+        void do_deallocate(void *p, size_t bytes, size_t align) override
+        {
+            lock_guard<mutex> lock(mu_);
+            upstream_->deallocate(p, bytes, align);
+        }
+        bool do_is_equal(const pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+        mutex mu_;
+        pmr::memory_resource *upstream_;
+    };
+
+    // parallel apply grows rings from several workers at once, so the ring resource is
+    // synchronized either way
+    unique_ptr<pmr::memory_resource> audit_resource(const p4::MemoryOptions &mem)
+    {
+        if (!mem.pooled_audit) return make_unique<LockedResource>(mem.upstream);
+        // chunks of at most 1024 rings: the pool grows its chunks geometrically, and an
+        // unbounded last chunk could leave a large tail unused on a big book
+        pmr::pool_options o;
+        o.max_blocks_per_chunk = 1024;
+        o.largest_required_pool_block = p4::kDefaultAuditCapacity * sizeof(p4::TxEntry);
+        return make_unique<pmr::synchronized_pool_resource>(o, mem.upstream);
+    }
+}
+
+Portfolio::Portfolio() : Portfolio(p4::MemoryOptions()) {}
+
+Portfolio::Portfolio(const p4::MemoryOptions &mem)
+    : mem_(resolved(mem)),
+      audit_mr_(audit_resource(mem_)),
+      arena_(mem_.batch_arena_bytes ? new char[mem_.batch_arena_bytes] : nullptr),
+      accounts_(audit_mr_.get()), count_(0), journal_(nullptr), audit_store_(nullptr),
+      policy_(), check_totals_(false), apply_by_kind_(false), totals_mismatches_(0)
+{
+}
+
+Portfolio::Scratch::Scratch(Portfolio &p) : resource(p.mem_.upstream)
+{
+    // batch calls do not nest, so every Scratch can start over at the front of the one buffer
+    if (p.arena_) resource = &arena.emplace(p.arena_.get(), p.mem_.batch_arena_bytes, p.mem_.upstream);
+}
+
+void Portfolio::attach_journal(p4::Journal *journal) { journal_ = journal; }
+
+void Portfolio::attach_audit_store(p4::AuditStore *store)
+{
+    audit_store_ = store;
+    flush_audit();
+}
+
+void Portfolio::flush_audit()
+{
+    if (!audit_store_) return;
+    // cleared even when append throws (a spill failed): the store holds the records by then, and
+    // appending them again would store them twice. The capacity stays for the next operation.
+    try
+    {
+        audit_store_->append(audit_.data(), audit_.size());
+    }
+    catch (...)
+    {
+        audit_.clear();
+        throw;
+    }
+    audit_.clear();
+}
+
+void Portfolio::end_operation()
+{
+    // the operation is done in memory either way, so the view is published before any error
+    // is rethrown; a journal error goes first, as it is the one that loses data
+    exception_ptr failed;
+    try
+    {
+        flush_audit();
+    }
+    catch (...)
+    {
+        failed = current_exception();
+    }
+    if (views_ && views_->due()) views_->publish(accounts_, ids_, notes_, count_);
+    if (journal_error_)
+    {
+        failed = journal_error_;
+        journal_error_ = nullptr;
+    }
+    if (failed) rethrow_exception(failed);
+}
+
+void Portfolio::close_frame()
+{
+    try
+    {
+        journal_->end_frame();
+    }
+    catch (...)
+    {
+        if (!journal_error_) journal_error_ = current_exception();
+    }
+}
+
+void Portfolio::enable_read_views(const p4::ReadViewOptions &opts)
+{
+    views_ = make_unique<p4::ViewBuilder>(opts);
+    publish_view();
+}
+
+shared_ptr<const p4::ReadView> Portfolio::publish_view()
+{
+    if (!views_) return nullptr;
+    return views_->publish(accounts_, ids_, notes_, count_);
+}
+
+shared_ptr<const p4::ReadView> Portfolio::latest_view() const { return views_ ? views_->latest() : nullptr; }
+
+shared_ptr<const p4::ReadView> Portfolio::next_view(chrono::milliseconds timeout) const
+{
+    return views_ ? views_->next(timeout) : nullptr;
+}
+
+p4::AccountHandle Portfolio::create_account(string_view id, const p4::AccountSettings &settings, long long opening_balance_cents)
+{
+    p4::AccountHandle h = ids_.intern(id);
+    accounts_.add(h, settings, opening_balance_cents);
+    ++count_;
+    if (journal_) journal_->log_account(h, id, settings, opening_balance_cents);
+    return h;
+}
 
 bool Portfolio::add_account(const string &id, const p4::AccountSettings &settings, long long opening_balance_cents)
 {
-    if (accounts_.find(id) != accounts_.end()) return false;
-    if (settings.type == AccountType::Checking)
-        accounts_[id] = make_unique<CheckingAccount>(id, settings, opening_balance_cents);
-    else
-        accounts_[id] = make_unique<SavingsAccount>(id, settings, opening_balance_cents);
+    if (handle_of(id) != p4::StringPool::npos) return false;
+    if (journal_) journal_->begin_frame(*this);
+    create_account(id, settings, opening_balance_cents);
+    if (journal_) close_frame();
+    end_operation();
     return true;
 }
 
-IAccount *Portfolio::get_account(const string &id) const
+p4::AccountHandle Portfolio::handle_of(string_view id) const
 {
-    auto it = accounts_.find(id);
-    return (it == accounts_.end()) ? nullptr : it->second.get();
+    p4::metrics::Scope timed(p4::Timer::Lookup);
+    p4::metrics::add(p4::Counter::Lookups);
+    p4::AccountHandle h = ids_.find(id);
+    if (h != p4::StringPool::npos && accounts_.contains(h)) return h;
+    p4::metrics::add(p4::Counter::LookupMisses);
+    return p4::StringPool::npos;
 }
 
-size_t Portfolio::count() const { return accounts_.size(); }
+string_view Portfolio::id_of(p4::AccountHandle h) const { return ids_.view(h); }
+string_view Portfolio::note_of(p4::NoteId n) const { return notes_.view(n); }
+const vector<p4::TxEntry> &Portfolio::audit() const { return audit_; }
 
-void Portfolio::apply_all(const vector<p4::TxRecord> &txs, bool auto_create)
+unique_ptr<IAccount> Portfolio::get_account(const string &id) const
+{
+    p4::AccountHandle h = handle_of(id);
+    if (h == p4::StringPool::npos) return nullptr;
+    // a non-const facade from a const portfolio, as the owned account objects used to be
+    Portfolio *self = const_cast<Portfolio *>(this);
+    return make_unique<AccountRef>(&self->accounts_, &self->notes_, h, ids_.view(h));
+}
+
+size_t Portfolio::count() const { return count_; }
+
+void Portfolio::reserve(size_t accounts)
 {
-    for (const auto &t : txs)
+    ids_.reserve(accounts + 1); // + the empty id
+    accounts_.reserve(accounts + 1);
+}
+
+void Portfolio::reserve_more(vector<p4::TxEntry> &v, size_t more)
+{
+    // an exact reserve would reallocate on every small batch
+    if (v.size() + more > v.capacity()) v.reserve(max(v.size() + more, 2 * v.capacity()));
+}
+
+template <class Rec>
+void Portfolio::resolve(const Rec *txs, size_t n, bool auto_create, vector<p4::TxEntry> &out)
+{
+    size_t first = out.size();
+    reserve_more(out, n);
+    if (journal_) journal_->begin_frame(*this); // created accounts and the entries form one frame
+    for (size_t i = 0; i < n; ++i)
     {
-        auto it = accounts_.find(t.account_id);
-        if (it == accounts_.end())
+        const Rec &t = txs[i];
+        p4::AccountHandle h = handle_of(t.account_id);
+        if (h == p4::StringPool::npos)
         {
             if (!auto_create) continue;
             // create with default settings
             p4::AccountSettings s; s.type = static_cast<int>(AccountType::Checking); s.apr = 0.0; s.fee_flat_cents = 0;
-            add_account(t.account_id, s, 0);
-            it = accounts_.find(t.account_id);
+            h = create_account(t.account_id, s, 0);
+            p4::metrics::add(p4::Counter::AutoCreated);
         }
-
-        IAccount *acc = it->second.get();
-        // convert p4::TxRecord to P3 TxRecord for account-level audit where needed
-        acc->apply(t);
-        audit_.push_back(t);
+        // intern once; the account audit and the portfolio audit share the compact record
+        out.push_back(p4::TxEntry{t.amount_cents, t.timestamp, h, notes_.intern(t.note), t.kind});
+    }
+    if (journal_)
+    {
+        journal_->log_entries(*this, out.data() + first, out.size() - first);
+        close_frame();
     }
 }
 
+template void Portfolio::resolve<p4::TxRecord>(const p4::TxRecord *, size_t, bool, vector<p4::TxEntry> &);
+template void Portfolio::resolve<p4::TxView>(const p4::TxView *, size_t, bool, vector<p4::TxEntry> &);
+
+void Portfolio::apply_all(const vector<p4::TxRecord> &txs, bool auto_create)
+{
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    size_t first = audit_.size();
+    resolve(txs.data(), txs.size(), auto_create, audit_);
+    Scratch scratch(*this);
+    apply_entries(audit_.data() + first, audit_.size() - first, scratch.resource);
+    p4::metrics::add_batch(audit_.size() - first);
+    end_operation();
+}
+
 void Portfolio::apply_from_ledger(const char tx_account_id[][MAX_LEN], const int tx_type[], const int tx_amount_cents[], int tx_count)
 {
-    vector<p4::TxRecord> v;
-    v.reserve(tx_count);
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    // views straight into the ledger arrays: no per-transaction string copies
+    Scratch scratch(*this);
+    pmr::vector<p4::TxView> v(tx_count > 0 ? tx_count : 0, scratch.resource);
+    // a full-width row (MAX_LEN bytes) has no terminator
     for (int i = 0; i < tx_count; ++i)
+        v[i] = p4::TxView{static_cast<p4::TxKind>(tx_type[i]), tx_amount_cents[i], 0, string_view(),
+                          string_view(tx_account_id[i], strnlen(tx_account_id[i], MAX_LEN))};
+    size_t first = audit_.size();
+    resolve(v.data(), v.size(), true, audit_);
+    apply_entries(audit_.data() + first, audit_.size() - first, scratch.resource);
+    p4::metrics::add_batch(audit_.size() - first);
+    end_operation();
+}
+
+void Portfolio::set_policy(const p4::TxPolicy &policy) { policy_ = policy; }
+const p4::TxPolicy &Portfolio::policy() const { return policy_; }
+
+vector<p4::TxRejection> Portfolio::apply_checked(const vector<p4::TxRecord> &txs, bool auto_create)
+{
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    vector<p4::TxRejection> rejected;
+    const size_t n = txs.size();
+
+    // Pre-pass over the batch: the rules that need no account, and the id lookups. Keeping the
+    // lookups out of the apply loop lets them overlap, as in resolve().
+    Scratch scratch(*this);
+    pmr::vector<p4::RejectReason> reason(n, scratch.resource);
+    pmr::vector<p4::AccountHandle> handle(n, scratch.resource);
+    size_t bad = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        reason[i] = policy_.check_amount(txs[i].kind, txs[i].amount_cents);
+        bad += reason[i] != p4::RejectReason::None;
+        handle[i] = handle_of(txs[i].account_id);
+    }
+    rejected.reserve(bad);
+
+    size_t first = audit_.size();
+    reserve_more(audit_, n - bad);
+    if (journal_) journal_->begin_frame(*this);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const p4::TxRecord &t = txs[i];
+        p4::RejectReason r = reason[i];
+        p4::AccountHandle h = handle[i];
+        // missing at the pre-pass, but an earlier transaction may have created it since
+        if (r == p4::RejectReason::None && h == p4::StringPool::npos) h = handle_of(t.account_id);
+        if (r == p4::RejectReason::None)
+        {
+            if (h != p4::StringPool::npos)
+                r = policy_.check_account(accounts_.type(h), accounts_.balance(h), t.kind, t.amount_cents);
+            else if (!auto_create)
+                r = p4::RejectReason::MissingAccount;
+            else
+            {
+                // a new account opens at 0 with default settings, as in apply_all
+                p4::AccountSettings s; s.type = static_cast<int>(AccountType::Checking); s.apr = 0.0; s.fee_flat_cents = 0;
+                r = policy_.check_account(s.type, 0, t.kind, t.amount_cents);
+                if (r == p4::RejectReason::None)
+                {
+                    h = create_account(t.account_id, s, 0);
+                    p4::metrics::add(p4::Counter::AutoCreated);
+                }
+            }
+        }
+        if (r != p4::RejectReason::None)
+        {
+            rejected.push_back(p4::TxRejection{static_cast<uint32_t>(i), r});
+            continue;
+        }
+        // the balance moves as the entry is accepted, so the next overdraft check sees it; the
+        // audit rings are written after the loop
+        audit_.push_back(p4::TxEntry{t.amount_cents, t.timestamp, h, notes_.intern(t.note), t.kind});
+        accounts_.apply_balance(audit_.back());
+    }
+    for (size_t i = first; i < audit_.size(); ++i)
+        accounts_.apply_audit(audit_[i]);
+    if (journal_)
     {
-        p4::TxRecord tx;
-        tx.kind = static_cast<p4::TxKind>(tx_type[i]);
-        tx.amount_cents = tx_amount_cents[i];
-        tx.timestamp = 0;
-        tx.note = std::string();
-        tx.account_id = std::string(tx_account_id[i]);
-        v.push_back(tx);
+        journal_->log_entries(*this, audit_.data() + first, audit_.size() - first);
+        close_frame();
     }
-    apply_all(v, true);
+    p4::metrics::add_batch(audit_.size() - first);
+    p4::metrics::add(p4::Counter::TxRejected, rejected.size());
+    end_operation();
+    return rejected;
 }
 
-bool Portfolio::transfer(const p4::TransferRecord &tr)
+bool Portfolio::transfer(const p4::TransferRecord &tr, p4::RejectReason *reason)
 {
-    auto from = accounts_.find(tr.from_id);
-    auto to = accounts_.find(tr.to_id);
-    if (from == accounts_.end() || to == accounts_.end()) return false;
-
-    // Withdraw from source
-    p4::TxRecord out_tx{p4::TxKind::TransferOut, tr.amount_cents, tr.timestamp, tr.note, tr.from_id};
-    from->second->apply(out_tx);
-    // Deposit to dest
-    p4::TxRecord in_tx{p4::TxKind::TransferIn, tr.amount_cents, tr.timestamp, tr.note, tr.to_id};
-    to->second->apply(in_tx);
-    audit_.push_back(out_tx);
-    audit_.push_back(in_tx);
-    return true;
+    p4::metrics::Scope timed(p4::Timer::Transfer);
+    p4::metrics::add(p4::Counter::Transfers);
+    p4::AccountHandle from = handle_of(tr.from_id);
+    p4::AccountHandle to = handle_of(tr.to_id);
+    p4::RejectReason r = p4::RejectReason::MissingAccount;
+    if (from != p4::StringPool::npos && to != p4::StringPool::npos)
+        r = policy_.check_amount(p4::TxKind::TransferOut, tr.amount_cents);
+    if (r == p4::RejectReason::None)
+    {
+        // withdraw from source, deposit to dest: both legs or neither
+        p4::NoteId note = notes_.intern(tr.note);
+        size_t first = audit_.size();
+        audit_.push_back(p4::TxEntry{tr.amount_cents, tr.timestamp, from, note, p4::TxKind::TransferOut});
+        audit_.push_back(p4::TxEntry{tr.amount_cents, tr.timestamp, to, note, p4::TxKind::TransferIn});
+        r = commit_staged(first).reason;
+    }
+    if (r == p4::RejectReason::MissingAccount)
+        p4::metrics::add(p4::Counter::TransferMissing);
+    else if (r != p4::RejectReason::None)
+        p4::metrics::add(p4::Counter::TransferRefused);
+    if (reason) *reason = r;
+    return r == p4::RejectReason::None;
 }
 
 long long Portfolio::balance_of(const string &id) const
 {
-    auto it = accounts_.find(id);
-    return (it == accounts_.end()) ? 0 : it->second->balance_cents();
+    p4::AccountHandle h = handle_of(id);
+    return h == p4::StringPool::npos ? 0 : accounts_.balance(h);
+}
+
+p4::TypeTotals Portfolio::read_totals() const
+{
+    if (!check_totals_) return accounts_.totals();
+    p4::TypeTotals scan = accounts_.rescan_totals();
+    const p4::TypeTotals &kept = accounts_.totals();
+    if (scan.by_type[0] != kept.by_type[0] || scan.by_type[1] != kept.by_type[1]) ++totals_mismatches_;
+    return scan;
 }
 
 long long Portfolio::total_exposure() const
 {
-    long long sum = 0;
-    for (const auto &p : accounts_) sum += p.second->balance_cents();
-    return sum;
+    p4::TypeTotals t = read_totals();
+    return t.by_type[AccountType::Checking] + t.by_type[AccountType::Savings];
+}
+
+long long Portfolio::total_of(AccountType type) const
+{
+    return read_totals().by_type[type == AccountType::Savings];
 }
 
 vector<string> Portfolio::list_ids() const
 {
     vector<string> ids;
-    ids.reserve(accounts_.size());
-    for (const auto &p : accounts_) ids.push_back(p.first);
+    ids.reserve(count_);
+    for (p4::AccountHandle h = 0; h < accounts_.rows(); ++h)
+        if (accounts_.contains(h)) ids.emplace_back(ids_.view(h));
     return ids;
 }
 
 unordered_map<AccountType, long long> Portfolio::totals_by_type() const
 {
+    p4::TypeTotals t = read_totals();
     unordered_map<AccountType, long long> out;
-    for (const auto &p : accounts_)
+    // only types that have accounts get an entry
+    if (accounts_.count(AccountType::Checking)) out[AccountType::Checking] = t.by_type[AccountType::Checking];
+    if (accounts_.count(AccountType::Savings)) out[AccountType::Savings] = t.by_type[AccountType::Savings];
+    return out;
+}
+
+bool Portfolio::verify_totals() const
+{
+    p4::TypeTotals scan = accounts_.rescan_totals();
+    const p4::TypeTotals &kept = accounts_.totals();
+    return scan.by_type[0] == kept.by_type[0] && scan.by_type[1] == kept.by_type[1];
+}
+
+void Portfolio::set_check_totals(bool on) { check_totals_ = on; }
+void Portfolio::set_apply_by_kind(bool on) { apply_by_kind_ = on; }
+
+void Portfolio::apply_entries(const p4::TxEntry *txs, size_t n, pmr::memory_resource *scratch)
+{
+    if (apply_by_kind_)
     {
-        out[p.second->type()] += p.second->balance_cents();
+        accounts_.apply_by_kind(txs, n, scratch);
+        return;
     }
-    return out;
+    for (size_t i = 0; i < n; ++i)
+        accounts_.apply(txs[i]);
 }
+size_t Portfolio::totals_mismatches() const { return totals_mismatches_; }
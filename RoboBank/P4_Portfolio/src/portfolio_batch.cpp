@@ -0,0 +1,266 @@
+#include "../include/portfolio.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include "../include/journal.h"
+
+using namespace std;
+
+p4::BatchResult Portfolio::commit(const p4::Batch &batch)
+{
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    const vector<p4::TxRecord> &legs = batch.legs();
+    size_t first = audit_.size();
+    // stage the entries; nothing but the note pool is touched until commit_staged
+    for (size_t i = 0; i < legs.size(); ++i)
+    {
+        const p4::TxRecord &t = legs[i];
+        p4::AccountHandle h = handle_of(t.account_id);
+        p4::RejectReason r = h == p4::StringPool::npos ? p4::RejectReason::MissingAccount
+                                                       : policy_.check_amount(t.kind, t.amount_cents);
+        if (r != p4::RejectReason::None)
+        {
+            audit_.resize(first);
+            p4::metrics::add_batch(0);
+            p4::metrics::add(p4::Counter::TxRejected, legs.size());
+            p4::BatchResult refused;
+            refused.leg = static_cast<uint32_t>(i);
+            refused.reason = r;
+            return refused;
+        }
+        audit_.push_back(p4::TxEntry{t.amount_cents, t.timestamp, h, notes_.intern(t.note), t.kind});
+    }
+    p4::BatchResult result = commit_staged(first);
+    p4::metrics::add_batch(result.committed ? legs.size() : 0);
+    if (!result.committed) p4::metrics::add(p4::Counter::TxRejected, legs.size());
+    return result;
+}
+
+p4::BatchResult Portfolio::commit_staged(size_t first)
+{
+    p4::BatchResult result;
+    const size_t end = audit_.size();
+    // only the touched rows are saved, so a rollback costs what the batch did
+    auto rollback = [&] {
+        for (size_t k = undo_.size(); k-- > 0;)
+            accounts_.set_balance(undo_[k].first, undo_[k].second);
+        undo_.clear();
+        audit_.resize(first);
+    };
+
+    try
+    {
+        // the frame opens before any balance moves: begin_frame may snapshot the portfolio
+        if (journal_) journal_->begin_frame(*this);
+        undo_.clear();
+        for (size_t i = first; i < end; ++i)
+        {
+            const p4::TxEntry &e = audit_[i];
+            long long balance = accounts_.balance(e.account);
+            p4::RejectReason r = policy_.check_account(accounts_.type(e.account), balance, e.kind, e.amount_cents);
+            if (r != p4::RejectReason::None)
+            {
+                rollback();
+                if (journal_) journal_->abort_frame();
+                result.leg = static_cast<uint32_t>(i - first);
+                result.reason = r;
+                return result;
+            }
+            undo_.emplace_back(e.account, balance);
+            accounts_.apply_balance(e);
+        }
+        if (journal_)
+        {
+            journal_->log_entries(*this, audit_.data() + first, end - first);
+            journal_->end_frame();
+        }
+    }
+    catch (...)
+    {
+        // a failed write leaves the frame buffered: drop it, or the next write would persist
+        // a batch the portfolio refused
+        rollback();
+        if (journal_) journal_->abort_frame();
+        throw;
+    }
+    undo_.clear();
+    for (size_t i = first; i < end; ++i)
+        accounts_.apply_audit(audit_[i]);
+    end_operation();
+    result.committed = true;
+    return result;
+}
+
+p4::TransferBatchReport Portfolio::transfer_batch(const p4::TransferBatch &batch, const p4::TransferBatchOptions &opts)
+{
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    p4::TransferBatchReport report;
+    const size_t n = batch.size();
+    const uint32_t *from = batch.from(), *to = batch.to(), *note = batch.note();
+    const long long *amount = batch.amount_cents(), *ts = batch.timestamp();
+
+    // batch id/note index -> portfolio handle/note id, once per distinct string
+    Scratch scratch(*this);
+    pmr::vector<p4::AccountHandle> handle(batch.ids().size(), scratch.resource);
+    for (size_t k = 0; k < handle.size(); ++k)
+        handle[k] = handle_of(batch.ids().view(static_cast<uint32_t>(k)));
+    pmr::vector<p4::NoteId> note_id(batch.notes().size(), scratch.resource);
+    for (size_t k = 0; k < note_id.size(); ++k)
+        note_id[k] = notes_.intern(batch.notes().view(static_cast<uint32_t>(k)));
+
+    auto reject = [&](size_t i, p4::RejectReason r) { report.rejected.push_back(p4::TxRejection{static_cast<uint32_t>(i), r}); };
+    // posts both legs with the checks of transfer(): the out leg against the source balance,
+    // then the in leg against the destination's after it. Balances before each leg go to undo_
+    // for a journal failure.
+    auto post = [&](p4::AccountHandle f, p4::AccountHandle t, long long amt, long long when, p4::NoteId nt) {
+        long long before = accounts_.balance(f);
+        p4::RejectReason r = policy_.check_account(accounts_.type(f), before, p4::TxKind::TransferOut, amt);
+        if (r != p4::RejectReason::None) return r;
+        p4::TxEntry out_tx{amt, when, f, nt, p4::TxKind::TransferOut};
+        accounts_.apply_balance(out_tx);
+        long long before_in = accounts_.balance(t);
+        r = policy_.check_account(accounts_.type(t), before_in, p4::TxKind::TransferIn, amt);
+        if (r != p4::RejectReason::None)
+        {
+            accounts_.set_balance(f, before);
+            return r;
+        }
+        p4::TxEntry in_tx{amt, when, t, nt, p4::TxKind::TransferIn};
+        accounts_.apply_balance(in_tx);
+        undo_.emplace_back(f, before);
+        undo_.emplace_back(t, before_in);
+        audit_.push_back(out_tx);
+        audit_.push_back(in_tx);
+        return p4::RejectReason::None;
+    };
+
+    size_t first = audit_.size();
+    undo_.clear();
+    try
+    {
+        if (journal_) journal_->begin_frame(*this);
+        if (!opts.net_pairs)
+        {
+            reserve_more(audit_, 2 * n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                p4::AccountHandle f = handle[from[i]], t = handle[to[i]];
+                p4::RejectReason r = p4::RejectReason::MissingAccount;
+                if (f != p4::StringPool::npos && t != p4::StringPool::npos)
+                    r = policy_.check_amount(p4::TxKind::TransferOut, amount[i]);
+                if (r == p4::RejectReason::None) r = post(f, t, amount[i], ts[i], note_id[note[i]]);
+                if (r != p4::RejectReason::None)
+                    reject(i, r);
+                else
+                    ++report.applied;
+            }
+            report.postings = report.applied;
+        }
+        else
+        {
+            // one slot per unordered account pair, in order of first appearance; amounts are
+            // summed from the lower handle to the higher
+            struct Pair
+            {
+                p4::AccountHandle lo, hi;
+                long long net, last_ts;
+                p4::NoteId note;
+                size_t first_tx; // head of the pair's transfers in next_tx
+            };
+            pmr::vector<Pair> pairs(scratch.resource);
+            pmr::unordered_map<uint64_t, size_t> slot(scratch.resource);
+            slot.reserve(n);
+            pmr::vector<size_t> next_tx(n, SIZE_MAX, scratch.resource), tail(scratch.resource);
+            for (size_t i = 0; i < n; ++i)
+            {
+                p4::AccountHandle f = handle[from[i]], t = handle[to[i]];
+                p4::RejectReason r = p4::RejectReason::MissingAccount;
+                if (f != p4::StringPool::npos && t != p4::StringPool::npos)
+                    r = policy_.check_amount(p4::TxKind::TransferOut, amount[i]);
+                if (r != p4::RejectReason::None)
+                {
+                    reject(i, r);
+                    continue;
+                }
+                p4::AccountHandle lo = min(f, t), hi = max(f, t);
+                auto ins = slot.emplace(uint64_t(lo) << 32 | hi, pairs.size());
+                if (ins.second)
+                {
+                    pairs.push_back(Pair{lo, hi, 0, ts[i], note_id[note[i]], i});
+                    tail.push_back(i);
+                }
+                else
+                {
+                    size_t p = ins.first->second;
+                    next_tx[tail[p]] = i;
+                    tail[p] = i;
+                }
+                Pair &p = pairs[ins.first->second];
+                p.net += f == lo ? amount[i] : -amount[i];
+                p.last_ts = max(p.last_ts, ts[i]);
+            }
+            reserve_more(audit_, 2 * pairs.size());
+            size_t refused = report.rejected.size();
+            for (const Pair &p : pairs)
+            {
+                if (p.lo == p.hi)
+                {
+                    // self-transfers are not netted: summed, they could overdraw where each
+                    // alone does not. Each posts, or is refused, as transfer() would.
+                    for (size_t i = p.first_tx; i != SIZE_MAX; i = next_tx[i])
+                    {
+                        p4::RejectReason r = post(p.lo, p.lo, amount[i], ts[i], note_id[note[i]]);
+                        if (r != p4::RejectReason::None)
+                        {
+                            reject(i, r);
+                            continue;
+                        }
+                        ++report.applied;
+                        ++report.postings;
+                    }
+                    continue;
+                }
+                size_t count = 0;
+                for (size_t i = p.first_tx; i != SIZE_MAX; i = next_tx[i])
+                    ++count;
+                p4::RejectReason r = p4::RejectReason::None;
+                if (p.net > 0) r = post(p.lo, p.hi, p.net, p.last_ts, p.note);
+                else if (p.net < 0) r = post(p.hi, p.lo, -p.net, p.last_ts, p.note);
+                if (r != p4::RejectReason::None)
+                {
+                    for (size_t i = p.first_tx; i != SIZE_MAX; i = next_tx[i])
+                        reject(i, r);
+                    continue;
+                }
+                report.applied += count;
+                report.postings += p.net != 0;
+            }
+            if (report.rejected.size() != refused)
+                sort(report.rejected.begin(), report.rejected.end(),
+                     [](const p4::TxRejection &a, const p4::TxRejection &b) { return a.index < b.index; });
+        }
+        if (journal_)
+        {
+            journal_->log_entries(*this, audit_.data() + first, audit_.size() - first);
+            journal_->end_frame();
+        }
+    }
+    catch (...)
+    {
+        // as commit_staged: the batch is undone and its frame dropped, so the journal never
+        // holds a batch the live portfolio does not
+        for (size_t k = undo_.size(); k-- > 0;)
+            accounts_.set_balance(undo_[k].first, undo_[k].second);
+        undo_.clear();
+        audit_.resize(first);
+        if (journal_) journal_->abort_frame();
+        throw;
+    }
+    undo_.clear();
+    for (size_t i = first; i < audit_.size(); ++i)
+        accounts_.apply_audit(audit_[i]);
+    p4::metrics::add_batch(audit_.size() - first);
+    p4::metrics::add(p4::Counter::TxRejected, report.rejected.size());
+    end_operation();
+    return report;
+}
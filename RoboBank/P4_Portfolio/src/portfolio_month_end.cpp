@@ -0,0 +1,147 @@
+#include "../include/portfolio.h"
+#include <thread>
+#include "../include/journal.h"
+#include "calculator.h"
+
+using namespace std;
+
+namespace {
+    const size_t kMinRowsPerThread = 1 << 16;
+    const size_t kBlock = 1024; // rows per month_end_deltas call; the amounts stay on the stack
+
+    // fn(worker, begin, end) over `parts` contiguous ranges of [0, rows), worker 0 on the caller
+    template <class Fn>
+    void for_ranges(size_t rows, unsigned parts, Fn fn)
+    {
+        size_t per = (rows + parts - 1) / parts;
+        vector<thread> pool;
+        for (unsigned t = 1; t < parts; ++t)
+            pool.emplace_back([&, t] { fn(t, min(rows, t * per), min(rows, (t + 1) * per)); });
+        fn(0u, size_t(0), min(rows, per));
+        for (auto &th : pool)
+            th.join();
+    }
+}
+
+p4::MonthEndReport Portfolio::close_month(const p4::MonthEndOptions &opts)
+{
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    p4::MonthEndReport report;
+    const size_t rows = accounts_.rows();
+    unsigned parts = opts.threads ? opts.threads : 1;
+    if (rows / parts < kMinRowsPerThread) parts = static_cast<unsigned>(max<size_t>(1, rows / kMinRowsPerThread));
+
+    // Signed amounts per row (interest > 0, fee < 0), a block at a time. Recomputing them in
+    // pass 2 is cheaper than keeping a column of them.
+    // the convention is picked once per call; each one is its own instantiation of the row loop,
+    // and its per-profile rates are built once for both passes
+    p4::MonthEndRates<Calculator::Act360> act360;
+    p4::MonthEndRates<Calculator::Thirty360> thirty360;
+    p4::MonthEndRates<Calculator::Act365> act365;
+    switch (opts.day_count)
+    {
+    case p4::DayCount::Act360:
+        act360 = accounts_.month_end_rates<Calculator::Act360>(opts.days, opts.accrue_interest, opts.charge_fees);
+        break;
+    case p4::DayCount::Thirty360:
+        thirty360 = accounts_.month_end_rates<Calculator::Thirty360>(opts.days, opts.accrue_interest, opts.charge_fees);
+        break;
+    default:
+        act365 = accounts_.month_end_rates<Calculator::Act365>(opts.days, opts.accrue_interest, opts.charge_fees);
+    }
+    auto deltas = [&](size_t begin, size_t end, long long d[]) {
+        switch (opts.day_count)
+        {
+        case p4::DayCount::Act360:
+            accounts_.month_end_deltas(act360, begin, end, d);
+            break;
+        case p4::DayCount::Thirty360:
+            accounts_.month_end_deltas(thirty360, begin, end, d);
+            break;
+        default:
+            accounts_.month_end_deltas(act365, begin, end, d);
+        }
+    };
+    auto emits = [&](size_t row, long long d) {
+        return accounts_.contains(static_cast<p4::AccountHandle>(row)) && (d != 0 || !opts.skip_zero);
+    };
+
+    // pass 1: the records each range emits
+    vector<size_t> emitted(parts + 1, 0);
+    for_ranges(rows, parts, [&](unsigned w, size_t begin, size_t end) {
+        long long d[kBlock];
+        size_t n = 0;
+        for (size_t b = begin; b < end; b += kBlock)
+        {
+            size_t e = min(end, b + kBlock);
+            deltas(b, e, d);
+            for (size_t i = b; i < e; ++i)
+                n += emits(i, d[i - b]);
+        }
+        emitted[w + 1] = n;
+    });
+    for (unsigned w = 0; w < parts; ++w)
+        emitted[w + 1] += emitted[w];
+
+    // pass 2: each range writes its records at its offset of the portfolio audit; without a
+    // journal it also applies them, otherwise they are logged first and applied in pass 3
+    const p4::NoteId interest_note = notes_.intern("accrued interest");
+    const p4::NoteId fee_note = notes_.intern("monthly fee");
+    const size_t first = audit_.size();
+    audit_.resize(first + emitted[parts]);
+    if (journal_) journal_->begin_frame(*this);
+    const bool apply_now = !journal_;
+    vector<p4::TypeTotals> totals(parts); // per worker, merged into the table's after the passes
+    for_ranges(rows, parts, [&](unsigned w, size_t begin, size_t end) {
+        p4::TxEntry *out = audit_.data() + first + emitted[w];
+        p4::TypeTotals local;
+        long long d[kBlock];
+        for (size_t b = begin; b < end; b += kBlock)
+        {
+            size_t e = min(end, b + kBlock);
+            deltas(b, e, d);
+            for (size_t i = b; i < e; ++i)
+            {
+                if (!emits(i, d[i - b])) continue;
+                p4::AccountHandle h = static_cast<p4::AccountHandle>(i);
+                bool savings = accounts_.type(h) == AccountType::Savings;
+                *out = savings ? p4::TxEntry{d[i - b], opts.timestamp, h, interest_note, p4::TxKind::Interest}
+                               : p4::TxEntry{-d[i - b], opts.timestamp, h, fee_note, p4::TxKind::Fee};
+                if (apply_now) accounts_.apply(*out, local);
+                ++out;
+            }
+        }
+        totals[w] = local;
+    });
+    if (journal_)
+    {
+        journal_->log_entries(*this, audit_.data() + first, audit_.size() - first);
+        close_frame();
+        for_ranges(rows, parts, [&](unsigned w, size_t, size_t) {
+            p4::TypeTotals local;
+            for (size_t i = first + emitted[w]; i < first + emitted[w + 1]; ++i)
+                accounts_.apply(audit_[i], local);
+            totals[w] = local;
+        });
+    }
+    for (const p4::TypeTotals &t : totals)
+        accounts_.merge_totals(t);
+
+    for (size_t i = first; i < audit_.size(); ++i)
+    {
+        const p4::TxEntry &e = audit_[i];
+        if (e.kind == p4::TxKind::Interest)
+        {
+            ++report.interest_posted;
+            report.interest_cents += e.amount_cents;
+        }
+        else
+        {
+            ++report.fees_charged;
+            report.fee_cents += e.amount_cents;
+        }
+    }
+    p4::metrics::add_batch(report.interest_posted + report.fees_charged);
+    end_operation();
+    return report;
+}
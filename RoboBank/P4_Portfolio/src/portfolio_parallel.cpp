@@ -0,0 +1,67 @@
+#include "../include/portfolio.h"
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+void Portfolio::apply_all_parallel(const vector<p4::TxRecord> &txs, unsigned threads, bool auto_create)
+{
+    p4::metrics::Scope timed(p4::Timer::Batch);
+    // serial phase: account creation and note interning touch shared tables
+    size_t first = audit_.size();
+    resolve(txs.data(), txs.size(), auto_create, audit_);
+    const p4::TxEntry *batch = audit_.data() + first;
+    size_t n = audit_.size() - first;
+
+    if (threads <= 1 || n < 4096)
+    {
+        for (size_t i = 0; i < n; ++i)
+            accounts_.apply(batch[i]);
+        p4::metrics::add_batch(n);
+        end_operation();
+        return;
+    }
+
+    // more shards than workers so a hot shard does not stall the whole batch
+    const size_t shards = static_cast<size_t>(threads) * 8;
+    Scratch scratch(*this);
+    pmr::vector<size_t> start(shards + 1, 0, scratch.resource);
+    for (size_t i = 0; i < n; ++i)
+        ++start[batch[i].account % shards + 1];
+    for (size_t s = 0; s < shards; ++s)
+        start[s + 1] += start[s];
+
+    // stable counting sort of positions: each shard lists its transactions in input order
+    pmr::vector<size_t> order(n, scratch.resource);
+    pmr::vector<size_t> fill(start.begin(), start.end() - 1, scratch.resource);
+    for (size_t i = 0; i < n; ++i)
+        order[fill[batch[i].account % shards]++] = i;
+
+    // each worker sums its balance changes per type; the table's totals take them after the join
+    atomic<size_t> next_shard(0);
+    pmr::vector<p4::TypeTotals> totals(threads, scratch.resource);
+    auto worker = [&](unsigned w) {
+        p4::TypeTotals local; // on the worker's stack: no false sharing with the others
+        for (size_t s = next_shard.fetch_add(1); s < shards; s = next_shard.fetch_add(1))
+        {
+            for (size_t k = start[s]; k < start[s + 1]; ++k)
+            {
+                const p4::TxEntry &e = batch[order[k]];
+                accounts_.apply(e, local);
+            }
+        }
+        totals[w] = local;
+    };
+
+    vector<thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &t : pool)
+        t.join();
+    for (const p4::TypeTotals &t : totals)
+        accounts_.merge_totals(t);
+    p4::metrics::add_batch(n);
+    end_operation();
+}
@@ -0,0 +1,187 @@
+#include "../include/portfolio.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "../include/crc32.h"
+#include "../include/snapshot.h"
+
+using namespace std;
+
+namespace {
+    uint64_t align64(uint64_t v) { return (v + 63) & ~uint64_t(63); }
+
+    template <class T>
+    void write_vec(ofstream &out, const vector<T> &v)
+    {
+        out.write(reinterpret_cast<const char *>(v.data()), static_cast<streamsize>(v.size() * sizeof(T)));
+    }
+}
+
+bool Portfolio::save_snapshot(const string &path, bool with_audit) const
+{
+    typedef p4::SnapshotHeader H;
+    vector<p4::AccountHandle> rows;
+    rows.reserve(count_);
+    for (p4::AccountHandle a = 0; a < accounts_.rows(); ++a)
+        if (accounts_.contains(a)) rows.push_back(a);
+    const uint64_t n = rows.size();
+
+    // build the small columns in memory; strings and audits are streamed from the accounts
+    vector<uint64_t> id_off(n + 1, 0);
+    vector<int32_t> type(n), audit_cap(n);
+    vector<double> apr(n);
+    vector<int64_t> fee(n), balance(n);
+    vector<uint64_t> audit_off(with_audit ? n + 1 : 0, 0);
+    H h;
+    memset(&h, 0, sizeof(h));
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        const p4::AccountHandle a = rows[i];
+        const p4::AccountSettings &s = accounts_.settings(a);
+        id_off[i + 1] = id_off[i] + ids_.view(a).size();
+        type[i] = s.type;
+        apr[i] = s.apr;
+        fee[i] = s.fee_flat_cents;
+        audit_cap[i] = s.audit_capacity;
+        balance[i] = accounts_.balance(a);
+        if (with_audit) audit_off[i + 1] = audit_off[i] + static_cast<uint64_t>(accounts_.audit(a).size());
+        h.total_exposure += balance[i];
+        if (accounts_.type(a) == AccountType::Checking)
+        {
+            h.checking_total += balance[i];
+            ++h.checking_accounts;
+        }
+        else
+        {
+            h.savings_total += balance[i];
+            ++h.savings_accounts;
+        }
+    }
+
+    uint64_t slots = 64;
+    while (slots < 2 * n)
+        slots *= 2;
+    vector<uint32_t> index(slots, p4::MappedSnapshot::npos);
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        size_t slot = p4::hash_bytes(ids_.view(rows[i])) & (slots - 1);
+        while (index[slot] != p4::MappedSnapshot::npos)
+            slot = (slot + 1) & (slots - 1);
+        index[slot] = static_cast<uint32_t>(i);
+    }
+
+    vector<uint64_t> note_off;
+    if (with_audit)
+    {
+        note_off.assign(notes_.size() + 1, 0);
+        for (uint32_t i = 0; i < notes_.size(); ++i)
+            note_off[i + 1] = note_off[i] + notes_.view(i).size();
+    }
+
+    h.magic = H::kMagic;
+    h.version = H::kVersion;
+    h.accounts = n;
+    h.notes = with_audit ? notes_.size() : 0;
+    h.audit_entries = with_audit ? audit_off[n] : 0;
+    h.index_slots = slots;
+    h.size[H::IdOffsets] = (n + 1) * sizeof(uint64_t);
+    h.size[H::IdChars] = id_off[n];
+    h.size[H::Type] = n * sizeof(int32_t);
+    h.size[H::Apr] = n * sizeof(double);
+    h.size[H::FeeFlat] = n * sizeof(int64_t);
+    h.size[H::AuditCap] = n * sizeof(int32_t);
+    h.size[H::Balance] = n * sizeof(int64_t);
+    h.size[H::Index] = slots * sizeof(uint32_t);
+    if (with_audit)
+    {
+        h.size[H::NoteOffsets] = note_off.size() * sizeof(uint64_t);
+        h.size[H::NoteChars] = note_off.back();
+        h.size[H::AuditOffsets] = (n + 1) * sizeof(uint64_t);
+        h.size[H::AuditEntries] = h.audit_entries * sizeof(p4::TxEntry);
+    }
+    uint64_t at = align64(sizeof(H));
+    for (int s = 0; s < H::kSections; ++s)
+    {
+        h.offset[s] = at;
+        at = align64(at + h.size[s]);
+    }
+    h.file_size = at;
+    h.header_crc = p4::crc32(&h, offsetof(H, header_crc));
+
+    // write to a temporary name so a reader never maps a half-written file
+    string tmp = path + ".tmp";
+    ofstream out(tmp, ios::binary | ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    auto pad_to = [&](uint64_t offset) {
+        static const char zeros[64] = {};
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        out.write(zeros, static_cast<streamsize>(offset - pos));
+    };
+    for (int s = 0; s < H::kSections; ++s)
+    {
+        pad_to(h.offset[s]);
+        switch (s)
+        {
+        case H::IdOffsets: write_vec(out, id_off); break;
+        case H::IdChars:
+            for (p4::AccountHandle a : rows)
+                out.write(ids_.view(a).data(), static_cast<streamsize>(ids_.view(a).size()));
+            break;
+        case H::Type: write_vec(out, type); break;
+        case H::Apr: write_vec(out, apr); break;
+        case H::FeeFlat: write_vec(out, fee); break;
+        case H::AuditCap: write_vec(out, audit_cap); break;
+        case H::Balance: write_vec(out, balance); break;
+        case H::Index: write_vec(out, index); break;
+        case H::NoteOffsets: write_vec(out, note_off); break;
+        case H::NoteChars:
+            for (uint32_t i = 0; with_audit && i < notes_.size(); ++i)
+                out.write(notes_.view(i).data(), static_cast<streamsize>(notes_.view(i).size()));
+            break;
+        case H::AuditOffsets: write_vec(out, audit_off); break;
+        case H::AuditEntries:
+            for (size_t i = 0; with_audit && i < rows.size(); ++i)
+            {
+                AuditView<p4::TxEntry>(accounts_.audit(rows[i])).for_each([&](const p4::TxEntry &e) {
+                    p4::TxEntry rec; // zeroed so padding bytes are deterministic
+                    memset(&rec, 0, sizeof(rec));
+                    rec.amount_cents = e.amount_cents;
+                    rec.timestamp = e.timestamp;
+                    rec.account = e.account;
+                    rec.note = e.note;
+                    rec.kind = e.kind;
+                    out.write(reinterpret_cast<const char *>(&rec), sizeof(rec));
+                });
+            }
+            break;
+        }
+    }
+    pad_to(h.file_size);
+    out.close();
+    if (!out) return false;
+    error_code ec;
+    filesystem::rename(tmp, path, ec); // replaces an existing snapshot in one step
+    return !ec;
+}
+
+bool Portfolio::load_snapshot(const string &path)
+{
+    // ids and notes must intern to the saved handles and note ids
+    if (count_ != 0 || journal_) return false;
+    p4::MappedSnapshot snap;
+    if (!snap.open(path) || !snap.verify()) return false;
+
+    for (size_t i = 1; i < snap.note_count(); ++i)
+        notes_.intern(snap.note(static_cast<p4::NoteId>(i)));
+    reserve(snap.count());
+    for (uint32_t row = 0; row < snap.count(); ++row)
+    {
+        p4::AccountHandle h = create_account(snap.id(row), snap.settings(row), snap.balance(row));
+        size_t n;
+        const p4::TxEntry *audit = snap.audit(row, n);
+        if (n) accounts_.restore_audit(h, audit, n);
+    }
+    return true;
+}
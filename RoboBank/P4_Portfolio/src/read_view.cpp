@@ -0,0 +1,164 @@
+#include "../include/read_view.h"
+#include <algorithm>
+
+namespace p4 {
+
+std::unordered_map<AccountType, long long> ReadView::totals_by_type() const
+{
+    // as Portfolio::totals_by_type: only types that have accounts get an entry
+    std::unordered_map<AccountType, long long> out;
+    if (type_count_[0]) out[AccountType::Checking] = totals_.by_type[0];
+    if (type_count_[1]) out[AccountType::Savings] = totals_.by_type[1];
+    return out;
+}
+
+std::vector<std::string> ReadView::list_ids() const
+{
+    std::vector<std::string> ids;
+    ids.reserve(count_);
+    for (AccountHandle h = 0; h < rows_; ++h)
+        if (contains(h)) ids.emplace_back(id_of(h));
+    return ids;
+}
+
+const TxEntry *ReadView::audit(AccountHandle h, size_t &n) const
+{
+    n = 0;
+    if (!with_audit_ || h >= rows_) return nullptr;
+    const Audit &a = (*audit_[h >> kPageShift])[h & (kPageRows - 1)];
+    n = a.size;
+    return a.block ? a.block->data() + a.offset : nullptr;
+}
+
+std::string_view ReadView::note_of(NoteId n) const
+{
+    if (!with_audit_ || n >= note_count_) return std::string_view();
+    return (*notes_[n >> kPageShift])[n & (kPageRows - 1)];
+}
+
+ViewBuilder::ViewBuilder(const ReadViewOptions &opts) : opts_(opts), ops_(0), wanted_(false) {}
+
+std::shared_ptr<const ReadView> ViewBuilder::publish(AccountTable &table, const StringPool &ids, const StringPool &notes,
+                                                     size_t count)
+{
+    const size_t kRows = ReadView::kPageRows;
+    const unsigned kShift = ReadView::kPageShift;
+    const bool first = !last_;
+    if (first) table.track_changes(true);
+    // copying the previous view copies page pointers only
+    std::shared_ptr<ReadView> v = first ? std::make_shared<ReadView>() : std::make_shared<ReadView>(*last_);
+    ChangeMarks &marks = table.changes();
+
+    const size_t old_rows = v->rows_;
+    const size_t rows = table.rows();
+    const size_t pages = (rows + kRows - 1) >> kShift;
+    // pages that gained rows are copied whole, ids included; the others only when marked
+    const size_t grown_from = first ? 0 : (rows > old_rows ? old_rows >> kShift : pages);
+    v->rows_pages_.resize(pages);
+    v->ids_.resize(pages);
+    v->with_audit_ = opts_.with_audit;
+    if (opts_.with_audit) v->audit_.resize(pages);
+
+    const long long *balance = table.balances();
+    const int *type = table.types();
+    for (size_t p = 0; p < pages; ++p)
+    {
+        const bool grown = p >= grown_from;
+        if (!grown && !marks.page(p)) continue;
+        const size_t begin = p << kShift, end = std::min(rows, begin + kRows);
+
+        auto rp = std::make_shared<std::array<ReadView::Row, kRows>>();
+        for (size_t h = begin; h < end; ++h)
+            (*rp)[h - begin] = ReadView::Row{balance[h], type[h]};
+        for (size_t h = end; h < begin + kRows; ++h)
+            (*rp)[h - begin] = ReadView::Row{0, AccountTable::kNoAccount};
+        v->rows_pages_[p] = std::move(rp);
+
+        if (grown)
+        {
+            auto ip = std::make_shared<std::array<std::string_view, kRows>>();
+            for (size_t h = begin; h < end; ++h)
+                (*ip)[h - begin] = ids.view(static_cast<AccountHandle>(h));
+            v->ids_[p] = std::move(ip);
+        }
+
+        if (opts_.with_audit)
+        {
+            // the changed rows' rings go into one new block; the others keep the previous view's
+            auto ap = v->audit_[p] ? std::make_shared<std::array<ReadView::Audit, kRows>>(*v->audit_[p])
+                                   : std::make_shared<std::array<ReadView::Audit, kRows>>();
+            auto block = std::make_shared<std::vector<TxEntry>>();
+            size_t total = 0;
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                if (pass == 1) block->reserve(total);
+                for (size_t h = begin; h < end; ++h)
+                {
+                    if (!first && !(grown && h >= old_rows) && !marks.row(h)) continue;
+                    const AuditRing<TxEntry> &ring = table.audit(static_cast<AccountHandle>(h));
+                    if (pass == 0)
+                    {
+                        total += ring.size();
+                        continue;
+                    }
+                    ReadView::Audit &a = (*ap)[h - begin];
+                    a.block = ring.empty() ? nullptr : block;
+                    a.offset = static_cast<std::uint32_t>(block->size());
+                    a.size = static_cast<std::uint32_t>(ring.size());
+                    block->insert(block->end(), ring.begin(), ring.end());
+                }
+            }
+            v->audit_[p] = std::move(ap);
+        }
+        if (p < marks.pages()) marks.clear_page(p);
+    }
+
+    if (opts_.with_audit)
+    {
+        // the pool only appends, so only its last page and new ones change
+        const size_t old_notes = v->note_count_, n = notes.size();
+        v->notes_.resize((n + kRows - 1) >> kShift);
+        for (size_t p = first ? 0 : old_notes >> kShift; n > old_notes && p < v->notes_.size(); ++p)
+        {
+            auto np = std::make_shared<std::array<std::string_view, kRows>>();
+            for (size_t i = p << kShift; i < std::min(n, (p + 1) << kShift); ++i)
+                (*np)[i & (kRows - 1)] = notes.view(static_cast<NoteId>(i));
+            v->notes_[p] = std::move(np);
+        }
+        v->note_count_ = n;
+    }
+
+    v->version_ = first ? 1 : last_->version_ + 1;
+    v->rows_ = rows;
+    v->count_ = count;
+    v->type_count_[0] = table.count(AccountType::Checking);
+    v->type_count_[1] = table.count(AccountType::Savings);
+    v->totals_ = table.totals();
+
+    last_ = v;
+    ops_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        published_ = last_;
+        wanted_.store(false, std::memory_order_relaxed);
+    }
+    cv_.notify_all();
+    return last_;
+}
+
+std::shared_ptr<const ReadView> ViewBuilder::latest() const
+{
+    std::lock_guard<std::mutex> lock(mu_);
+    return published_;
+}
+
+std::shared_ptr<const ReadView> ViewBuilder::next(std::chrono::milliseconds timeout) const
+{
+    std::unique_lock<std::mutex> lock(mu_);
+    const std::uint64_t seen = published_ ? published_->version() : 0;
+    wanted_.store(true, std::memory_order_relaxed);
+    cv_.wait_for(lock, timeout, [&] { return published_ && published_->version() > seen; });
+    return published_;
+}
+
+}
@@ -0,0 +1,238 @@
+#include "../include/snapshot.h"
+#include <cstddef>
+#include <cstring>
+#include <unordered_set>
+#include "../include/crc32.h"
+#include "../include/string_pool.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace p4 {
+
+namespace {
+    // element size of each section, for the bounds check in open()
+    const std::size_t kElem[SnapshotHeader::kSections] = {
+        sizeof(std::uint64_t), 1, sizeof(std::int32_t), sizeof(double), sizeof(std::int64_t), sizeof(std::int32_t),
+        sizeof(std::int64_t), sizeof(std::uint32_t), sizeof(std::uint64_t), 1, sizeof(std::uint64_t), sizeof(TxEntry)};
+
+    // offsets column of n + 1 entries into a section of `end` elements: starts at 0, ends at end
+    bool offsets_span(const char *base, const SnapshotHeader *h, int s, std::uint64_t n, std::uint64_t end)
+    {
+        const std::uint64_t *off = reinterpret_cast<const std::uint64_t *>(base + h->offset[s]);
+        return h->size[s] == (n + 1) * sizeof(std::uint64_t) && off[0] == 0 && off[n] == end;
+    }
+
+    bool nondecreasing(const std::uint64_t *off, std::uint64_t n)
+    {
+        for (std::uint64_t i = 0; i < n; ++i)
+            if (off[i + 1] < off[i]) return false;
+        return true;
+    }
+}
+
+MappedSnapshot::MappedSnapshot()
+    : base_(nullptr), hdr_(nullptr), mapped_(0)
+#ifdef _WIN32
+      , file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#endif
+{
+}
+
+MappedSnapshot::~MappedSnapshot() { close(); }
+
+void MappedSnapshot::close()
+{
+    if (!base_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    munmap(const_cast<char *>(base_), mapped_);
+#endif
+    base_ = nullptr;
+    hdr_ = nullptr;
+    mapped_ = 0;
+}
+
+bool MappedSnapshot::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(file_, &sz) || sz.QuadPart < static_cast<LONGLONG>(sizeof(SnapshotHeader)) ||
+        !(mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr)))
+    {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+        return false;
+    }
+    base_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    mapped_ = static_cast<std::size_t>(sz.QuadPart);
+    if (!base_)
+    {
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+        return false;
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(SnapshotHeader)))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *m = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file
+    if (m == MAP_FAILED) return false;
+    base_ = static_cast<const char *>(m);
+    mapped_ = static_cast<std::size_t>(st.st_size);
+#endif
+
+    // header and section bounds only: nothing proportional to the account count is read
+    const SnapshotHeader *h = reinterpret_cast<const SnapshotHeader *>(base_);
+    bool ok = h->magic == SnapshotHeader::kMagic && h->version == SnapshotHeader::kVersion && h->file_size == mapped_ &&
+              h->header_crc == crc32(h, offsetof(SnapshotHeader, header_crc));
+    for (int s = 0; ok && s < SnapshotHeader::kSections; ++s)
+        ok = h->offset[s] % 64 == 0 && h->offset[s] <= mapped_ && h->size[s] <= mapped_ - h->offset[s] &&
+             h->size[s] % kElem[s] == 0;
+    // counts no larger than the file, so the products below cannot wrap
+    ok = ok && h->accounts < mapped_ && h->notes < mapped_ && h->audit_entries < mapped_ && h->index_slots < mapped_;
+    ok = ok && h->size[SnapshotHeader::Type] == h->accounts * sizeof(std::int32_t) &&
+         h->size[SnapshotHeader::Apr] == h->accounts * sizeof(double) &&
+         h->size[SnapshotHeader::FeeFlat] == h->accounts * sizeof(std::int64_t) &&
+         h->size[SnapshotHeader::AuditCap] == h->accounts * sizeof(std::int32_t) &&
+         h->size[SnapshotHeader::Balance] == h->accounts * sizeof(std::int64_t) &&
+         h->size[SnapshotHeader::Index] == h->index_slots * sizeof(std::uint32_t) &&
+         h->index_slots >= 2 * h->accounts && h->index_slots && (h->index_slots & (h->index_slots - 1)) == 0 &&
+         offsets_span(base_, h, SnapshotHeader::IdOffsets, h->accounts, h->size[SnapshotHeader::IdChars]);
+    // the audit sections are all present (note 0 is the empty note) or all empty
+    if (ok && h->size[SnapshotHeader::AuditOffsets] != 0)
+        ok = h->notes != 0 && offsets_span(base_, h, SnapshotHeader::NoteOffsets, h->notes, h->size[SnapshotHeader::NoteChars]) &&
+             reinterpret_cast<const std::uint64_t *>(base_ + h->offset[SnapshotHeader::NoteOffsets])[1] == 0 &&
+             offsets_span(base_, h, SnapshotHeader::AuditOffsets, h->accounts, h->audit_entries) &&
+             h->size[SnapshotHeader::AuditEntries] == h->audit_entries * sizeof(TxEntry);
+    else
+        ok = ok && h->notes == 0 && h->audit_entries == 0 && h->size[SnapshotHeader::NoteOffsets] == 0 &&
+             h->size[SnapshotHeader::NoteChars] == 0 && h->size[SnapshotHeader::AuditEntries] == 0;
+    if (!ok)
+    {
+        close();
+        return false;
+    }
+    hdr_ = h;
+    return true;
+}
+
+bool MappedSnapshot::verify() const
+{
+    const SnapshotHeader *h = hdr_;
+    if (!nondecreasing(col<std::uint64_t>(SnapshotHeader::IdOffsets), h->accounts)) return false;
+    const std::int32_t *type = col<std::int32_t>(SnapshotHeader::Type);
+    for (std::uint64_t r = 0; r < h->accounts; ++r)
+        if (type[r] != AccountType::Checking && type[r] != AccountType::Savings) return false;
+
+    // every row once in the index, and found at its own slot chain: ids are distinct and find()
+    // always reaches an empty slot
+    const std::uint32_t *index = col<std::uint32_t>(SnapshotHeader::Index);
+    std::uint64_t used = 0;
+    for (std::uint64_t s = 0; s < h->index_slots; ++s)
+    {
+        if (index[s] == npos) continue;
+        if (index[s] >= h->accounts) return false;
+        ++used;
+    }
+    if (used != h->accounts) return false;
+    for (std::uint32_t r = 0; r < h->accounts; ++r)
+        if (find(id(r)) != r) return false;
+
+    if (!has_audit()) return true;
+    if (!nondecreasing(col<std::uint64_t>(SnapshotHeader::NoteOffsets), h->notes) ||
+        !nondecreasing(col<std::uint64_t>(SnapshotHeader::AuditOffsets), h->accounts))
+        return false;
+    // notes intern back to their saved ids only if they are distinct
+    std::unordered_set<std::string_view> seen;
+    seen.reserve(static_cast<std::size_t>(h->notes));
+    for (std::uint64_t n = 0; n < h->notes; ++n)
+        if (!seen.insert(note(static_cast<NoteId>(n))).second) return false;
+    const TxEntry *e = col<TxEntry>(SnapshotHeader::AuditEntries);
+    for (std::uint64_t i = 0; i < h->audit_entries; ++i)
+        if (static_cast<unsigned>(e[i].kind) > TxKind::TransferOut || e[i].note >= h->notes) return false;
+    return true;
+}
+
+std::string_view MappedSnapshot::id(std::uint32_t row) const
+{
+    const std::uint64_t *off = col<std::uint64_t>(SnapshotHeader::IdOffsets);
+    return std::string_view(col<char>(SnapshotHeader::IdChars) + off[row], static_cast<std::size_t>(off[row + 1] - off[row]));
+}
+
+std::uint32_t MappedSnapshot::find(std::string_view id) const
+{
+    const std::uint32_t *index = col<std::uint32_t>(SnapshotHeader::Index);
+    std::size_t mask = static_cast<std::size_t>(hdr_->index_slots - 1);
+    for (std::size_t slot = hash_bytes(id) & mask;; slot = (slot + 1) & mask)
+    {
+        std::uint32_t row = index[slot];
+        if (row == npos || this->id(row) == id) return row;
+    }
+}
+
+AccountSettings MappedSnapshot::settings(std::uint32_t row) const
+{
+    AccountSettings s;
+    s.type = col<std::int32_t>(SnapshotHeader::Type)[row];
+    s.apr = col<double>(SnapshotHeader::Apr)[row];
+    s.fee_flat_cents = col<std::int64_t>(SnapshotHeader::FeeFlat)[row];
+    s.audit_capacity = col<std::int32_t>(SnapshotHeader::AuditCap)[row];
+    return s;
+}
+
+long long MappedSnapshot::balance_of(std::string_view id) const
+{
+    std::uint32_t row = find(id);
+    return row == npos ? 0 : balance(row);
+}
+
+std::unordered_map<AccountType, long long> MappedSnapshot::totals_by_type() const
+{
+    // same keys as Portfolio::totals_by_type: only types that have accounts
+    std::unordered_map<AccountType, long long> out;
+    if (hdr_->checking_accounts) out[AccountType::Checking] = hdr_->checking_total;
+    if (hdr_->savings_accounts) out[AccountType::Savings] = hdr_->savings_total;
+    return out;
+}
+
+std::string_view MappedSnapshot::note(NoteId n) const
+{
+    const std::uint64_t *off = col<std::uint64_t>(SnapshotHeader::NoteOffsets);
+    return std::string_view(col<char>(SnapshotHeader::NoteChars) + off[n], static_cast<std::size_t>(off[n + 1] - off[n]));
+}
+
+const TxEntry *MappedSnapshot::audit(std::uint32_t row, std::size_t &n) const
+{
+    if (!has_audit())
+    {
+        n = 0;
+        return nullptr;
+    }
+    const std::uint64_t *off = col<std::uint64_t>(SnapshotHeader::AuditOffsets);
+    n = static_cast<std::size_t>(off[row + 1] - off[row]);
+    return col<TxEntry>(SnapshotHeader::AuditEntries) + off[row];
+}
+
+}
@@ -0,0 +1,111 @@
+#include "../include/string_pool.h"
+#include <cstring>
+
+namespace p4 {
+
+namespace {
+    const std::size_t kBlockSize = 64 * 1024;
+}
+
+std::uint32_t hash_bytes(std::string_view s)
+{
+    std::uint32_t h = 2166136261u;
+    for (char c : s)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+StringPool::StringPool() : block_used_(0), block_size_(0), arena_bytes_(0), index_(64, npos)
+{
+    intern(std::string_view());
+}
+
+const char *StringPool::store(std::string_view s)
+{
+    if (s.empty())
+        return "";
+    if (s.size() > kBlockSize / 4)
+    {
+        // large strings get their own block so the current block is not wasted
+        blocks_.emplace_back(new char[s.size()]);
+        arena_bytes_ += s.size();
+        char *dst = blocks_.back().get();
+        std::memcpy(dst, s.data(), s.size());
+        // keep the current block last so small strings keep filling it
+        if (blocks_.size() > 1)
+            std::swap(blocks_[blocks_.size() - 1], blocks_[blocks_.size() - 2]);
+        return dst;
+    }
+    if (blocks_.empty() || block_used_ + s.size() > block_size_)
+    {
+        blocks_.emplace_back(new char[kBlockSize]);
+        block_used_ = 0;
+        block_size_ = kBlockSize;
+        arena_bytes_ += kBlockSize;
+    }
+    char *dst = blocks_.back().get() + block_used_;
+    std::memcpy(dst, s.data(), s.size());
+    block_used_ += s.size();
+    return dst;
+}
+
+std::size_t StringPool::probe(std::string_view s, std::uint32_t hash) const
+{
+    std::size_t mask = index_.size() - 1;
+    std::size_t slot = hash & mask;
+    for (;;)
+    {
+        std::uint32_t id = index_[slot];
+        if (id == npos || (hashes_[id] == hash && entries_[id] == s))
+            return slot;
+        slot = (slot + 1) & mask;
+    }
+}
+
+void StringPool::grow_index()
+{
+    std::vector<std::uint32_t> next(index_.size() * 2, npos);
+    std::size_t mask = next.size() - 1;
+    for (std::uint32_t id = 0; id < entries_.size(); ++id)
+    {
+        std::size_t slot = hashes_[id] & mask;
+        while (next[slot] != npos)
+            slot = (slot + 1) & mask;
+        next[slot] = id;
+    }
+    index_.swap(next);
+}
+
+void StringPool::reserve(std::size_t n)
+{
+    entries_.reserve(n);
+    hashes_.reserve(n);
+    while (2 * n > index_.size())
+        grow_index();
+}
+
+std::uint32_t StringPool::intern(std::string_view s)
+{
+    std::uint32_t hash = hash_bytes(s);
+    std::size_t slot = probe(s, hash);
+    if (index_[slot] != npos)
+        return index_[slot];
+
+    std::uint32_t id = static_cast<std::uint32_t>(entries_.size());
+    entries_.emplace_back(store(s), s.size());
+    hashes_.push_back(hash);
+    index_[slot] = id;
+    if (2 * entries_.size() > index_.size())
+        grow_index();
+    return id;
+}
+
+std::uint32_t StringPool::find(std::string_view s) const
+{
+    return index_[probe(s, hash_bytes(s))];
+}
+
+}
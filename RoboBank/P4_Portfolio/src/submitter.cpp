@@ -0,0 +1,228 @@
+#include "../include/submitter.h"
+#include <chrono>
+#include <vector>
+#include "../include/portfolio.h"
+
+namespace p4 {
+
+TxSubmitter::TxSubmitter(Portfolio &portfolio, const SubmitOptions &opts)
+    : portfolio_(portfolio), opts_(opts), ring_(opts.queue_capacity), stopping_(false), sleeping_(false), submitted_(0),
+      full_waits_(0), completed_(0), batches_(0), callback_errors_(0)
+{
+    if (opts_.max_batch == 0) opts_.max_batch = 1;
+    thread_ = std::thread([this] { run(); });
+}
+
+TxSubmitter::~TxSubmitter() { stop(); }
+
+TxSubmitter::Item TxSubmitter::item_of(TxRecord &&tx)
+{
+    Item it;
+    it.tx = std::move(tx);
+    return it;
+}
+
+TxSubmitter::Item TxSubmitter::item_of(TransferRecord &&tr)
+{
+    Item it;
+    it.tx = TxRecord{TxKind::TransferOut, tr.amount_cents, tr.timestamp, std::move(tr.note), std::move(tr.from_id)};
+    it.to_id = std::move(tr.to_id);
+    it.transfer = true;
+    return it;
+}
+
+void TxSubmitter::wake()
+{
+    // pairs with the fence in run(): either the apply thread sees the item before it sleeps,
+    // or this sees sleeping_ and notifies under the lock it sleeps with
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        cv_.notify_one();
+    }
+}
+
+bool TxSubmitter::push(Item &&item, bool wait)
+{
+    if (!ring_.try_push(std::move(item)))
+    {
+        if (!wait) return false;
+        full_waits_.fetch_add(1, std::memory_order_relaxed);
+        // back-pressure: the apply thread is behind, so give it the core
+        do
+        {
+            wake();
+            std::this_thread::yield();
+        } while (!ring_.try_push(std::move(item)));
+    }
+    submitted_.fetch_add(1, std::memory_order_relaxed);
+    wake();
+    return true;
+}
+
+std::future<RejectReason> TxSubmitter::push_promise(Item &&item)
+{
+    item.promise.emplace();
+    std::future<RejectReason> f = item.promise->get_future();
+    push(std::move(item), true);
+    return f;
+}
+
+std::future<RejectReason> TxSubmitter::submit(TxRecord tx) { return push_promise(item_of(std::move(tx))); }
+std::future<RejectReason> TxSubmitter::submit(TransferRecord tr) { return push_promise(item_of(std::move(tr))); }
+
+void TxSubmitter::submit(TxRecord tx, SubmitCallback done)
+{
+    Item it = item_of(std::move(tx));
+    it.done = std::move(done);
+    push(std::move(it), true);
+}
+
+void TxSubmitter::submit(TransferRecord tr, SubmitCallback done)
+{
+    Item it = item_of(std::move(tr));
+    it.done = std::move(done);
+    push(std::move(it), true);
+}
+
+bool TxSubmitter::try_submit(TxRecord tx, SubmitCallback done)
+{
+    Item it = item_of(std::move(tx));
+    it.done = std::move(done);
+    return push(std::move(it), false);
+}
+
+bool TxSubmitter::try_submit(TransferRecord tr, SubmitCallback done)
+{
+    Item it = item_of(std::move(tr));
+    it.done = std::move(done);
+    return push(std::move(it), false);
+}
+
+void TxSubmitter::stop()
+{
+    if (!thread_.joinable()) return;
+    stopping_.store(true);
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        cv_.notify_one();
+    }
+    thread_.join();
+}
+
+SubmitStats TxSubmitter::stats() const
+{
+    SubmitStats s;
+    s.submitted = submitted_.load(std::memory_order_relaxed);
+    s.completed = completed_.load(std::memory_order_relaxed);
+    s.batches = batches_.load(std::memory_order_relaxed);
+    s.full_waits = full_waits_.load(std::memory_order_relaxed);
+    s.callback_errors = callback_errors_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void TxSubmitter::run()
+{
+    std::vector<Item> items;
+    std::vector<TxRecord> txs; // the run of plain transactions at the front of items
+    items.reserve(opts_.max_batch);
+    txs.reserve(opts_.max_batch);
+
+    // each item is completed once: the promise and callback are dropped once used. A callback
+    // that throws is the caller's failure, not the portfolio's, so it stays out of the batch's
+    // catch below, which would otherwise fail the rest of the batch's futures.
+    auto complete = [&](Item &it, RejectReason r) {
+        SubmitCallback done = std::move(it.done);
+        it.done = nullptr;
+        if (it.promise)
+        {
+            it.promise->set_value(r);
+            it.promise.reset();
+        }
+        else if (done)
+        {
+            try
+            {
+                done(r);
+            }
+            catch (...)
+            {
+                callback_errors_.store(callback_errors_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        }
+    };
+    // applies items[first, end), all plain transactions, as one apply_checked call
+    auto apply_run = [&](size_t first, size_t end) {
+        if (first == end) return;
+        txs.clear();
+        for (size_t i = first; i < end; ++i)
+            txs.push_back(std::move(items[i].tx));
+        std::vector<TxRejection> rejected = portfolio_.apply_checked(txs, opts_.auto_create);
+        batches_.store(batches_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        size_t k = 0; // rejected is in batch order
+        for (size_t i = first; i < end; ++i)
+        {
+            RejectReason r = RejectReason::None;
+            if (k < rejected.size() && rejected[k].index == i - first) r = rejected[k++].reason;
+            complete(items[i], r);
+        }
+    };
+
+    for (;;)
+    {
+        items.clear();
+        Item it;
+        while (items.size() < opts_.max_batch && ring_.try_pop(it))
+            items.push_back(std::move(it));
+
+        if (items.empty())
+        {
+            if (stopping_.load() && ring_.empty()) return;
+            // spin a little for the next submit, then sleep until a producer wakes us
+            bool got = false;
+            for (unsigned s = 0; s < opts_.spin && !got; ++s)
+            {
+                std::this_thread::yield();
+                got = !ring_.empty();
+            }
+            if (got) continue;
+            std::unique_lock<std::mutex> lock(mu_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ring_.empty() && !stopping_.load())
+                // the timeout only covers a push still between its claim and its publish
+                cv_.wait_for(lock, std::chrono::milliseconds(1));
+            sleeping_.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        // queue order: runs of transactions go through apply_checked, transfers one by one
+        try
+        {
+            size_t run_start = 0;
+            for (size_t i = 0; i < items.size(); ++i)
+            {
+                if (!items[i].transfer) continue;
+                apply_run(run_start, i);
+                RejectReason r = RejectReason::None;
+                Item &t = items[i];
+                portfolio_.transfer(TransferRecord{std::move(t.tx.account_id), std::move(t.to_id), t.tx.amount_cents,
+                                                   t.tx.timestamp, std::move(t.tx.note)},
+                                    &r);
+                complete(t, r);
+                run_start = i + 1;
+            }
+            apply_run(run_start, items.size());
+        }
+        catch (...)
+        {
+            // e.g. a journal write failure: the futures still open get the exception
+            for (Item &i : items)
+                if (i.promise) i.promise->set_exception(std::current_exception());
+        }
+        completed_.store(completed_.load(std::memory_order_relaxed) + items.size(), std::memory_order_relaxed);
+    }
+}
+
+}